@@ -1,3 +1,9 @@
+# credential ids, the most recently used first
+_safeword_credentials()
+{
+	{ safeword ls --recent ; safeword ls --all ; } | cut -d' ' -f1 | awk '!seen[$0]++'
+}
+
 _safeword()
 {
 	local cur prev opts args
@@ -10,7 +16,7 @@ _safeword()
 	# Complete the subcommands
 	#
 	opts="--version"
-	subcommands="help init add ls tag cp show rm edit"
+	subcommands="help init add ls tag cp show rm edit backup sync changes import audit"
 
 	#
 	# Complete arguments for the subcommands
@@ -33,13 +39,14 @@ _safeword()
 		if [ ${#COMP_WORDS[@]} -gt 3 ] ; then
 			tags=$( safeword tag --filter ${COMP_WORDS[@]:2} )
 		else
-			opts="--all"
-			tags=$( safeword tag )
+			opts="--all --recent"
+			# most used tags first
+			tags=$( safeword tag --stats | cut -f2 )
 		fi
 		COMPREPLY=( $(compgen -W "${opts} ${tags}" -- ${cur}) )
 		;;
 	tag)
-		opts="--delete --force --move --wiki --untag"
+		opts="--delete --force --move --wiki --untag --filter --namespace --stats"
 		case "${prev}" in
 		tag | --untag | -u)
 			local credentials=$( safeword ls --all | cut -d' ' -f1 )
@@ -56,10 +63,10 @@ _safeword()
 		esac
 		;;
 	cp)
-		opts="--time --username --password"
+		opts="--time --wait --username --password"
 		case "${prev}" in
 		cp)
-			local credentials=$( safeword ls --all | cut -d' ' -f1 )
+			local credentials=$( _safeword_credentials )
 			COMPREPLY=( $(compgen -W "${credentials} ${opts}" -- ${cur}) )
 			;;
 		*)
@@ -68,9 +75,16 @@ _safeword()
 		esac
 		;;
 	show)
-		local credentials=$( safeword ls --all | cut -d' ' -f1 )
 		local tags=$( safeword tag )
-		COMPREPLY=( $(compgen -W "${credentials} ${tags}" -- ${cur}) )
+		case "${prev}" in
+		-t|--tag)
+			COMPREPLY=( $(compgen -W "${tags}" -- ${cur}) )
+			;;
+		*)
+			local credentials=$( _safeword_credentials )
+			COMPREPLY=( $(compgen -W "--tag ${credentials} ${tags}" -- ${cur}) )
+			;;
+		esac
 		;;
 	rm)
 		local credentials=$( safeword ls --all | cut -d' ' -f1 )
@@ -81,6 +95,33 @@ _safeword()
 		local credentials=$( safeword ls --all | cut -d' ' -f1 )
 		COMPREPLY=( $(compgen -W "${credentials} ${opts}" -- ${cur}) )
 		;;
+	backup)
+		opts="--pages --sleep --keep --quiet"
+		COMPREPLY=( $(compgen -f -d  -W "${opts}" -- ${cur}) )
+		;;
+	sync)
+		opts="--quiet"
+		COMPREPLY=( $(compgen -f -d  -W "${opts}" -- ${cur}) )
+		;;
+	changes)
+		opts="--since --limit --last --compact"
+		COMPREPLY=( $(compgen -W "${opts}" -- ${cur}) )
+		;;
+	import)
+		case "${prev}" in
+		-f|--format)
+			COMPREPLY=( $(compgen -W "keepass-csv" -- ${cur}) )
+			;;
+		*)
+			opts="--format --quiet"
+			COMPREPLY=( $(compgen -f -d  -W "${opts}" -- ${cur}) )
+			;;
+		esac
+		;;
+	audit)
+		opts="--reuse --username --password"
+		COMPREPLY=( $(compgen -W "${opts}" -- ${cur}) )
+		;;
 	*)
 		COMPREPLY=( $(compgen -W "${opts} ${subcommands}" -- ${cur}) )
 		;;
@@ -88,4 +129,5 @@ _safeword()
 
 	return 0
 }
-complete -F _safeword safeword
+# keep the most used tags and credentials first where bash allows it
+complete -o nosort -F _safeword safeword 2>/dev/null || complete -F _safeword safeword
@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <safeword.h>
+#include "AuditCommand.h"
+
+static int _reuse;
+static int _fields;
+
+char* auditCmd_help(void)
+{
+	return "SYNOPSIS\n"
+"	audit --reuse [-u | --username] [-p | --password]\n"
+"\n"
+"DESCRIPTION\n"
+"	This command prints the credentials that share a username or a\n"
+"	password, one group per line:\n"
+"\n"
+"	    FIELD ID1,ID2,...\n"
+"\n"
+"	FIELD is username or password. The shared value itself is not\n"
+"	printed; see it with 'safeword show'.\n"
+"\n"
+"OPTIONS\n"
+"	-r, --reuse\n"
+"	    Print the credentials sharing a username or a password.\n"
+"	-u, --username\n"
+"	    Only audit usernames.\n"
+"	-p, --password\n"
+"	    Only audit passwords.\n"
+"\n";
+}
+
+int auditCmd_parse(int argc, char** argv)
+{
+	int ret = 0, c;
+	struct option long_options[] = {
+		{"reuse",	no_argument,	NULL,	'r'},
+		{"username",	no_argument,	NULL,	'u'},
+		{"password",	no_argument,	NULL,	'p'},
+		{0, 0, 0, 0},
+	};
+
+	while ((c = getopt_long(argc, argv, "rup", long_options, 0)) != -1) {
+		switch (c) {
+		case 'r':
+			_reuse = 1;
+			break;
+		case 'u':
+			_fields |= SAFEWORD_REUSE_USERNAME;
+			break;
+		case 'p':
+			_fields |= SAFEWORD_REUSE_PASSWORD;
+			break;
+		default:
+			ret = -ESAFEWORD_INVARG;
+			goto fail;
+		}
+	}
+
+	/* reuse is the only audit so far, it has to be asked for all the same */
+	if (optind < argc || !_reuse) {
+		ret = -ESAFEWORD_INVARG;
+		goto fail;
+	}
+	if (!_fields)
+		_fields = SAFEWORD_REUSE_USERNAME | SAFEWORD_REUSE_PASSWORD;
+
+fail:
+	return ret;
+}
+
+static int print_group(int field, unsigned int ids_size, const long int *ids, void *arg)
+{
+	unsigned int i;
+	(void) arg;
+
+	printf("%s\t", field == SAFEWORD_REUSE_USERNAME ? "username" : "password");
+	for (i = 0; i < ids_size; i++)
+		printf(i ? ",%ld" : "%ld", ids[i]);
+	printf("\n");
+	return 0;
+}
+
+int auditCmd_execute(void)
+{
+	int ret;
+	struct safeword_db db;
+
+	ret = safeword_open(&db, NULL);
+	safeword_check(!ret, ret, fail);
+
+	ret = safeword_audit_reuse(&db, _fields, print_group, NULL);
+	if (ret)
+		ret = -safeword_errno;
+
+fail:
+	safeword_close(&db);
+	return ret;
+}
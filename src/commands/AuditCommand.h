@@ -0,0 +1,10 @@
+#ifndef COMMAND_AUDIT_H
+#define COMMAND_AUDIT_H
+
+#include "Command.h"
+
+char* auditCmd_help(void);
+int auditCmd_parse(int arc, char** argv);
+int auditCmd_execute(void);
+
+#endif
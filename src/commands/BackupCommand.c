@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include <safeword.h>
+#include "BackupCommand.h"
+
+static char *_path;
+static int _pages = SAFEWORD_BACKUP_PAGES;
+static int _sleep_ms = SAFEWORD_BACKUP_SLEEP_MS;
+static unsigned int _keep = 1;
+static int _quiet;
+
+char* backupCmd_help(void)
+{
+	return "SYNOPSIS\n"
+"	backup [-n PAGES | --pages=PAGES] [-s MS | --sleep=MS] [-k N | --keep=N] [-q | --quiet] DEST\n"
+"\n"
+"DESCRIPTION\n"
+"	This command backs up the safeword database to DEST while other commands\n"
+"	keep using it. The backup is verified before it replaces DEST.\n"
+"\n"
+"OPTIONS\n"
+"	-n, --pages=PAGES\n"
+"	    The number of pages copied at a time. Default is 64.\n"
+"	-s, --sleep=MS\n"
+"	    The milliseconds to pause between copies so other commands can write.\n"
+"	    Default is 10.\n"
+"	-k, --keep=N\n"
+"	    The number of backups kept: DEST, DEST.1 up to DEST.N-1, the oldest\n"
+"	    being dropped. Default is 1.\n"
+"	-q, --quiet\n"
+"	    Do not report progress.\n"
+"\n";
+}
+
+int backupCmd_parse(int argc, char** argv)
+{
+	int ret = 0, c;
+	char *end;
+	long value;
+	struct option long_options[] = {
+		{"pages",	required_argument,	NULL,	'n'},
+		{"sleep",	required_argument,	NULL,	's'},
+		{"keep",	required_argument,	NULL,	'k'},
+		{"quiet",	no_argument,	NULL,	'q'},
+		{0, 0, 0, 0},
+	};
+
+	while ((c = getopt_long(argc, argv, "n:s:k:q", long_options, 0)) != -1) {
+		switch (c) {
+		case 'n':
+		case 's':
+		case 'k':
+			value = strtol(optarg, &end, 10);
+			if (*end || value < (c == 's' ? 0 : 1)) {
+				ret = -ESAFEWORD_INVARG;
+				goto fail;
+			}
+			if (c == 'n')
+				_pages = value;
+			else if (c == 's')
+				_sleep_ms = value;
+			else
+				_keep = value;
+			break;
+		case 'q':
+			_quiet = 1;
+			break;
+		default:
+			ret = -ESAFEWORD_INVARG;
+			goto fail;
+		}
+	}
+
+	/*  must have the destination remaining after parsing options */
+	if ((argc - optind) < 1)
+		return ret;
+
+	_path = calloc(strlen(argv[optind]) + 1, sizeof(char));
+	if (!_path) {
+		ret = -ESAFEWORD_NOMEM;
+		goto fail;
+	}
+	strcpy(_path, argv[optind]);
+
+fail:
+	return ret;
+}
+
+/* rewrites one line on a terminal, otherwise only reports completion */
+static int print_progress(int done, int total, void *arg)
+{
+	int *last = arg;
+	int percent = total ? (int) (done * 100LL / total) : 100;
+
+	if (isatty(STDERR_FILENO)) {
+		fprintf(stderr, "\rbackup: %3d%% (%d/%d pages)", percent, done, total);
+		if (done == total)
+			fprintf(stderr, "\n");
+	} else if (done == total && *last != total) {
+		fprintf(stderr, "backup: %d pages\n", total);
+	}
+	*last = done;
+
+	return 0;
+}
+
+int backupCmd_execute(void)
+{
+	int ret, last = -1;
+	struct safeword_db db;
+	struct safeword_backup_options options;
+
+	if (!_path) {
+		fprintf(stderr, "no destination specified\n");
+		return -ESAFEWORD_INVARG;
+	}
+
+	ret = safeword_open(&db, 0);
+	safeword_check(!ret, ret, fail);
+
+	memset(&options, 0, sizeof(options));
+	options.pages = _pages;
+	options.sleep_ms = _sleep_ms;
+	options.keep = _keep;
+	if (!_quiet) {
+		options.progress = print_progress;
+		options.arg = &last;
+	}
+	ret = safeword_backup(&db, _path, &options);
+	if (ret)
+		ret = -safeword_errno;
+
+fail:
+	safeword_close(&db);
+	free(_path);
+	return ret;
+}
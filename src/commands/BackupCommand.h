@@ -0,0 +1,10 @@
+#ifndef COMMAND_BACKUP_H
+#define COMMAND_BACKUP_H
+
+#include "Command.h"
+
+char* backupCmd_help(void);
+int backupCmd_parse(int arc, char** argv);
+int backupCmd_execute(void);
+
+#endif
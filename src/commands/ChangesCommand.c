@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <safeword.h>
+#include "ChangesCommand.h"
+
+static long long _since;
+static unsigned int _limit;
+static long long _compact = -1;
+static int _last;
+
+char* changesCmd_help(void)
+{
+	return "SYNOPSIS\n"
+"	changes [-s SEQ | --since=SEQ] [-n N | --limit=N]\n"
+"	changes --last\n"
+"	changes --compact=SEQ\n"
+"\n"
+"DESCRIPTION\n"
+"	This command prints the changes made to the safeword database, oldest\n"
+"	first, one per line:\n"
+"\n"
+"	    SEQ OP KIND ID [TAGID]\n"
+"\n"
+"	OP is insert, update or delete and KIND is credential, tag or tagging;\n"
+"	ID is the credential or tag, a tagging has the credential's ID and the\n"
+"	TAGID of the tag. Passing the last SEQ printed to --since prints only\n"
+"	the changes made after it.\n"
+"\n"
+"OPTIONS\n"
+"	-s, --since=SEQ\n"
+"	    Print only the changes after SEQ. Fails if some of them were\n"
+"	    compacted. Default is 0, every change.\n"
+"	-n, --limit=N\n"
+"	    Print at most N changes.\n"
+"	--last\n"
+"	    Print the SEQ of the latest change, 0 if there is none.\n"
+"	--compact=SEQ\n"
+"	    Drop the changes up to and including SEQ.\n"
+"\n";
+}
+
+static int parse_seq(const char *arg, long long *seq)
+{
+	char *end;
+
+	*seq = strtoll(arg, &end, 10);
+	return !*arg || *end || *seq < 0;
+}
+
+int changesCmd_parse(int argc, char** argv)
+{
+	int ret = 0, c;
+	long long value;
+	struct option long_options[] = {
+		{"since",	required_argument,	NULL,	's'},
+		{"limit",	required_argument,	NULL,	'n'},
+		{"last",	no_argument,	NULL,	'l'},
+		{"compact",	required_argument,	NULL,	'c'},
+		{0, 0, 0, 0},
+	};
+
+	while ((c = getopt_long(argc, argv, "s:n:", long_options, 0)) != -1) {
+		switch (c) {
+		case 's':
+			if (parse_seq(optarg, &_since)) {
+				ret = -ESAFEWORD_INVARG;
+				goto fail;
+			}
+			break;
+		case 'n':
+			if (parse_seq(optarg, &value) || value > (long long) ~0U) {
+				ret = -ESAFEWORD_INVARG;
+				goto fail;
+			}
+			_limit = value;
+			break;
+		case 'l':
+			_last = 1;
+			break;
+		case 'c':
+			if (parse_seq(optarg, &_compact)) {
+				ret = -ESAFEWORD_INVARG;
+				goto fail;
+			}
+			break;
+		default:
+			ret = -ESAFEWORD_INVARG;
+			goto fail;
+		}
+	}
+
+	if (optind < argc || (_last && _compact != -1)) {
+		ret = -ESAFEWORD_INVARG;
+		goto fail;
+	}
+
+fail:
+	return ret;
+}
+
+static int print_change(const struct safeword_change *change, void *arg)
+{
+	static const char *ops[] = { "insert", "update", "delete" };
+	static const char *kinds[] = { "credential", "tag", "tagging" };
+	(void) arg;
+
+	printf("%lld\t%s\t%s\t%ld", change->seq, ops[change->op],
+		kinds[change->kind], change->id);
+	if (change->kind == SAFEWORD_CHANGE_TAGGING)
+		printf("\t%ld", change->tag_id);
+	printf("\n");
+	return 0;
+}
+
+int changesCmd_execute(void)
+{
+	int ret;
+	long long last;
+	struct safeword_db db;
+
+	ret = safeword_open(&db, NULL);
+	safeword_check(!ret, ret, fail);
+
+	if (_last) {
+		last = safeword_changes_last(&db);
+		if (last < 0) {
+			ret = -safeword_errno;
+			goto fail;
+		}
+		printf("%lld\n", last);
+	} else if (_compact != -1) {
+		if (safeword_changes_compact(&db, _compact) < 0) {
+			ret = -safeword_errno;
+			goto fail;
+		}
+	} else {
+		ret = safeword_changes(&db, _since, _limit, print_change, NULL);
+		if (ret)
+			ret = -safeword_errno;
+	}
+
+fail:
+	safeword_close(&db);
+	return ret;
+}
@@ -0,0 +1,10 @@
+#ifndef COMMAND_CHANGES_H
+#define COMMAND_CHANGES_H
+
+#include "Command.h"
+
+char* changesCmd_help(void);
+int changesCmd_parse(int arc, char** argv);
+int changesCmd_execute(void);
+
+#endif
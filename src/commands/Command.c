@@ -8,6 +8,11 @@
 #include "CopyCommand.h"
 #include "ShowCommand.h"
 #include "EditCommand.h"
+#include "BackupCommand.h"
+#include "SyncCommand.h"
+#include "ChangesCommand.h"
+#include "ImportCommand.h"
+#include "AuditCommand.h"
 
 struct command command_table[] = {
 	{"init", initCmd_help, initCmd_parse, initCmd_execute},
@@ -19,6 +24,11 @@ struct command command_table[] = {
 	{"cp", copyCmd_help, copyCmd_parse, copyCmd_execute},
 	{"show", showCmd_help, showCmd_parse, showCmd_execute},
 	{"edit", editCmd_help, editCmd_parse, editCmd_execute},
+	{"backup", backupCmd_help, backupCmd_parse, backupCmd_execute},
+	{"sync", syncCmd_help, syncCmd_parse, syncCmd_execute},
+	{"changes", changesCmd_help, changesCmd_parse, changesCmd_execute},
+	{"import", importCmd_help, importCmd_parse, importCmd_execute},
+	{"audit", auditCmd_help, auditCmd_parse, auditCmd_execute},
 };
 const size_t command_table_size = sizeof(command_table) / sizeof(command_table[0]);
 
@@ -8,6 +8,7 @@
 #include "CopyCommand.h"
 
 static unsigned int _seconds = 10;
+static int _wait;
 static int _credential_id;
 #define COPYABLE_FIELDS	2
 enum field {
@@ -19,20 +20,28 @@ static enum field _copy[COPYABLE_FIELDS];
 char* copyCmd_help(void)
 {
 	return "SYNOPSIS\n"
-"	cp [-t[SECONDS] | --time[=SECONDS]] [-u | --username] [-p | --password] ID\n"
+"	cp [-t[SECONDS] | --time[=SECONDS]] [-w | --wait] [-u | --username] [-p | --password] ID\n"
 "\n"
 "DESCRIPTION\n"
-"	This command copies a credential to the clipboard.\n"
+"	This command copies a credential to the clipboard. A background process\n"
+"	serves the clipboard so the command returns immediately; copying again\n"
+"	replaces it.\n"
 "\n"
 "OPTIONS\n"
 "	-t, --time\n"
 "	    The number of seconds before the clipboard is cleared. Default is 10 seconds.\n"
 "	    Specifying no argument is equivalent to entering 0 (entering 0 will not clear the\n"
 "	    clipboard)\n"
+"	-w, --wait\n"
+"	    Serve the clipboard from this command, returning once it is cleared.\n"
 "	-p, --password\n"
 "	    Copies the password to the clipboard.\n"
 "	-u, --username\n"
 "	    Copies the username to the clipboard.\n"
+"\n"
+"	With -u and -p each field can be pasted once, in the order given: after\n"
+"	the first paste the clipboard holds the next field. The time limit\n"
+"	applies to all of them.\n"
 "\n";
 }
 
@@ -43,20 +52,25 @@ int copyCmd_parse(int argc, char** argv)
 		{"time",	optional_argument,	NULL,	't'},
 		{"username",	no_argument,	NULL,	'u'},
 		{"password",	no_argument,	NULL,	'p'},
+		{"wait",	no_argument,	NULL,	'w'},
+		{0, 0, 0, 0},
 	};
 
-	while ((c = getopt_long(argc, argv, "upt::", long_options, 0)) != -1) {
+	while ((c = getopt_long(argc, argv, "upwt::", long_options, 0)) != -1) {
 		switch (c) {
 		case 't':
 			_seconds = optarg ? atoi(optarg) : 0;
 			break;
+		case 'w':
+			_wait = 1;
+			break;
 		case 'p':
-			_copy[i] = PASSWORD;
-			i++;
+			if (i < COPYABLE_FIELDS)
+				_copy[i++] = PASSWORD;
 			break;
 		case 'u':
-			_copy[i] = USERNAME;
-			i++;
+			if (i < COPYABLE_FIELDS)
+				_copy[i++] = USERNAME;
 			break;
 		}
 	}
@@ -77,29 +91,30 @@ int copyCmd_execute(void)
 	if (ret)
 		goto fail;
 
+	if (!_wait)
+		safeword_config("copy_background", "1");
+
 	/*
 	 * If any field options were specified, we only allow pasting each once. This allows
 	 * falling through to multiple fields, saving the user additional actions of running
 	 * this command multiple times.
 	 */
 	if (_copy[i] != 0) {
+		int fields[COPYABLE_FIELDS];
+
 		safeword_config("copy_once", "1");
 
+		/* one session serves the fields in order, a paste each */
 		do {
-			switch (_copy[i]) {
-			case USERNAME:
-				safeword_cp_username(&db, _credential_id, _seconds * 1000);
-				break;
-			case PASSWORD:
-			default:
-				safeword_cp_password(&db, _credential_id, _seconds * 1000);
-				break;
-			};
+			fields[i] = _copy[i] == USERNAME ? SAFEWORD_FIELD_USERNAME : SAFEWORD_FIELD_PASSWORD;
 			i++;
 		} while (i < COPYABLE_FIELDS && _copy[i] != 0);
+		ret = safeword_cp_fields(&db, _credential_id, fields, i, _seconds * 1000);
 	} else {
-		safeword_cp_password(&db, _credential_id, _seconds * 1000);
+		ret = safeword_cp_password(&db, _credential_id, _seconds * 1000);
 	}
+	if (ret)
+		ret = -safeword_errno;
 
 fail:
 	safeword_close(&db);
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <safeword.h>
+#include "ImportCommand.h"
+#include <safeword_errno.h>
+
+static int _format = SAFEWORD_IMPORT_KEEPASS_CSV;
+static char *_file;
+static int _quiet;
+
+char* importCmd_help(void)
+{
+	return "SYNOPSIS\n"
+"	import [-f FORMAT | --format=FORMAT] [-q | --quiet] [FILE]\n"
+"\n"
+"DESCRIPTION\n"
+"	This command imports the credentials exported to FILE, or to the standard\n"
+"	input without FILE, into the safeword database.\n"
+"\n"
+"OPTIONS\n"
+"	-f, --format=FORMAT\n"
+"	    The format of FILE. Default is keepass-csv, a CSV export of KeePass or\n"
+"	    KeePassX whose title, username, password and group are imported; each\n"
+"	    group on the group path becomes a tag.\n"
+"	-q, --quiet\n"
+"	    Do not report the number of credentials imported.\n"
+"\n";
+}
+
+int importCmd_parse(int argc, char** argv)
+{
+	int ret = 0, c;
+	struct option long_options[] = {
+		{"format",	required_argument,	NULL,	'f'},
+		{"quiet",	no_argument,	NULL,	'q'},
+		{0, 0, 0, 0},
+	};
+
+	while ((c = getopt_long(argc, argv, "f:q", long_options, 0)) != -1) {
+		switch (c) {
+		case 'f':
+			if (strcmp(optarg, "keepass-csv")) {
+				fprintf(stderr, "unknown format '%s'\n", optarg);
+				ret = -ESAFEWORD_INVARG;
+				goto fail;
+			}
+			_format = SAFEWORD_IMPORT_KEEPASS_CSV;
+			break;
+		case 'q':
+			_quiet = 1;
+			break;
+		default:
+			ret = -ESAFEWORD_INVARG;
+			goto fail;
+		}
+	}
+
+	if ((argc - optind) > 1) {
+		ret = -ESAFEWORD_INVARG;
+		goto fail;
+	}
+	if ((argc - optind) == 1) {
+		_file = calloc(strlen(argv[optind]) + 1, sizeof(char));
+		if (!_file) {
+			ret = -ESAFEWORD_NOMEM;
+			goto fail;
+		}
+		strcpy(_file, argv[optind]);
+	}
+
+fail:
+	return ret;
+}
+
+int importCmd_execute(void)
+{
+	int ret;
+	FILE *in = stdin;
+	struct safeword_db db;
+	struct safeword_import_stats stats;
+
+	if (_file && !(in = fopen(_file, "r"))) {
+		perror(_file);
+		ret = -ESAFEWORD_IO;
+		goto fail_file;
+	}
+
+	ret = safeword_open(&db, NULL);
+	safeword_check(!ret, ret, fail);
+
+	ret = safeword_import(&db, in, _format, &stats);
+	if (ret) {
+		ret = -safeword_errno;
+		fprintf(stderr, "%s:%u: import stopped, %u credentials imported\n",
+			_file ? _file : "stdin", stats.line, stats.imported);
+	} else if (!_quiet) {
+		printf("imported %u credentials\n", stats.imported);
+	}
+
+fail:
+	safeword_close(&db);
+	if (in != stdin)
+		fclose(in);
+fail_file:
+	free(_file);
+	return ret;
+}
@@ -0,0 +1,10 @@
+#ifndef COMMAND_IMPORT_H
+#define COMMAND_IMPORT_H
+
+#include "Command.h"
+
+char* importCmd_help(void);
+int importCmd_parse(int arc, char** argv);
+int importCmd_execute(void);
+
+#endif
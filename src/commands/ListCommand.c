@@ -9,36 +9,90 @@
 #include "ListCommand.h"
 
 int printAll;
+static int recent;
 static char** tags;
 static int tags_size;
+static struct safeword_list_options options;
 
 char* listCmd_help(void)
 {
 	return "SYNOPSIS\n"
-"	list [-a | --all] [ TAGS ... ]\n"
+"	list [-a | --all] [--sort id|description] [--limit N]\n"
+"	     [--after ID] [--after-key DESCRIPTION] [ TAGS ... ]\n"
+"	list (-r | --recent) [--limit N]\n"
 "DESCRIPTION\n"
 "	This command lists the credentials stored in the safeword database.\n"
 "	Without any arguments only credentials with tags are displayed,\n"
 "	otherwise only credentials with the specified tags are displayed.\n"
+"	Tags ignore case, and a tag ending in '*' or ':' (env:* or env:)\n"
+"	matches every tag starting with it.\n"
 "\n"
 "OPTIONS\n"
 "	-a, --all\n"
 "	    list all credentials\n"
+"	-r, --recent\n"
+"	    list the credentials last shown or copied, most recent first\n"
+"	--sort id|description\n"
+"	    order credentials by id (default) or by description\n"
+"	-n, --limit N\n"
+"	    list at most N credentials\n"
+"	--after ID\n"
+"	    continue listing after the credential with this id, usually the\n"
+"	    last one of the previous page\n"
+"	--after-key DESCRIPTION\n"
+"	    continue listing after this description when sorting by description\n"
 "\n";
 }
 
 int listCmd_parse(int argc, char** argv)
 {
 	int i, remaining_args = 0, c;
+	char *end;
 	struct option long_options[] = {
 		{"all",	no_argument,	NULL,	'a'},
+		{"recent",	no_argument,	NULL,	'r'},
+		{"limit",	required_argument,	NULL,	'n'},
+		{"sort",	required_argument,	NULL,	's'},
+		{"after",	required_argument,	NULL,	'i'},
+		{"after-key",	required_argument,	NULL,	'k'},
+		{0, 0, 0, 0},
 	};
 
-	while ((c = getopt_long(argc, argv, "a", long_options, 0)) != -1) {
+	while ((c = getopt_long(argc, argv, "arn:", long_options, 0)) != -1) {
 		switch (c) {
 		case 'a':
 			printAll = 1;
 			break;
+		case 'r':
+			recent = 1;
+			break;
+		case 'n':
+			options.limit = strtoul(optarg, &end, 10);
+			if (*end != '\0' || *optarg == '-') {
+				fprintf(stderr, "invalid limit '%s'\n", optarg);
+				return -ESAFEWORD_INVARG;
+			}
+			break;
+		case 's':
+			if (!strcmp(optarg, "id")) {
+				options.sort = SAFEWORD_SORT_ID;
+			} else if (!strcmp(optarg, "description")) {
+				options.sort = SAFEWORD_SORT_DESCRIPTION;
+			} else {
+				fprintf(stderr, "invalid sort '%s'\n", optarg);
+				return -ESAFEWORD_INVARG;
+			}
+			break;
+		case 'i':
+			options.after_id = strtol(optarg, &end, 10);
+			if (*end != '\0' || options.after_id < 0) {
+				fprintf(stderr, "invalid id '%s'\n", optarg);
+				return -ESAFEWORD_INVARG;
+			}
+			break;
+		case 'k':
+			options.after_description = optarg;
+			break;
 		}
 	}
 
@@ -49,7 +103,7 @@ int listCmd_parse(int argc, char** argv)
 		safeword_check(tags, -ENOMEM, fail);
 
 		for (i = 0; i < remaining_args; i++) {
-			tags[i] = calloc(strlen(argv[optind]), sizeof(char));
+			tags[i] = calloc(strlen(argv[optind]) + 1, sizeof(char));
 			safeword_check(tags[i], -ENOMEM, fail);
 
 			strcpy(tags[i], argv[optind]);
@@ -62,6 +116,12 @@ fail:
 	return 0;
 }
 
+static int print_credential(struct safeword_credential *credential, void *not_used)
+{
+	printf("%d : %s\n", credential->id, credential->description ? credential->description : "");
+	return 0;
+}
+
 int listCmd_execute(void)
 {
 	int ret = 0, i;
@@ -70,13 +130,15 @@ int listCmd_execute(void)
 	ret = safeword_open(&db, 0);
 	safeword_check(!ret, ret, fail);
 
-	if (tags && !printAll) {
-		safeword_list_credentials(&db, tags_size, tags);
+	if (recent) {
+		ret = safeword_list_recent(&db, options.limit, print_credential, NULL);
+	} else if (tags && !printAll) {
+		ret = safeword_list_credentials_page(&db, tags_size, tags, &options, print_credential, NULL);
 	} else {
 		if (printAll) {
-			safeword_list_credentials(&db, UINT_MAX, 0);
+			ret = safeword_list_credentials_page(&db, UINT_MAX, 0, &options, print_credential, NULL);
 		} else {
-			safeword_list_credentials(&db, 0, 0);
+			ret = safeword_list_credentials_page(&db, 0, 0, &options, print_credential, NULL);
 		}
 	}
 
@@ -1,77 +1,218 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <getopt.h>
 
 #include <safeword.h>
 #include "ShowCommand.h"
 
 static int _credential_id;
 static char* _tag;
+static long int *_credential_ids;
+static unsigned int _credential_ids_size;
+static char *_tagged;
 
 char* showCmd_help(void)
 {
 	return "SYNOPSIS\n"
-"	show [ID | tag]\n"
+"	show [ID | ID1,ID2,... | tag]\n"
+"	show [-t | --tag] TAG\n"
 "\n"
 "DESCRIPTION\n"
 "	This command displays information about a credential or tag in the safeword database.\n"
+"	Several credentials are separated by an empty line.\n"
+"\n"
+"OPTIONS\n"
+"	-t, --tag TAG\n"
+"	    Show every credential tagged TAG.\n"
 "\n";
 }
 
+/* the ids in @c list, separated by commas, 0 if its first is not an id */
+static int parse_ids(const char *list)
+{
+	unsigned int size = 1;
+	const char *at;
+	char *end;
+
+	for (at = list; *at; at++)
+		size += *at == ',';
+	_credential_ids = calloc(size, sizeof(*_credential_ids));
+	safeword_check(_credential_ids, -ESAFEWORD_NOMEM, fail);
+
+	for (at = list; _credential_ids_size < size; at = end + 1) {
+		_credential_ids[_credential_ids_size] = strtol(at, &end, 10);
+		/* we assume there will never be a credential id of 0 */
+		if (!_credential_ids[_credential_ids_size])
+			break;
+		_credential_ids_size++;
+		if (*end != ',')
+			break;
+	}
+
+	return 0;
+fail:
+	return -ESAFEWORD_NOMEM;
+}
+
 int showCmd_parse(int argc, char** argv)
 {
-	int ret = 0;
-	char *invalid = 0;
+	int ret = 0, c;
+	struct option long_options[] = {
+		{"tag",	required_argument,	NULL,	't'},
+		{0, 0, 0, 0},
+	};
 
-	if (argc < 2)
+	while ((c = getopt_long(argc, argv, "t:", long_options, 0)) != -1) {
+		switch (c) {
+		case 't':
+			_tagged = optarg;
+			break;
+		default:
+			return -ESAFEWORD_INVARG;
+		}
+	}
+
+	if (optind >= argc)
 		return ret;
+	if (_tagged)
+		return -ESAFEWORD_INVARG;
 
-	_credential_id = strtol(argv[1], &invalid, 10);
-	if (!_credential_id) {
-		_tag = calloc(strlen(argv[1]) + 1, sizeof(char));
-		strcpy(_tag, argv[1]);
-		/* we assume there will never be a credential id of 0 */
-		_credential_id = 0;
+	ret = parse_ids(argv[optind]);
+	if (ret)
+		return ret;
+	if (_credential_ids_size == 1) {
+		_credential_id = _credential_ids[0];
+	} else if (!_credential_ids_size) {
+		_tag = calloc(strlen(argv[optind]) + 1, sizeof(char));
+		strcpy(_tag, argv[optind]);
 	}
 
 	return ret;
 }
 
+/* print straight from the row so nothing is copied */
+static void print_field(struct safeword_cursor *cursor, const char *label, int field)
+{
+	size_t size;
+	const char *text = safeword_cursor_text(cursor, field, &size);
+
+	fputs(label, stdout);
+	if (text)
+		fwrite(text, 1, size, stdout);
+}
+
+static void print_credential(struct safeword_credential *credential)
+{
+	unsigned int i;
+
+	printf("%s\nusername:%s\npassword:%s\n",
+		credential->description ? credential->description : "",
+		credential->username ? credential->username : "",
+		credential->password ? credential->password : "");
+	for (i = 0; i < credential->tags_size; i++)
+		printf(i ? ", %s" : "%s", credential->tags[i]);
+	if (i) printf("\n");
+}
+
+static int collect_id(struct safeword_credential *credential, void *arg)
+{
+	long int *grown;
+
+	/* grown whenever the size reaches a power of two */
+	if (!(_credential_ids_size & (_credential_ids_size - 1))) {
+		grown = realloc(_credential_ids, 2 * (_credential_ids_size + 1) * sizeof(*grown));
+		if (!grown) {
+			*(int*) arg = -ESAFEWORD_NOMEM;
+			return 1;
+		}
+		_credential_ids = grown;
+	}
+	_credential_ids[_credential_ids_size++] = credential->id;
+	return 0;
+}
+
+/* read the credentials all at once, rather than with a few queries each */
+static int print_credentials(struct safeword_db *db)
+{
+	int printed = 0;
+	unsigned int i;
+	struct safeword_credential *credentials;
+
+	credentials = calloc(_credential_ids_size ? _credential_ids_size : 1, sizeof(*credentials));
+	safeword_check(credentials, -ESAFEWORD_NOMEM, fail);
+	if (safeword_credential_read_many(db, _credential_ids, _credential_ids_size, credentials)) {
+		free(credentials);
+		return -safeword_errno;
+	}
+
+	for (i = 0; i < _credential_ids_size; i++) {
+		if (!credentials[i].id)
+			continue;
+		if (printed++)
+			printf("\n");
+		print_credential(&credentials[i]);
+		safeword_credential_free(&credentials[i]);
+	}
+	free(credentials);
+
+	return 0;
+fail:
+	return -ESAFEWORD_NOMEM;
+}
+
 int showCmd_execute(void)
 {
-	int i, ret;
+	int i, ret, error = 0;
+	char *tags[1];
+	size_t wiki_size;
 	struct safeword_db db;
-	struct safeword_credential credential;
-	struct safeword_tag tag;
-
-	memset(&tag, 0, sizeof(tag));
-	memset(&credential, 0, sizeof(credential));
+	struct safeword_cursor cursor;
 
 	ret = safeword_open(&db, 0);
 	safeword_check(!ret, ret, fail);
 
-	if (_credential_id) {
-		credential.id = _credential_id;
-		ret = safeword_credential_read(&db, &credential);
-		printf("%s\nusername:%s\npassword:%s\n",
-			credential.description, credential.username, credential.password);
-		for (i = 0; i < credential.tags_size; i++) {
-			if (i != 0)
-				printf(", ");
-			printf("%s", credential.tags[i]);
+	if (_tagged) {
+		tags[0] = _tagged;
+		free(_credential_ids);
+		_credential_ids = NULL;
+		_credential_ids_size = 0;
+		ret = safeword_list_credentials_foreach(&db, 1, tags, collect_id, &error);
+		safeword_check(!ret, -safeword_errno, fail);
+		if (error) {
+			ret = error;
+			goto fail;
 		}
-		if (credential.tags_size) printf("\n");
-	} else {
-		memset(&tag, 0, sizeof(tag));
-		tag.tag = _tag;
-		ret = safeword_tag_read(&db, &tag);
-		if (tag.wiki)
-			printf("%s\n", tag.wiki);
+		ret = print_credentials(&db);
+	} else if (_credential_ids_size > 1) {
+		ret = print_credentials(&db);
+	} else if (_credential_id) {
+		ret = safeword_cursor_credential(&db, &cursor, _credential_id);
+		safeword_check(!ret, safeword_errno, fail);
+		if (safeword_cursor_next(&cursor) == 1) {
+			print_field(&cursor, "", SAFEWORD_FIELD_DESCRIPTION);
+			print_field(&cursor, "\nusername:", SAFEWORD_FIELD_USERNAME);
+			print_field(&cursor, "\npassword:", SAFEWORD_FIELD_PASSWORD);
+			printf("\n");
+		}
+		safeword_cursor_close(&cursor);
 
+		ret = safeword_cursor_credential_tags(&db, &cursor, _credential_id);
+		safeword_check(!ret, safeword_errno, fail);
+		for (i = 0; safeword_cursor_next(&cursor) == 1; i++)
+			print_field(&cursor, i ? ", " : "", SAFEWORD_FIELD_TAGS);
+		if (i) printf("\n");
+		safeword_cursor_close(&cursor);
+	} else {
+		ret = safeword_tag_wiki_read(&db, _tag, stdout, &wiki_size);
+		safeword_check(!ret, -safeword_errno, fail);
+		if (wiki_size)
+			printf("\n");
 	}
 
 fail:
 	free(_tag);
+	free(_credential_ids);
 	safeword_close(&db);
 	return ret;
 }
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <safeword.h>
+#include "SyncCommand.h"
+
+static char *_path;
+static char *_peer;
+static int _quiet;
+
+char* syncCmd_help(void)
+{
+	return "SYNOPSIS\n"
+"	sync [-q | --quiet] [A] B\n"
+"\n"
+"DESCRIPTION\n"
+"	This command merges the safeword databases A and B both ways. A defaults\n"
+"	to the SAFEWORD_DB database. Only the changes made since the two were\n"
+"	last synced are exchanged; a credential changed in both keeps the later\n"
+"	change.\n"
+"\n"
+"OPTIONS\n"
+"	-q, --quiet\n"
+"	    Do not report the number of changes exchanged.\n"
+"\n";
+}
+
+static char *copy_arg(const char *arg)
+{
+	char *copy = calloc(strlen(arg) + 1, sizeof(char));
+
+	if (copy)
+		strcpy(copy, arg);
+	return copy;
+}
+
+int syncCmd_parse(int argc, char** argv)
+{
+	int ret = 0, c;
+	struct option long_options[] = {
+		{"quiet",	no_argument,	NULL,	'q'},
+		{0, 0, 0, 0},
+	};
+
+	while ((c = getopt_long(argc, argv, "q", long_options, 0)) != -1) {
+		switch (c) {
+		case 'q':
+			_quiet = 1;
+			break;
+		default:
+			ret = -ESAFEWORD_INVARG;
+			goto fail;
+		}
+	}
+
+	if ((argc - optind) > 2) {
+		ret = -ESAFEWORD_INVARG;
+		goto fail;
+	}
+	if ((argc - optind) == 2) {
+		_path = copy_arg(argv[optind++]);
+		if (!_path) {
+			ret = -ESAFEWORD_NOMEM;
+			goto fail;
+		}
+	}
+	if ((argc - optind) == 1) {
+		_peer = copy_arg(argv[optind]);
+		if (!_peer) {
+			ret = -ESAFEWORD_NOMEM;
+			goto fail;
+		}
+	}
+
+fail:
+	return ret;
+}
+
+int syncCmd_execute(void)
+{
+	int ret;
+	struct safeword_db db;
+	struct safeword_sync_stats stats;
+
+	if (!_peer) {
+		fprintf(stderr, "no database to sync with specified\n");
+		ret = -ESAFEWORD_INVARG;
+		goto fail_args;
+	}
+
+	ret = safeword_open(&db, _path);
+	safeword_check(!ret, ret, fail);
+
+	ret = safeword_sync(&db, _peer, &stats);
+	if (ret) {
+		ret = -safeword_errno;
+		goto fail;
+	}
+	if (!_quiet)
+		printf("received %u, sent %u, %u conflicts\n",
+			stats.received, stats.sent, stats.conflicts);
+
+fail:
+	safeword_close(&db);
+fail_args:
+	free(_path);
+	free(_peer);
+	return ret;
+}
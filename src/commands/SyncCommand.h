@@ -0,0 +1,10 @@
+#ifndef COMMAND_SYNC_H
+#define COMMAND_SYNC_H
+
+#include "Command.h"
+
+char* syncCmd_help(void);
+int syncCmd_parse(int arc, char** argv);
+int syncCmd_execute(void);
+
+#endif
@@ -3,6 +3,7 @@
 #include <string.h>
 #include <errno.h>
 #include <getopt.h>
+#include <time.h>
 
 #include <safeword.h>
 #include <safeword_errno.h>
@@ -14,6 +15,9 @@ static int _force = 0;
 static int _untag = 0;
 static FILE *_wiki_file;
 static int _filter = 0;
+static int _namespace = 0;
+static int _stats = 0;
+static char *_namespace_name;
 
 struct array {
 	unsigned int size;
@@ -38,6 +42,9 @@ char* tagCmd_help(void)
 {
 	return "SYNOPSIS\n"
 "	tag [-d | --delete] [-f | --force] [-m | --move] [-w | --wiki] [ID1,ID2,...] TAGS ...\n"
+"	tag --filter TAGS ...\n"
+"	tag --namespace[=NAMESPACE]\n"
+"	tag --stats\n"
 "\n"
 "DESCRIPTION\n"
 "	This command serves multiple purposes dealing with tags within the safeword database. Without any\n"
@@ -58,6 +65,15 @@ char* tagCmd_help(void)
 "	    input is read from stdin.\n"
 "	-u, --untag\n"
 "	    Untag the specified tags from the specified credentials.\n"
+"	--filter TAGS ...\n"
+"	    List the tags that share a credential with all of TAGS. A tag\n"
+"	    ending in '*' or ':' (env:* or env:) lists the tags starting with it.\n"
+"	--namespace[=NAMESPACE]\n"
+"	    List the tag namespaces (the part of a tag before ':'), or the tags\n"
+"	    in NAMESPACE.\n"
+"	--stats\n"
+"	    List each tag with the number of credentials carrying it and when it\n"
+"	    was last mapped or unmapped, most used tag first.\n"
 "\n";
 }
 
@@ -121,9 +137,6 @@ static int update_tag(struct safeword_db* db, void *update_info)
 {
 	int ret = 0;
 	struct update_info *info = (struct update_info*) update_info;
-	long wiki_size;
-	char *wiki;
-	struct safeword_tag *tag;
 
 	if (!info || !info->tag) {
 		fprintf(stderr, "no tags specified\n");
@@ -135,47 +148,13 @@ static int update_tag(struct safeword_db* db, void *update_info)
 		return -ESAFEWORD_INVARG;
 	}
 
-	if (info->file != stdin) {
-		ret = fseek(info->file, 0, SEEK_END);
-		safeword_check(ret != -1, -ESAFEWORD_IO, fail);
+	/* streamed, so the wiki is never held in memory */
+	ret = safeword_tag_wiki_write(db, info->tag, info->file);
+	if (ret)
+		ret = -safeword_errno;
 
-		wiki_size = ftell(info->file);
-		safeword_check(wiki_size != -1, -ESAFEWORD_IO, fail);
-
-		ret = fseek(info->file, 0, SEEK_SET);
-		safeword_check(ret != -1, -ESAFEWORD_IO, fail);
-
-		wiki = calloc(wiki_size + 1, sizeof(char));
-		safeword_check(wiki, -ENOMEM, fail);
-
-		ret = fread(wiki, 1, wiki_size, info->file);
-		safeword_check(ret == wiki_size, -ESAFEWORD_IO, fail);
-	} else {
-		char buffer[1024];
-		buffer[0] = '\0';
-		wiki_size = 0;
-
-		wiki = calloc(1024, sizeof(char));
-		safeword_check(wiki, -ENOMEM, fail);
-
-		while (fgets(buffer, 1024, info->file)) {
-			char *old = wiki;
-			wiki_size += strlen(buffer);
-			wiki = realloc(wiki, wiki_size + 1);
-			if (!wiki) {
-				ret = -ENOMEM;
-				free(old);
-				goto fail;
-			}
-			strcat(wiki, buffer);
-		}
-	}
-
-	tag = safeword_tag_create(info->tag, wiki);
-	safeword_tag_update(db, tag);
-
-fail:
-	free(wiki);
+	if (info->file != stdin)
+		fclose(info->file);
 	return ret;
 }
 
@@ -189,6 +168,9 @@ int tagCmd_parse(int argc, char** argv)
 		{"wiki",   required_argument, NULL, 'w'},
 		{"untag",  no_argument,       NULL, 'u'},
 		{"filter", no_argument,       0,     0},
+		{"namespace", optional_argument, 0,  0},
+		{"stats",  no_argument,       0,     0},
+		{0, 0, 0, 0},
 	};
 
 	_subcommand.execute = NULL;
@@ -221,6 +203,15 @@ int tagCmd_parse(int argc, char** argv)
 		case 0:
 			if (!strcmp(long_options[option_index].name, "filter")) {
 				_filter = 1;
+			} else if (!strcmp(long_options[option_index].name, "stats")) {
+				_stats = 1;
+			} else if (!strcmp(long_options[option_index].name, "namespace")) {
+				_namespace = 1;
+				if (optarg) {
+					_namespace_name = malloc(strlen(optarg) + 2);
+					safeword_check(_namespace_name, -ENOMEM, fail);
+					sprintf(_namespace_name, "%s:", optarg);
+				}
 			}
 			break;
 		}
@@ -229,7 +220,7 @@ int tagCmd_parse(int argc, char** argv)
 	remaining_args = argc - optind;
 
 	/* START of parsing credential ids */
-	if (!_subcommand.execute && remaining_args > 0 && !_filter) {
+	if (!_subcommand.execute && remaining_args > 0 && !_filter && !_namespace && !_stats) {
 		int i = 0, id;
 		char *id_str, *ids_backup, **tags;
 
@@ -302,9 +293,46 @@ int tagCmd_execute(void)
 	} else if (_subcommand.execute == &update_tag) {
 	/* Update the tag info. */
 		struct update_info info;
-		info.tag = _tags->data[0];
+		info.tag = _tags->size ? _tags->data[0] : NULL;
 		info.file = _wiki_file;
-		_subcommand.execute(&db, &info);
+		ret = _subcommand.execute(&db, &info);
+	} else if (_stats) {
+	/* List the tags by use. */
+		struct safeword_tag_stats *stats;
+		unsigned int stats_size;
+		char modified[32];
+		time_t when;
+
+		ret = safeword_list_tag_stats(&db, &stats_size, &stats);
+		safeword_check(ret == 0, safeword_errno, fail);
+		for (i = 0; i < stats_size; i++) {
+			when = (time_t) stats[i].modified;
+			if (!when || !strftime(modified, sizeof(modified), "%Y-%m-%d %H:%M", localtime(&when)))
+				strcpy(modified, "-");
+			printf("%u\t%s\t%s\n", stats[i].count, stats[i].tag, modified);
+		}
+		safeword_tag_stats_free(stats_size, stats);
+	} else if (_namespace && _namespace_name) {
+	/* List the tags in the namespace. */
+		char **tags;
+		unsigned int tags_size;
+		const char *filter[] = { _namespace_name };
+
+		ret = safeword_list_tags(&db, &tags_size, &tags, 1, filter);
+		safeword_check(ret == 0, safeword_errno, fail);
+		for (i = 0; i < tags_size; i++)
+			printf("%s\n", tags[i]);
+		safeword_tags_free(tags_size, tags);
+	} else if (_namespace) {
+	/* List the namespaces. */
+		char **namespaces;
+		unsigned int namespaces_size;
+
+		ret = safeword_list_namespaces(&db, &namespaces_size, &namespaces);
+		safeword_check(ret == 0, safeword_errno, fail);
+		for (i = 0; i < namespaces_size; i++)
+			printf("%s\n", namespaces[i]);
+		safeword_tags_free(namespaces_size, namespaces);
 	} else if (_tags && _filter) {
 		char **tags;
 		unsigned int tags_size;
@@ -314,15 +342,17 @@ int tagCmd_execute(void)
 
 			for (i = 0; i < tags_size; i++)
 				printf("%s\n", tags[i]);
+			safeword_tags_free(tags_size, tags);
 		}
 	} else if (_tags && _credential_ids) {
 		if (_tags->size < 1) {
 	/* Print the tags associated with the specified credentials. */
 			for (i = 0; i < _credential_ids_size; i++) {
-				struct safeword_credential cred;
+				struct safeword_credential cred = { 0 };
 				cred.id = _credential_ids[i];
-				ret = safeword_credential_read(&db, &cred);
+				ret = safeword_credential_read_fields(&db, &cred, SAFEWORD_FIELD_TAGS);
 				safeword_check(ret == 0, safeword_errno, fail);
+				safeword_credential_free(&cred);
 				/*
 				 * TODO implement Set utility class/module in order to add all tags
 				 * from all credentials omitting duplicates.
@@ -348,12 +378,14 @@ int tagCmd_execute(void)
 
 		for (i = 0; i < tags_size; i++)
 			printf("%s\n", tags[i]);
+		safeword_tags_free(tags_size, tags);
 	}
 
 fail:
 	for (i = 0; i < _tags->size; i++)
 		free(_tags->data[i]);
 	free(_tags);
+	free(_namespace_name);
 	safeword_close(&db);
 	return ret;
 }
@@ -9,7 +9,7 @@
 
 void print_usage()
 {
-	printf("safeword COMMAND [OPTIONS] [ARGS]\n");
+	printf("safeword [--version] [--explain] COMMAND [OPTIONS] [ARGS]\n");
 }
 
 void print_version()
@@ -39,10 +39,25 @@ void print_possible_commands(const char* command_str)
 	}
 }
 
+/* shown while safeword_open upgrades an older database */
+int print_migrate_progress(int version, long int done, long int total, void *arg)
+{
+	fprintf(stderr, "\rupgrading database to schema version %d: %ld%%", version,
+		total ? done * 100 / total : 100);
+	if (done >= total)
+		fprintf(stderr, "\n");
+	return 0;
+}
+
 int main(int argc, char** argv)
 {
 	const char* command_str;
 	int res = 0, i, command_index = 1;
+	long long started, span = 0;
+
+	if (safeword_trace_open(getenv("SAFEWORD_TRACE")))
+		fprintf(stderr, "could not open trace '%s'\n", getenv("SAFEWORD_TRACE"));
+	started = safeword_trace_enabled ? safeword_trace_now() : 0;
 
 	/* process any options before subcommand */
 	for (i = 1; i < argc; i++) {
@@ -50,6 +65,8 @@ int main(int argc, char** argv)
 			if (!strcmp("-v", argv[i]) || !strcmp("--version", argv[i])) {
 				print_version();
 				return 0;
+			} else if (!strcmp("--explain", argv[i])) {
+				safeword_explain(1);
 			} else {
 				fprintf(stderr, "unknown option '%s'\n", argv[i]);
 				return 1;
@@ -60,14 +77,20 @@ int main(int argc, char** argv)
 		}
 	}
 
-	/* minimum of 2 parameters (safeword command itself and a subcommand) */
-	if (argc < 2) {
+	/* a subcommand is required after the options */
+	if (command_index >= argc) {
 		print_usage();
 		print_supported_commands();
 		return 0;
 	}
 
-	command_str = argv[command_index];
+	/* the subcommand parses its arguments as if it were argv[0] */
+	argc -= command_index;
+	argv += command_index;
+	command_str = argv[0];
+
+	if (isatty(STDERR_FILENO))
+		safeword_open_progress(print_migrate_progress, NULL);
 
 	if (command_str) {
 		int i, matches = 0, command_index = -1;
@@ -80,10 +103,17 @@ int main(int argc, char** argv)
 		}
 
 		if (command_index >= 0 && matches == 1) {
-			res = command_table[command_index].parse(--argc, ++argv);
+			safeword_trace_span("cli", "startup", started, NULL, -1);
+			if (safeword_trace_enabled)
+				span = safeword_trace_now();
+			res = command_table[command_index].parse(argc, argv);
+			safeword_trace_span("cli", "parse", span, command_table[command_index].name, -1);
 			switch (res) {
 			case 0:
+				if (safeword_trace_enabled)
+					span = safeword_trace_now();
 				res = command_table[command_index].execute();
+				safeword_trace_span("cli", "execute", span, command_table[command_index].name, -1);
 				switch (res) {
 				case 0:
 					break;
@@ -104,5 +134,14 @@ int main(int argc, char** argv)
 		}
 	}
 
+	if (safeword_trace_enabled) {
+		/* whatever is still buffered is written to the terminal or pipe here */
+		span = safeword_trace_now();
+		fflush(stdout);
+		safeword_trace_span("cli", "output", span, NULL, -1);
+		safeword_trace_span("cli", "safeword", started, command_str, -1);
+		safeword_trace_close();
+	}
+
 	return 0;
 }
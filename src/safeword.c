@@ -3,23 +3,32 @@
 #include <string.h>
 #include <unistd.h>
 #include <time.h>
-#include <pthread.h>
 #include <limits.h>
+#include <stdint.h>
+#include <sys/stat.h>
 
 #ifdef WIN32
 #include "windows.h"
 #else
-#include <X11/Xlib.h>
-#include <X11/Xatom.h>
-#include <X11/Xmu/Atoms.h>
+#include <dlfcn.h>
+#endif
+#ifdef SAFEWORD_ZLIB
+#include <zlib.h>
 #endif
 
 #include "dbg.h"
 #include "safeword.h"
 #include "commands/Command.h"
 
-int safeword_errno = 0;
+__thread int safeword_errno = 0;
 static int _copy_once = 0;
+static int _copy_background = 0;
+static int _compress = 1;
+static safeword_progress_callback _open_progress = NULL;
+static void *_open_progress_arg = NULL;
+
+static sqlite3_stmt *get_filter_prepared_stmt(struct safeword_db *db, unsigned int filter_size, const char **filter,
+	int select_count);
 
 char* safeword_strerror(int errnum)
 {
@@ -39,6 +48,24 @@ char* safeword_strerror(int errnum)
 	case ESAFEWORD_NOCREDENTIAL:
 	case -ESAFEWORD_NOCREDENTIAL:
 		return "Credential does not exist";
+	case ESAFEWORD_CANCELED:
+	case -ESAFEWORD_CANCELED:
+		return "Request canceled";
+	case ESAFEWORD_SCHEMA:
+	case -ESAFEWORD_SCHEMA:
+		return "Database schema is newer than supported";
+	case ESAFEWORD_NOCLIPBOARD:
+	case -ESAFEWORD_NOCLIPBOARD:
+		return "Clipboard is not available";
+	case ESAFEWORD_COMPACTED:
+	case -ESAFEWORD_COMPACTED:
+		return "Changes were compacted";
+	case ESAFEWORD_FORMAT:
+	case -ESAFEWORD_FORMAT:
+		return "Import could not be read";
+	case ESAFEWORD_COMPRESSED:
+	case -ESAFEWORD_COMPRESSED:
+		return "Compressed data could not be read";
 	default:
 		return strerror(errnum);
 	}
@@ -57,6 +84,10 @@ int safeword_config(const char* key, const char* value)
 	if (!strcmp(key, "copy_once")) {
 		if (strlen(value) == 1 && value[0] == '1')
 			_copy_once = 1;
+	} else if (!strcmp(key, "copy_background")) {
+		_copy_background = strlen(value) == 1 && value[0] == '1';
+	} else if (!strcmp(key, "compress")) {
+		_compress = strlen(value) == 1 && value[0] == '1';
 	} else
 		return -1;
 
@@ -65,21 +96,13 @@ int safeword_config(const char* key, const char* value)
 
 /* #region safeword init function */
 
-int safeword_init(const char *path)
+/* create the version 0 tables, migrations take it from there */
+static int create_schema(sqlite3 *handle)
 {
 	int ret = 0;
-	sqlite3* handle;
 	sqlite3_stmt *stmt = NULL;
 	char sql[512];
 
-	safeword_check(path, ESAFEWORD_INVARG, fail);
-
-	/* ensure that path does not already exist */
-	safeword_check(access(path, F_OK) == -1, ESAFEWORD_DBEXIST, fail);
-
-	ret = sqlite3_open(path, &handle);
-	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
-
 	sprintf(sql, "CREATE TABLE IF NOT EXISTS tags "
 		"(id INTEGER PRIMARY KEY, "
 		"tag TEXT NOT NULL, "
@@ -133,14 +156,48 @@ int safeword_init(const char *path)
 	sprintf(sql, "INSERT INTO properties VALUES ( ?, ? );");
 	ret = sqlite3_prepare_v2(handle, sql, strlen(sql) + 1, &stmt, NULL);
 	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
-	ret = sqlite3_bind_text(stmt, 1, "version", strlen("version") + 1, SQLITE_STATIC);
+	ret = sqlite3_bind_text(stmt, 1, "version", strlen("version"), SQLITE_STATIC);
 	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
-	ret = sqlite3_bind_text(stmt, 2, SAFEWORD_VERSION, strlen(SAFEWORD_VERSION) + 1, SQLITE_STATIC);
+	/* the tables above are schema version 0, migrations take it from there */
+	ret = sqlite3_bind_text(stmt, 2, "0", 1, SQLITE_STATIC);
 	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
 	ret = sqlite3_step(stmt);
 	ret = sqlite3_finalize(stmt);
 	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
 
+	return 0;
+fail:
+	return -1;
+}
+
+int safeword_init(const char *path)
+{
+	int ret = 0;
+	sqlite3* handle;
+	struct safeword_db db;
+
+	safeword_check(path, ESAFEWORD_INVARG, fail);
+
+	/* ensure that path does not already exist */
+	safeword_check(access(path, F_OK) == -1, ESAFEWORD_DBEXIST, fail);
+
+	ret = sqlite3_open(path, &handle);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+	safeword_trace_db(handle);
+
+	ret = create_schema(handle);
+	safeword_check(!ret, safeword_errno, fail);
+
+	db.path = (char *) path;
+	db.save_path = NULL;
+	db.handle = handle;
+	db.accesses = NULL;
+	db.accesses_size = 0;
+	db.accesses_capacity = 0;
+	ret = safeword_migrate(&db, 0, NULL, NULL);
+	safeword_check(!ret, safeword_errno, fail);
+
+	safeword_explain_db(handle);
 	sqlite3_close(handle);
 
 	return 0;
@@ -152,9 +209,93 @@ fail:
 
 /* #region safeword open & close */
 
+/*
+ * Copy the whole database between the in-memory @c handle and the file
+ * @c path, into memory unless @c save. Saving never creates the file.
+ */
+static int copy_database(sqlite3 *handle, const char *path, int save)
+{
+	int ret;
+	sqlite3 *file = NULL;
+	sqlite3_backup *backup;
+
+	ret = sqlite3_open_v2(path, &file,
+		save ? SQLITE_OPEN_READWRITE : SQLITE_OPEN_READONLY, NULL);
+	if (ret != SQLITE_OK)
+		goto fail;
+	safeword_trace_db(file);
+
+	backup = sqlite3_backup_init(save ? file : handle, "main", save ? handle : file, "main");
+	if (!backup) {
+		ret = sqlite3_errcode(save ? file : handle);
+		goto fail;
+	}
+	/* the file is locked for a single step, there is nothing to interleave */
+	sqlite3_backup_step(backup, -1);
+	ret = sqlite3_backup_finish(backup);
+fail:
+	sqlite3_close(file);
+	return ret;
+}
+
+/*
+ * Open the in-memory database named by db->path, either empty or loaded from
+ * the file following the prefix. Only a memory+save: vault keeps the file in
+ * db->save_path to write back in safeword_close.
+ */
+static int open_memory(struct safeword_db *db)
+{
+	int ret = 0;
+	const char *file = NULL;
+	long long start;
+
+	if (!strncmp(db->path, SAFEWORD_MEMORY_SAVE_PREFIX, strlen(SAFEWORD_MEMORY_SAVE_PREFIX)))
+		file = db->path + strlen(SAFEWORD_MEMORY_SAVE_PREFIX);
+	else if (!strncmp(db->path, SAFEWORD_MEMORY_PREFIX, strlen(SAFEWORD_MEMORY_PREFIX)))
+		file = db->path + strlen(SAFEWORD_MEMORY_PREFIX);
+
+	ret = sqlite3_open(":memory:", &(db->handle));
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+	safeword_trace_db(db->handle);
+
+	if (!file) {
+		ret = create_schema(db->handle);
+		safeword_check(!ret, safeword_errno, fail);
+		return 0;
+	}
+
+	ret = access(file, F_OK);
+	if (ret)
+		debug("safeword database '%s' does not exist", file);
+	safeword_check(ret == 0, ESAFEWORD_DBEXIST, fail);
+
+	start = safeword_trace_enabled ? safeword_trace_now() : 0;
+	ret = copy_database(db->handle, file, 0);
+	safeword_trace_span("db", "safeword_load", start, file, -1);
+	if (ret)
+		debug("failed to load safeword database '%s'", file);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+
+	if (file == db->path + strlen(SAFEWORD_MEMORY_SAVE_PREFIX))
+		db->save_path = file;
+
+	return 0;
+fail:
+	return -1;
+}
+
 int safeword_open(struct safeword_db *db, const char *path)
 {
 	int ret = 0;
+	long long start = safeword_trace_enabled ? safeword_trace_now() : 0;
+
+	/* safeword_close is safe to call even if opening fails below */
+	db->path = NULL;
+	db->save_path = NULL;
+	db->handle = NULL;
+	db->accesses = NULL;
+	db->accesses_size = 0;
+	db->accesses_capacity = 0;
 
 	if (path) {
 		db->path = calloc(strlen(path) + 1, sizeof(char));
@@ -170,38 +311,81 @@ int safeword_open(struct safeword_db *db, const char *path)
 		strcpy(db->path, env);
 	}
 
-	/*
-	 * Fail if file does not exist, otherwise sqlite3 will create it. We
-	 * require the init function to take care of that.
-	 */
-	ret = access(db->path, F_OK);
-	if (ret)
-		debug("safeword database '%s' does not exist", db->path);
-	safeword_check(ret == 0, ESAFEWORD_DBEXIST, fail);
-
-	ret = sqlite3_open(db->path, &(db->handle));
-	if (ret)
-		debug("failed to open safeword database '%s'", db->path);
-	safeword_check(ret == SQLITE_OK, ESAFEWORD_DBEXIST, fail);
+	if (!strcmp(db->path, SAFEWORD_MEMORY) ||
+		!strncmp(db->path, SAFEWORD_MEMORY_PREFIX, strlen(SAFEWORD_MEMORY_PREFIX)) ||
+		!strncmp(db->path, SAFEWORD_MEMORY_SAVE_PREFIX, strlen(SAFEWORD_MEMORY_SAVE_PREFIX))) {
+		ret = open_memory(db);
+		safeword_check(!ret, safeword_errno, fail);
+	} else {
+		/*
+		 * Fail if file does not exist, otherwise sqlite3 will create it. We
+		 * require the init function to take care of that.
+		 */
+		ret = access(db->path, F_OK);
+		if (ret)
+			debug("safeword database '%s' does not exist", db->path);
+		safeword_check(ret == 0, ESAFEWORD_DBEXIST, fail);
+
+		ret = sqlite3_open(db->path, &(db->handle));
+		if (ret)
+			debug("failed to open safeword database '%s'", db->path);
+		safeword_check(ret == SQLITE_OK, ESAFEWORD_DBEXIST, fail);
+		safeword_trace_db(db->handle);
+	}
 
 	/* enable foreign key support in Sqlite3 so delete cascading works. */
 	ret = sqlite3_exec(db->handle, "PRAGMA foreign_keys = ON;", 0, 0, 0);
 	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
 
+	ret = safeword_migrate(db, 0, _open_progress, _open_progress_arg);
+	safeword_check(!ret, safeword_errno, fail);
+
+	safeword_trace_span("db", "safeword_open", start, db->path, -1);
 	return 0;
 fail:
+	safeword_trace_span("db", "safeword_open", start, safeword_strerror(safeword_errno), -1);
 	return -1;
 }
 
+void safeword_open_progress(safeword_progress_callback progress, void *arg)
+{
+	_open_progress = progress;
+	_open_progress_arg = arg;
+}
+
 int safeword_close(struct safeword_db *db)
 {
-	int ret = 0;
+	int ret = 0, saved = 1;
 
 	safeword_check(db != NULL, ESAFEWORD_DBEXIST, fail);
 
+	/* statistics never keep a vault from closing */
+	if (db->accesses_size) {
+		long long start = safeword_trace_enabled ? safeword_trace_now() : 0;
+
+		safeword_flush_accesses(db);
+		safeword_trace_span("db", "safeword_flush_accesses", start, NULL, -1);
+	}
+	free(db->accesses);
+	db->accesses = NULL;
+	db->accesses_size = 0;
+	db->accesses_capacity = 0;
+	safeword_explain_db(db->handle);
+
+	if (db->save_path) {
+		long long start = safeword_trace_enabled ? safeword_trace_now() : 0;
+
+		saved = copy_database(db->handle, db->save_path, 1) == SQLITE_OK;
+		if (!saved)
+			debug("failed to save safeword database '%s'", db->save_path);
+		safeword_trace_span("db", "safeword_save", start, db->save_path, -1);
+		db->save_path = NULL;
+	}
+
 	free(db->path);
 	ret = sqlite3_close(db->handle);
 	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+	safeword_check(saved, ESAFEWORD_BACKENDSTORAGE, fail);
 
 	return 0;
 fail:
@@ -210,306 +394,1452 @@ fail:
 
 /* #endregion safeword open & close */
 
-/* #region safeword list functions */
+/* #region safeword backup function */
 
-static int credentials_callback(void* not_used, int argc, char** argv, char** col_name)
+/* a copy of @c path with @c suffix appended, @c NULL if out of memory */
+static char *suffixed_path(const char *path, const char *suffix, unsigned int n)
 {
-	char* description = argv[1];
-	long int credential_id = atoi(argv[0]);
+	char *suffixed = malloc(strlen(path) + strlen(suffix) + 12);
 
-	if (!description)
-		description = "";
+	if (suffixed) {
+		if (n)
+			sprintf(suffixed, "%s%s%u", path, suffix, n);
+		else
+			sprintf(suffixed, "%s%s", path, suffix);
+	}
 
-	printf("%ld : %s\n", credential_id, description);
-	return 0;
+	return suffixed;
 }
 
-int safeword_list_credentials(struct safeword_db *db, unsigned int tags_size, char **tags)
+/* shift path, path.1, ... up by one, dropping path.(keep - 1) */
+static int rotate_backups(const char *path, unsigned int keep)
 {
-	int ret = 0, i;
-	char *sql;
+	char *from = NULL, *to = NULL;
+	unsigned int i;
+
+	for (i = keep - 1; i > 0; i--) {
+		to = suffixed_path(path, ".", i);
+		from = i > 1 ? suffixed_path(path, ".", i - 1) : suffixed_path(path, "", 0);
+		safeword_check(from && to, ESAFEWORD_NOMEM, fail);
+		if (!access(from, F_OK))
+			safeword_check(!rename(from, to), ESAFEWORD_BACKENDSTORAGE, fail);
+		free(from);
+		free(to);
+	}
 
-	if (tags) {
-		char *tags_concat;
-		/* init to include the commas & null terminator */
-		int tags_concat_size = tags_size + 1;
+	return 0;
+fail:
+	free(from);
+	free(to);
+	return -1;
+}
 
-		for (i = 0; i < tags_size; i++) {
-			/* add 2 for wrapping in single quotes */
-			tags_concat_size += strlen(tags[i]) + 2;
-		}
-		tags_concat = calloc(tags_concat_size, sizeof(char));
-		safeword_check(tags_concat, ESAFEWORD_NOMEM, fail);
+/* whether PRAGMA quick_check finds nothing wrong */
+static int quick_check(sqlite3 *handle)
+{
+	int ok = 0;
+	sqlite3_stmt *stmt;
 
-		for (i = 0; i < tags_size; i++) {
-			strcat(tags_concat, "'");
-			strcat(tags_concat, tags[i]);
-			strcat(tags_concat, "'");
-			if (i != tags_size - 1)
-				strcat(tags_concat, ",");
-		}
+	if (sqlite3_prepare_v2(handle, "PRAGMA quick_check;", -1, &stmt, NULL) != SQLITE_OK)
+		return 0;
+	/* a single "ok" row, otherwise one row per problem */
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		ok = !strcmp((const char *) sqlite3_column_text(stmt, 0), "ok");
+	sqlite3_finalize(stmt);
 
-		sql = calloc(strlen(tags_concat) + 256, sizeof(char));
-		safeword_check(sql != NULL, ESAFEWORD_NOMEM, fail);
-
-		/* Find credentials with the specified tags */
-		sprintf(sql, "SELECT c.id,c.description FROM credentials AS c "
-			"INNER JOIN tagged_credentials AS tc "
-			"INNER JOIN tags AS t ON "
-			"(c.id = tc.credentialid AND tc.tagid = t.id) WHERE "
-			"t.tag IN (%s) GROUP BY c.id HAVING COUNT(c.id) = %d;",
-			tags_concat, tags_size);
-		ret = sqlite3_exec(db->handle, sql, credentials_callback, 0, 0);
-		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
-		free(tags_concat);
-		free(sql);
-	} else {
-		if (tags_size == UINT_MAX) {
-			sql = calloc(100, sizeof(char));
-			safeword_check(sql != NULL, ESAFEWORD_NOMEM, fail);
+	return ok;
+}
 
-			/* Find all credentials */
-			sprintf(sql, "SELECT id,description FROM credentials;");
-			ret = sqlite3_exec(db->handle, sql, credentials_callback, 0, 0);
-			safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
-			free(sql);
-		} else {
-			sql = calloc(256, sizeof(char));
-			safeword_check(sql != NULL, ESAFEWORD_NOMEM, fail);
-
-			/* Find credentials that have no tags */
-			sprintf(sql, "SELECT id,description FROM credentials "
-			"WHERE id NOT IN ("
-			"SELECT credentialid FROM tagged_credentials "
-			"WHERE tagid IN ("
-			"SELECT id FROM tags));");
-			ret = sqlite3_exec(db->handle, sql, credentials_callback, 0, 0);
-			safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
-			free(sql);
-		}
-	}
+int safeword_backup(struct safeword_db *db, const char *path,
+	const struct safeword_backup_options *options)
+{
+	int ret = 0, pages, step_ms;
+	unsigned int keep;
+	char *partial = NULL;
+	sqlite3 *handle = NULL;
+	sqlite3_backup *backup = NULL;
+	long long start = safeword_trace_enabled ? safeword_trace_now() : 0;
+
+	safeword_check(db && db->handle && path, ESAFEWORD_INVARG, fail);
+	pages = options && options->pages > 0 ? options->pages : SAFEWORD_BACKUP_PAGES;
+	step_ms = options ? options->sleep_ms : SAFEWORD_BACKUP_SLEEP_MS;
+	keep = options && options->keep ? options->keep : 1;
+
+	/* written next to path and only moved over it once it checks out */
+	partial = suffixed_path(path, ".partial", 0);
+	safeword_check(partial, ESAFEWORD_NOMEM, fail);
+	remove(partial);
+
+	ret = sqlite3_open(partial, &handle);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_partial);
+	safeword_trace_db(handle);
+
+	backup = sqlite3_backup_init(handle, "main", db->handle, "main");
+	safeword_check(backup, ESAFEWORD_BACKENDSTORAGE, fail_partial);
 
+	/*
+	 * The vault is only read locked while a step copies its pages, writers
+	 * get their turn during the sleep. A write from another connection
+	 * restarts the copy, one through db->handle is copied along.
+	 */
+	do {
+		ret = sqlite3_backup_step(backup, pages);
+		safeword_check(ret == SQLITE_OK || ret == SQLITE_DONE ||
+			ret == SQLITE_BUSY || ret == SQLITE_LOCKED, ESAFEWORD_BACKENDSTORAGE, fail_partial);
+		if (options && options->progress &&
+			options->progress(sqlite3_backup_pagecount(backup) - sqlite3_backup_remaining(backup),
+				sqlite3_backup_pagecount(backup), options->arg)) {
+			safeword_check(0, ESAFEWORD_CANCELED, fail_partial);
+		}
+		if (ret != SQLITE_DONE && step_ms)
+			sqlite3_sleep(step_ms);
+	} while (ret != SQLITE_DONE);
+
+	ret = sqlite3_backup_finish(backup);
+	backup = NULL;
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_partial);
+
+	ret = quick_check(handle);
+	if (!ret)
+		debug("backup '%s' failed its quick_check", partial);
+	safeword_check(ret, ESAFEWORD_BACKENDSTORAGE, fail_partial);
+
+	ret = sqlite3_close(handle);
+	handle = NULL;
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_partial);
+
+	ret = rotate_backups(path, keep);
+	safeword_check(!ret, safeword_errno, fail_partial);
+	ret = rename(partial, path);
+	safeword_check(!ret, ESAFEWORD_BACKENDSTORAGE, fail_partial);
+
+	free(partial);
+	safeword_trace_span("db", "safeword_backup", start, path, -1);
+	return 0;
+fail_partial:
+	sqlite3_backup_finish(backup);
+	sqlite3_close(handle);
+	remove(partial);
 fail:
-	return ret;
+	free(partial);
+	safeword_trace_span("db", "safeword_backup", start, safeword_strerror(safeword_errno), -1);
+	return -1;
 }
 
-/* #endregion safeword list functions */
+/* #endregion safeword backup function */
 
-/* #region safeword info functions */
+/* #region safeword access functions */
 
-char* safeword_credential_tostring(struct safeword_credential *credential)
-{
-	int i, len = 0;
-	char *str;
+struct safeword_access {
+	/* 0 for a free slot, credential ids are only positive */
+	long int credential_id;
+	/* seconds since the epoch of the latest access */
+	long int used;
+	unsigned int count;
+};
 
-	if (!credential)
-		return NULL;
+#define ACCESSES_CAPACITY_MIN 64
 
-	if (credential->username)
-		len += strlen(credential->username);
-	if (credential->password)
-		len += strlen(credential->password);
-	if (credential->description)
-		len += strlen(credential->description);
-	for (i = 0; i < credential->tags_size; i++)
-		if (credential->tags[i])
-			len += strlen(credential->tags[i]);
+/* the slot of @c credential_id in a table of @c capacity slots, a power of two */
+static struct safeword_access *access_slot(struct safeword_access *accesses,
+	unsigned int capacity, long int credential_id)
+{
+	unsigned int i = (unsigned int) ((unsigned long) credential_id * 2654435761UL) & (capacity - 1);
 
-	str = calloc(256 + len + 1, sizeof(char));
-	safeword_check(str != NULL, ESAFEWORD_NOMEM, fail);
+	while (accesses[i].credential_id && accesses[i].credential_id != credential_id)
+		i = (i + 1) & (capacity - 1);
+	return &accesses[i];
+}
 
-	len = sprintf(str, "{ id='%d', username='%s', password='%s', description='%s', tags='",
-		credential->id,
-		credential->username ? credential->username : "",
-		credential->password ? credential->password : "",
-		credential->description ? credential->description : "");
+/* double the slots once they are half used, so probes stay short */
+static int accesses_grow(struct safeword_db *db)
+{
+	unsigned int i, capacity = db->accesses_capacity ? db->accesses_capacity * 2 : ACCESSES_CAPACITY_MIN;
+	struct safeword_access *accesses;
 
-	for (i = 0; i < credential->tags_size; i++) {
-		if (!credential->tags[i])
-			continue;
-		if (i != 0)
-			len += sprintf(len + str, " ");
-		len += sprintf(len + str, "%s", credential->tags[i]);
+	accesses = calloc(capacity, sizeof(*accesses));
+	if (!accesses)
+		return -1;
+	for (i = 0; i < db->accesses_capacity; i++) {
+		if (db->accesses[i].credential_id)
+			*access_slot(accesses, capacity, db->accesses[i].credential_id) = db->accesses[i];
 	}
-	sprintf(len + str, "' }");
+	free(db->accesses);
+	db->accesses = accesses;
+	db->accesses_capacity = capacity;
 
-	return str;
-fail:
-	return NULL;
+	return 0;
 }
 
-static int credential_exists_callback(void* existsptr, int argc, char** argv, char** columns)
+/*
+ * Accesses are only remembered here, coalesced per credential in an open
+ * addressing hash table, and written in a single transaction by
+ * safeword_flush_accesses(). Losing one is harmless, so failing to remember
+ * it is not an error.
+ */
+static void record_access(struct safeword_db *db, long int credential_id)
 {
-	int *exists = (int*) existsptr;
-	*exists = 1;
-	return 0;
+	struct safeword_access *access;
+
+	if ((db->accesses_size + 1) * 2 > db->accesses_capacity && accesses_grow(db))
+		return;
+
+	access = access_slot(db->accesses, db->accesses_capacity, credential_id);
+	if (!access->credential_id) {
+		access->credential_id = credential_id;
+		access->count = 0;
+		db->accesses_size++;
+	}
+	access->used = time(NULL);
+	access->count++;
 }
 
-int safeword_credential_exists(struct safeword_db *db, long int credential_id)
+/* forget the pending accesses, keeping the slots for the next ones */
+static void accesses_clear(struct safeword_db *db)
 {
-	int ret, exists = 0;
-	char* sql;
+	if (db->accesses)
+		memset(db->accesses, 0, db->accesses_capacity * sizeof(*db->accesses));
+	db->accesses_size = 0;
+}
 
-	/* Credential ids are only positive. */
-	if (credential_id < 0) return 0;
+int safeword_flush_accesses(struct safeword_db *db)
+{
+	int ret, i;
+	unsigned int j;
+	sqlite3_stmt *stmts[2] = { NULL, NULL };
+	const char *sql[2] = {
+		/* the credential may have been deleted since it was read */
+		"INSERT OR IGNORE INTO credential_access (credentialid, used, count) "
+		"SELECT id, 0, 0 FROM credentials WHERE id = ?1;",
+		"UPDATE credential_access SET used = max(used, ?2), count = count + ?3 "
+		"WHERE credentialid = ?1;",
+	};
 
 	safeword_check(db != NULL, ESAFEWORD_INVARG, fail);
+	if (!db->accesses_size)
+		return 0;
 
-	sql = calloc(256, sizeof(char));
-	safeword_check(sql, ESAFEWORD_NOMEM, fail);
+	/* never wait for another connection, the accesses are dropped instead */
+	sqlite3_busy_timeout(db->handle, 0);
+	ret = sqlite3_exec(db->handle, "BEGIN IMMEDIATE;", 0, 0, 0);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_drop);
 
-	sprintf(sql, "SELECT id FROM credentials WHERE id = %ld;", credential_id);
-	ret = sqlite3_exec(db->handle, sql, &credential_exists_callback, &exists, 0);
-	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_sql);
+	for (i = 0; i < 2; i++) {
+		ret = sqlite3_prepare_v2(db->handle, sql[i], -1, &stmts[i], NULL);
+		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_rollback);
+	}
+	for (j = 0; j < db->accesses_capacity; j++) {
+		if (!db->accesses[j].credential_id)
+			continue;
+		for (i = 0; i < 2; i++) {
+			sqlite3_bind_int64(stmts[i], 1, db->accesses[j].credential_id);
+			sqlite3_bind_int64(stmts[i], 2, db->accesses[j].used);
+			sqlite3_bind_int64(stmts[i], 3, db->accesses[j].count);
+			ret = sqlite3_step(stmts[i]);
+			sqlite3_reset(stmts[i]);
+			safeword_check(ret == SQLITE_DONE, ESAFEWORD_BACKENDSTORAGE, fail_rollback);
+		}
+	}
+	for (i = 0; i < 2; i++)
+		sqlite3_finalize(stmts[i]);
 
-	free(sql);
+	ret = sqlite3_exec(db->handle, "COMMIT;", 0, 0, 0);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_rollback);
 
-	return exists;
-fail_sql:
-	free(sql);
-fail:
+	accesses_clear(db);
 	return 0;
+fail_rollback:
+	for (i = 0; i < 2; i++)
+		sqlite3_finalize(stmts[i]);
+	sqlite3_exec(db->handle, "ROLLBACK;", 0, 0, 0);
+fail_drop:
+	accesses_clear(db);
+fail:
+	return -1;
 }
 
-static int credential_get_tags_size_callback(void* cred, int argc, char** argv, char** columns)
+int safeword_list_recent(struct safeword_db *db, unsigned int limit,
+	safeword_credential_callback callback, void *arg)
 {
-	struct safeword_credential *credential = (struct safeword_credential*) cred;
-	credential->tags_size = strtol(argv[0], NULL, 10);
+	int ret, stopped = 0;
+	struct safeword_credential credential;
+	sqlite3_stmt *stmt = NULL;
+	/* the index on used ends with the credentialid rowid, no sort is needed */
+	const char *sql = "SELECT c.id, c.description FROM credential_access AS a "
+		"INNER JOIN credentials AS c ON (c.id = a.credentialid) "
+		"ORDER BY a.used DESC, a.credentialid DESC LIMIT ?;";
+
+	safeword_check(db != NULL, ESAFEWORD_INVARG, fail);
+	safeword_check(callback != NULL, ESAFEWORD_INVARG, fail);
+
+	ret = sqlite3_prepare_v2(db->handle, sql, -1, &stmt, NULL);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+	ret = sqlite3_bind_int64(stmt, 1, limit ? (sqlite3_int64) limit : -1);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_stmt);
+
+	memset(&credential, 0, sizeof(credential));
+	while (!stopped && (ret = sqlite3_step(stmt)) == SQLITE_ROW) {
+		credential.id = sqlite3_column_int(stmt, 0);
+		credential.description = (char*) sqlite3_column_text(stmt, 1);
+		stopped = callback(&credential, arg);
+	}
+	safeword_check(stopped || ret == SQLITE_DONE, ESAFEWORD_BACKENDSTORAGE, fail_stmt);
+
+	sqlite3_finalize(stmt);
 	return 0;
+fail_stmt:
+	sqlite3_finalize(stmt);
+fail:
+	return -1;
 }
 
-static int credential_get_credential_callback(void* cred, int argc, char** argv, char** columns)
+/* #endregion safeword access functions */
+
+/* #region safeword changes functions */
+
+/* run @c sql, which selects one integer, into @c value */
+static int changes_query(struct safeword_db *db, const char *sql, long long *value)
 {
-	struct safeword_credential *credential = (struct safeword_credential*) cred;
-	credential->id = argv[0] ? strtol(argv[0], NULL, 10) : 0;
-	if (argv[1]) {
-		credential->description = calloc(strlen(argv[1]) + 1, sizeof(char));
-		safeword_check(credential->description, ESAFEWORD_NOMEM, fail);
-		strcpy(credential->description, argv[1]);
-	}
+	int ret;
+	sqlite3_stmt *stmt = NULL;
+
+	ret = sqlite3_prepare_v2(db->handle, sql, -1, &stmt, NULL);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+	ret = sqlite3_step(stmt);
+	safeword_check(ret == SQLITE_ROW, ESAFEWORD_BACKENDSTORAGE, fail);
+	*value = sqlite3_column_int64(stmt, 0);
+
+	sqlite3_finalize(stmt);
 	return 0;
 fail:
+	sqlite3_finalize(stmt);
 	return -1;
 }
 
-static int credential_get_username_callback(void* cred, int argc, char** argv, char** columns)
+long long safeword_changes_last(struct safeword_db *db)
 {
-	struct safeword_credential *credential = (struct safeword_credential*) cred;
-	if (argv[0]) {
-		credential->username = calloc(strlen(argv[0]) + 1, sizeof(char));
-		safeword_check(credential->username, ESAFEWORD_NOMEM, fail);
-		strcpy(credential->username, argv[0]);
-	}
-	return 0;
+	long long seq;
+	/* sqlite_sequence still counts the changes compacted away */
+	const char *sql = "SELECT coalesce((SELECT seq FROM sqlite_sequence "
+		"WHERE name = 'changes'), 0);";
+
+	safeword_check(db != NULL, ESAFEWORD_INVARG, fail);
+	if (changes_query(db, sql, &seq))
+		goto fail;
+
+	return seq;
 fail:
 	return -1;
 }
 
-static int credential_get_password_callback(void* cred, int argc, char** argv, char** columns)
+int safeword_changes(struct safeword_db *db, long long since, unsigned int limit,
+	safeword_change_callback callback, void *arg)
 {
-	struct safeword_credential *credential = (struct safeword_credential*) cred;
-	if (argv[0]) {
-		credential->password = calloc(strlen(argv[0]) + 1, sizeof(char));
-		safeword_check(credential->password, ESAFEWORD_NOMEM, fail);
-		strcpy(credential->password, argv[0]);
+	int ret, stopped = 0;
+	long long horizon;
+	struct safeword_change change;
+	sqlite3_stmt *stmt = NULL;
+	/* the last change compacted away, if nothing is left all of them were */
+	const char *horizon_sql = "SELECT coalesce((SELECT min(seq) - 1 FROM changes), "
+		"(SELECT seq FROM sqlite_sequence WHERE name = 'changes'), 0);";
+	const char *sql = "SELECT seq, kind, op, id, tagid, at FROM changes "
+		"WHERE seq > ? ORDER BY seq LIMIT ?;";
+
+	safeword_check(db != NULL, ESAFEWORD_INVARG, fail);
+	safeword_check(callback != NULL, ESAFEWORD_INVARG, fail);
+	safeword_check(since >= 0, ESAFEWORD_INVARG, fail);
+
+	/* one read transaction, so the horizon holds for the changes read */
+	ret = sqlite3_exec(db->handle, "SAVEPOINT changes;", 0, 0, 0);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+
+	if (changes_query(db, horizon_sql, &horizon))
+		goto fail_savepoint;
+	safeword_check(since >= horizon, ESAFEWORD_COMPACTED, fail_savepoint);
+
+	ret = sqlite3_prepare_v2(db->handle, sql, -1, &stmt, NULL);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_savepoint);
+	ret = sqlite3_bind_int64(stmt, 1, since);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_savepoint);
+	ret = sqlite3_bind_int64(stmt, 2, limit ? (sqlite3_int64) limit : -1);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_savepoint);
+
+	memset(&change, 0, sizeof(change));
+	while (!stopped && (ret = sqlite3_step(stmt)) == SQLITE_ROW) {
+		change.seq = sqlite3_column_int64(stmt, 0);
+		change.kind = sqlite3_column_int(stmt, 1);
+		change.op = sqlite3_column_int(stmt, 2);
+		change.id = sqlite3_column_int(stmt, 3);
+		change.tag_id = sqlite3_column_int(stmt, 4);
+		change.at = sqlite3_column_int(stmt, 5);
+		stopped = callback(&change, arg);
 	}
+	safeword_check(stopped || ret == SQLITE_DONE, ESAFEWORD_BACKENDSTORAGE, fail_savepoint);
+
+	sqlite3_finalize(stmt);
+	sqlite3_exec(db->handle, "RELEASE changes;", 0, 0, 0);
 	return 0;
+fail_savepoint:
+	sqlite3_finalize(stmt);
+	sqlite3_exec(db->handle, "ROLLBACK TO changes; RELEASE changes;", 0, 0, 0);
 fail:
 	return -1;
 }
 
-int safeword_credential_read(struct safeword_db *db, struct safeword_credential *credential)
+int safeword_changes_compact(struct safeword_db *db, long long seq)
 {
-	int ret, i = 0;
-	char* sql;
+	int ret;
+	sqlite3_stmt *stmt = NULL;
+	const char *sql = "DELETE FROM changes WHERE seq <= ?;";
 
 	safeword_check(db != NULL, ESAFEWORD_INVARG, fail);
-	ret = safeword_credential_exists(db, credential->id);
-	safeword_check(ret == 1, ESAFEWORD_NOCREDENTIAL, nocredential);
+	safeword_check(seq >= 0, ESAFEWORD_INVARG, fail);
 
-	sql = calloc(256, sizeof(char));
-	safeword_check(sql, ESAFEWORD_NOMEM, fail);
+	ret = sqlite3_prepare_v2(db->handle, sql, -1, &stmt, NULL);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+	ret = sqlite3_bind_int64(stmt, 1, seq);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+	ret = sqlite3_step(stmt);
+	safeword_check(ret == SQLITE_DONE, ESAFEWORD_BACKENDSTORAGE, fail);
 
-	if (credential->username) {
-		free(credential->username);
-		credential->username = NULL;
-	}
-	sprintf(sql, "SELECT u.username FROM credentials AS c "
-		"INNER JOIN usernames AS u ON (c.usernameid = u.id) "
-		"WHERE c.id = %d;", credential->id);
-	ret = sqlite3_exec(db->handle, sql, &credential_get_username_callback, credential, 0);
-	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_sql);
+	sqlite3_finalize(stmt);
+	return sqlite3_changes(db->handle);
+fail:
+	sqlite3_finalize(stmt);
+	return -1;
+}
 
-	if (credential->password) {
-		free(credential->password);
-		credential->password = NULL;
-	}
-	sprintf(sql, "SELECT p.password FROM credentials AS c "
-		"INNER JOIN passwords AS p ON (c.passwordid = p.id) "
-		"WHERE c.id = %d;", credential->id);
-	ret = sqlite3_exec(db->handle, sql, &credential_get_password_callback, credential, 0);
-	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_sql);
+/* #endregion safeword changes functions */
+
+/* #region safeword audit functions */
+
+/*
+ * The credentials whose username or password is shared, in runs of one value.
+ * The subquery scans the value's index and the outer query reads one range of
+ * it per shared value, neither touches the credentials table itself.
+ */
+static const char *reuse_sql[] = {
+	"SELECT usernameid, id FROM credentials WHERE usernameid IN "
+		"(SELECT usernameid FROM credentials WHERE usernameid IS NOT NULL "
+		"GROUP BY usernameid HAVING count(*) > 1) ORDER BY usernameid, id;",
+	"SELECT passwordid, id FROM credentials WHERE passwordid IN "
+		"(SELECT passwordid FROM credentials WHERE passwordid IS NOT NULL "
+		"GROUP BY passwordid HAVING count(*) > 1) ORDER BY passwordid, id;",
+};
 
-	if (credential->description) {
-		free(credential->description);
-		credential->description = NULL;
+/* pass each run of @c stmt to @c callback, returns non-zero if it stopped */
+static int reuse_groups(sqlite3_stmt *stmt, int field, safeword_reuse_callback callback, void *arg)
+{
+	int ret, stopped = 0;
+	unsigned int size = 0, capacity = 0;
+	long int *ids = NULL, *grown;
+	sqlite3_int64 value, group = 0;
+
+	while (!stopped && (ret = sqlite3_step(stmt)) == SQLITE_ROW) {
+		value = sqlite3_column_int64(stmt, 0);
+		if (size && value != group) {
+			stopped = callback(field, size, ids, arg);
+			size = 0;
+		}
+		group = value;
+		if (size == capacity) {
+			capacity = capacity ? capacity * 2 : 16;
+			grown = realloc(ids, capacity * sizeof(*ids));
+			safeword_check(grown != NULL, ESAFEWORD_NOMEM, fail);
+			ids = grown;
+		}
+		ids[size++] = sqlite3_column_int64(stmt, 1);
 	}
-	sprintf(sql, "SELECT id,description FROM credentials WHERE id = %d;", credential->id);
-	ret = sqlite3_exec(db->handle, sql, &credential_get_credential_callback, credential, 0);
-	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_sql);
+	safeword_check(stopped || ret == SQLITE_DONE, ESAFEWORD_BACKENDSTORAGE, fail);
+	if (!stopped && size)
+		stopped = callback(field, size, ids, arg);
 
-	/* Find all tags for the specified credential ID */
-	credential->tags_size = 0;
-	credential->tags = 0;
+	free(ids);
+	return stopped ? 1 : 0;
+fail:
+	free(ids);
+	return -1;
+}
 
-	sprintf(sql, "SELECT count(*) FROM (SELECT t.tag FROM tags AS t INNER JOIN tagged_credentials AS tc "
-		"ON (tc.tagid = t.id) WHERE tc.credentialid = %d);", credential->id);
-	ret = sqlite3_exec(db->handle, sql, &credential_get_tags_size_callback, credential, 0);
-	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_sql);
+int safeword_audit_reuse(struct safeword_db *db, int fields,
+	safeword_reuse_callback callback, void *arg)
+{
+	int ret, i, stopped = 0;
+	const int field[] = { SAFEWORD_REUSE_USERNAME, SAFEWORD_REUSE_PASSWORD };
+	sqlite3_stmt *stmt = NULL;
 
-	if (credential->tags_size == 0) goto skip_tags;
+	safeword_check(db != NULL, ESAFEWORD_INVARG, fail);
+	safeword_check(callback != NULL, ESAFEWORD_INVARG, fail);
+	safeword_check(fields && !(fields & ~(SAFEWORD_REUSE_USERNAME | SAFEWORD_REUSE_PASSWORD)),
+		ESAFEWORD_INVARG, fail);
 
-	credential->tags = calloc(credential->tags_size, sizeof(char*));
-	safeword_check(credential->tags != 0, ESAFEWORD_NOMEM, fail_sql);
+	/* one read transaction, so both fields are audited on the same vault */
+	ret = sqlite3_exec(db->handle, "SAVEPOINT audit;", 0, 0, 0);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
 
+	for (i = 0; i < 2 && !stopped; i++) {
+		if (!(fields & field[i]))
+			continue;
+		ret = sqlite3_prepare_v2(db->handle, reuse_sql[i], -1, &stmt, NULL);
+		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_savepoint);
+		stopped = reuse_groups(stmt, field[i], callback, arg);
+		sqlite3_finalize(stmt);
+		stmt = NULL;
+		if (stopped < 0)
+			goto fail_savepoint;
+	}
+
+	sqlite3_exec(db->handle, "RELEASE audit;", 0, 0, 0);
+	return 0;
+fail_savepoint:
+	sqlite3_finalize(stmt);
+	sqlite3_exec(db->handle, "ROLLBACK TO audit; RELEASE audit;", 0, 0, 0);
+fail:
+	return -1;
+}
+
+/* #endregion safeword audit functions */
+
+/* #region safeword list functions */
+
+/*
+ * A tag term ending in '*' matches every tag starting with what precedes it,
+ * one ending in ':' every tag in that namespace.
+ */
+static int tag_is_prefix(const char *term)
+{
+	size_t size = strlen(term);
+
+	return size && (term[size - 1] == '*' || term[size - 1] == ':');
+}
+
+/*
+ * Bind @c term folded the way lower() folds tags.tag_folded. A prefix term is
+ * bound as the range [prefix, prefix + 0xf5) to @c index and @c index + 1;
+ * no byte of UTF-8 text is 0xf5 so every tag with the prefix sorts below the
+ * upper bound and the range is an index range scan of tag_folded.
+ */
+static int bind_tag_folded(sqlite3_stmt *stmt, int index, const char *term)
+{
+	int ret, prefix = tag_is_prefix(term);
+	size_t i, size = strlen(term);
+	char *folded;
+
+	if (prefix && term[size - 1] == '*')
+		size--;
+
+	folded = malloc(size + 2);
+	safeword_check(folded, ESAFEWORD_NOMEM, fail);
+	for (i = 0; i < size; i++)
+		folded[i] = (term[i] >= 'A' && term[i] <= 'Z') ? term[i] - 'A' + 'a' : term[i];
+	folded[size] = (char) 0xf5;
+	folded[size + 1] = '\0';
+
+	ret = sqlite3_bind_text(stmt, index, folded, size, SQLITE_TRANSIENT);
+	if (ret == SQLITE_OK && prefix)
+		ret = sqlite3_bind_text(stmt, index + 1, folded, size + 1, SQLITE_TRANSIENT);
+	free(folded);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+
+	return 0;
+fail:
+	return -1;
+}
+
+static int print_credential(struct safeword_credential *credential, void *not_used)
+{
+	printf("%d : %s\n", credential->id, credential->description ? credential->description : "");
+	return 0;
+}
+
+int safeword_list_credentials(struct safeword_db *db, unsigned int tags_size, char **tags)
+{
+	return safeword_list_credentials_foreach(db, tags_size, tags, print_credential, NULL);
+}
+
+int safeword_list_credentials_foreach(struct safeword_db *db, unsigned int tags_size, char **tags,
+	safeword_credential_callback callback, void *arg)
+{
+	return safeword_list_credentials_page(db, tags_size, tags, NULL, callback, arg);
+}
+
+/*
+ * Which rows of a page a statement selects when sorting by description. NULL
+ * descriptions sort first, so a page resuming inside them has to finish them
+ * before continuing with the rest.
+ */
+enum page_phase {
+	PAGE_FIRST,        /* from the start */
+	PAGE_AFTER_NULL,   /* NULL descriptions after :after_id */
+	PAGE_NOT_NULL,     /* every non-NULL description */
+	PAGE_AFTER_KEY,    /* after (:after_key, :after_id) */
+};
+
+static sqlite3_stmt *list_credentials_stmt(struct safeword_db *db, unsigned int tags_size, char **tags,
+	int sort, long int after_id, enum page_phase phase, unsigned int limit)
+{
+	int ret, i, param = 1;
+	char *sql;
 	sqlite3_stmt *stmt = NULL;
-	sprintf(sql, "SELECT t.tag FROM tags AS t INNER JOIN tagged_credentials AS tc "
-		"ON (tc.tagid = t.id) WHERE tc.credentialid = %d;", credential->id);
-	ret = sqlite3_prepare_v2(db->handle, sql, strlen(sql) + 1, &stmt, NULL);
-	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_tags);
-	const char *tag;
-	do {
-		ret = sqlite3_step(stmt);
 
-		switch (ret) {
-		case SQLITE_ROW:
-			tag = (const char*) sqlite3_column_text(stmt, 0);
-			if (!tag) continue;
-			credential->tags[i] = calloc(strlen(tag) + 1, sizeof(char));
-			safeword_check(credential->tags[i], ESAFEWORD_NOMEM, fail_tag);
-			strcpy(credential->tags[i], tag);
-			i++;
+	sql = calloc(512 + tags_size * 160, sizeof(char));
+	safeword_check(sql != NULL, ESAFEWORD_NOMEM, fail);
+
+	strcpy(sql, "SELECT id,description FROM credentials WHERE ");
+	if (tags && tags_size) {
+		/* Find credentials with all of the specified tags */
+		strcat(sql, "id IN (");
+		for (i = 0; i < tags_size; i++) {
+			if (i != 0)
+				strcat(sql, " INTERSECT ");
+			strcat(sql, "SELECT tc.credentialid FROM tagged_credentials AS tc "
+				"INNER JOIN tags AS t ON (tc.tagid = t.id) WHERE ");
+			if (tag_is_prefix(tags[i])) {
+				sprintf(sql + strlen(sql), "t.tag_folded >= ?%d AND t.tag_folded < ?%d",
+					param, param + 1);
+				param += 2;
+			} else
+				sprintf(sql + strlen(sql), "t.tag_folded = ?%d", param++);
+		}
+		strcat(sql, ")");
+	} else if (tags_size == UINT_MAX) {
+		/* Find all credentials */
+		strcat(sql, "1");
+	} else {
+		/* Find credentials that have no tags, tag_count is indexed */
+		strcat(sql, "tag_count = 0");
+	}
+
+	/* resume with an index seek past the last row of the previous page */
+	if (sort == SAFEWORD_SORT_DESCRIPTION) {
+		switch (phase) {
+		case PAGE_AFTER_NULL:
+			strcat(sql, " AND description IS NULL AND id > :after_id");
+			break;
+		case PAGE_NOT_NULL:
+			strcat(sql, " AND description >= ''");
+			break;
+		case PAGE_AFTER_KEY:
+			strcat(sql, " AND description >= :after_key AND "
+				"(description > :after_key OR id > :after_id)");
 			break;
 		default:
 			break;
 		}
-	} while (ret == SQLITE_ROW);
+		strcat(sql, " ORDER BY description, id");
+	} else {
+		if (after_id > 0)
+			strcat(sql, " AND id > :after_id");
+		strcat(sql, " ORDER BY id");
+	}
+	if (limit)
+		strcat(sql, " LIMIT :limit");
+	strcat(sql, ";");
+
+	ret = sqlite3_prepare_v2(db->handle, sql, -1, &stmt, NULL);
+	free(sql);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+
+	for (i = 0, param = 1; tags && i < tags_size; i++) {
+		ret = bind_tag_folded(stmt, param, tags[i]);
+		param += tag_is_prefix(tags[i]) ? 2 : 1;
+		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_stmt);
+	}
+	if ((i = sqlite3_bind_parameter_index(stmt, ":after_id")))
+		sqlite3_bind_int64(stmt, i, after_id);
+	if ((i = sqlite3_bind_parameter_index(stmt, ":limit")))
+		sqlite3_bind_int64(stmt, i, limit);
+
+	return stmt;
+fail_stmt:
+	sqlite3_finalize(stmt);
+fail:
+	return NULL;
+}
+
+int safeword_list_credentials_page(struct safeword_db *db, unsigned int tags_size, char **tags,
+	const struct safeword_list_options *options, safeword_credential_callback callback, void *arg)
+{
+	int ret = 0, i, sort = SAFEWORD_SORT_ID, stopped = 0;
+	unsigned int limit = 0, rows = 0;
+	long int after_id = 0;
+	char *after_key = NULL;
+	enum page_phase phase = PAGE_FIRST;
+	struct safeword_credential credential;
+	sqlite3_stmt *stmt = NULL;
+
+	safeword_check(db != NULL, ESAFEWORD_INVARG, fail);
+	safeword_check(callback != NULL, ESAFEWORD_INVARG, fail);
+
+	if (options) {
+		sort = options->sort;
+		limit = options->limit;
+		after_id = options->after_id;
+		safeword_check(sort == SAFEWORD_SORT_ID || sort == SAFEWORD_SORT_DESCRIPTION,
+			ESAFEWORD_INVARG, fail);
+		if (options->after_description) {
+			after_key = strdup(options->after_description);
+			safeword_check(after_key, ESAFEWORD_NOMEM, fail);
+		}
+	}
+
+	if (sort == SAFEWORD_SORT_DESCRIPTION && (after_key || after_id > 0)) {
+		/* the key of the last row is its description, look it up if only the id is known */
+		if (!after_key) {
+			ret = sqlite3_prepare_v2(db->handle, "SELECT description FROM credentials WHERE id = ?;",
+				-1, &stmt, NULL);
+			safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+			sqlite3_bind_int64(stmt, 1, after_id);
+			ret = sqlite3_step(stmt);
+			safeword_check(ret == SQLITE_ROW, ESAFEWORD_NOCREDENTIAL, fail_stmt);
+			if (sqlite3_column_type(stmt, 0) != SQLITE_NULL) {
+				after_key = strdup((const char*) sqlite3_column_text(stmt, 0));
+				safeword_check(after_key, ESAFEWORD_NOMEM, fail_stmt);
+			}
+			sqlite3_finalize(stmt);
+			stmt = NULL;
+		}
+		phase = after_key ? PAGE_AFTER_KEY : PAGE_AFTER_NULL;
+		/* a key without an id skips every row with that description */
+		if (after_id <= 0)
+			after_id = LONG_MAX;
+	}
+
+	/* a page resuming in the NULL descriptions continues with the others */
+	do {
+		stmt = list_credentials_stmt(db, tags_size, tags, sort, after_id, phase,
+			limit ? limit - rows : 0);
+		safeword_check(stmt != NULL, safeword_errno, fail);
+		if (after_key && (i = sqlite3_bind_parameter_index(stmt, ":after_key")))
+			sqlite3_bind_text(stmt, i, after_key, strlen(after_key), SQLITE_STATIC);
+
+		while ((ret = sqlite3_step(stmt)) == SQLITE_ROW) {
+			memset(&credential, 0, sizeof(credential));
+			credential.id = sqlite3_column_int(stmt, 0);
+			credential.description = (char*) sqlite3_column_text(stmt, 1);
+			rows++;
+			if (callback(&credential, arg)) {
+				stopped = 1;
+				break;
+			}
+		}
+		safeword_check(ret == SQLITE_ROW || ret == SQLITE_DONE, ESAFEWORD_BACKENDSTORAGE, fail_stmt);
+		ret = sqlite3_finalize(stmt);
+		stmt = NULL;
+		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+	} while (phase++ == PAGE_AFTER_NULL && !stopped && (!limit || rows < limit));
+
+	free(after_key);
+
+	return 0;
+fail_stmt:
+	sqlite3_finalize(stmt);
+fail:
+	free(after_key);
+	return -1;
+}
+
+/* #endregion safeword list functions */
+
+/* #region safeword arena functions */
+
+struct safeword_arena_block {
+	struct safeword_arena_block *next;
+	size_t size;
+	size_t used;
+	char data[];
+};
+
+/* every allocation is aligned for any of the result members */
+#define ARENA_ALIGN(size) (((size) + sizeof(void*) - 1) & ~(sizeof(void*) - 1))
+#define ARENA_MIN_BLOCK 4096
+
+static struct safeword_arena_block *arena_block_create(struct safeword_arena *arena, size_t size)
+{
+	struct safeword_arena_block *block;
+
+	block = malloc(sizeof(*block) + size);
+	if (!block)
+		return NULL;
+	block->size = size;
+	block->used = 0;
+	block->next = arena->blocks;
+	arena->blocks = block;
+	arena->allocations++;
+
+	return block;
+}
+
+int safeword_arena_init(struct safeword_arena *arena, size_t size)
+{
+	safeword_check(arena != NULL, ESAFEWORD_INVARG, fail);
+
+	memset(arena, 0, sizeof(*arena));
+	if (size) {
+		safeword_check(arena_block_create(arena, ARENA_ALIGN(size)), ESAFEWORD_NOMEM, fail);
+	}
+
+	return 0;
+fail:
+	return -1;
+}
+
+void *safeword_arena_alloc(struct safeword_arena *arena, size_t size)
+{
+	void *ptr;
+	size_t block_size;
+	struct safeword_arena_block *block;
+
+	safeword_check(arena != NULL, ESAFEWORD_INVARG, fail);
+
+	size = ARENA_ALIGN(size ? size : 1);
+	block = arena->blocks;
+	if (!block || block->size - block->used < size) {
+		/* grow geometrically so a result set needs few blocks */
+		block_size = block ? block->size * 2 : ARENA_MIN_BLOCK;
+		while (block_size < size)
+			block_size *= 2;
+		block = arena_block_create(arena, block_size);
+		safeword_check(block, ESAFEWORD_NOMEM, fail);
+	}
+
+	ptr = block->data + block->used;
+	block->used += size;
+	memset(ptr, 0, size);
+
+	return ptr;
+fail:
+	return NULL;
+}
+
+void safeword_arena_reset(struct safeword_arena *arena)
+{
+	size_t size = 0;
+	struct safeword_arena_block *block, *next;
+
+	if (!arena || !arena->blocks)
+		return;
+
+	if (!arena->blocks->next) {
+		arena->blocks->used = 0;
+		return;
+	}
+
+	/*
+	 * The results outgrew the first block; replace the chain with a single
+	 * block large enough for all of it so the next use never allocates.
+	 */
+	for (block = arena->blocks; block; block = next) {
+		next = block->next;
+		size += block->size;
+		free(block);
+	}
+	arena->blocks = NULL;
+	arena_block_create(arena, size);
+}
+
+void safeword_arena_free(struct safeword_arena *arena)
+{
+	struct safeword_arena_block *block, *next;
+
+	if (!arena)
+		return;
+
+	for (block = arena->blocks; block; block = next) {
+		next = block->next;
+		free(block);
+	}
+	arena->blocks = NULL;
+}
+
+/* #endregion safeword arena functions */
+
+/* #region safeword cursor functions */
+
+static int field_index(int field)
+{
+	switch (field) {
+	case SAFEWORD_FIELD_USERNAME:
+		return 0;
+	case SAFEWORD_FIELD_PASSWORD:
+		return 1;
+	case SAFEWORD_FIELD_DESCRIPTION:
+		return 2;
+	case SAFEWORD_FIELD_TAGS:
+		return 3;
+	default:
+		return -1;
+	}
+}
+
+static int cursor_open(struct safeword_db *db, struct safeword_cursor *cursor, const char *sql,
+	sqlite3_int64 id, int username, int password, int description, int tag)
+{
+	int ret;
+
+	safeword_check(cursor != NULL, ESAFEWORD_INVARG, fail);
+	cursor->stmt = NULL;
+	safeword_check(db != NULL, ESAFEWORD_INVARG, fail);
+
+	cursor->_access = NULL;
+	cursor->columns[0] = username;
+	cursor->columns[1] = password;
+	cursor->columns[2] = description;
+	cursor->columns[3] = tag;
+
+	ret = sqlite3_prepare_v2(db->handle, sql, -1, &cursor->stmt, NULL);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+	if (id) {
+		ret = sqlite3_bind_int64(cursor->stmt, 1, id);
+		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_stmt);
+	}
+
+	return 0;
+fail_stmt:
+	sqlite3_finalize(cursor->stmt);
+	cursor->stmt = NULL;
+fail:
+	return -1;
+}
+
+int safeword_cursor_credential_fields(struct safeword_db *db, struct safeword_cursor *cursor,
+	long int credential_id, int fields)
+{
+	/* only the columns, and so the joins, of the requested fields are selected */
+	char sql[256] = "SELECT c.id";
+	int column = 1, username = -1, password = -1, description = -1;
+
+	safeword_check(credential_id > 0, ESAFEWORD_INVARG, fail);
+	safeword_check(!(fields & ~SAFEWORD_FIELD_ALL), ESAFEWORD_INVARG, fail);
+
+	if (fields & SAFEWORD_FIELD_USERNAME) {
+		strcat(sql, ", u.username");
+		username = column++;
+	}
+	if (fields & SAFEWORD_FIELD_PASSWORD) {
+		strcat(sql, ", p.password");
+		password = column++;
+	}
+	if (fields & SAFEWORD_FIELD_DESCRIPTION) {
+		strcat(sql, ", c.description");
+		description = column++;
+	}
+	strcat(sql, " FROM credentials AS c");
+	if (username > 0)
+		strcat(sql, " LEFT JOIN usernames AS u ON (c.usernameid = u.id)");
+	if (password > 0)
+		strcat(sql, " LEFT JOIN passwords AS p ON (c.passwordid = p.id)");
+	strcat(sql, " WHERE c.id = ?;");
+
+	if (cursor_open(db, cursor, sql, credential_id, username, password, description, -1))
+		return -1;
+	/* only reading a secret is an access, and only once the row is read */
+	if (fields & (SAFEWORD_FIELD_USERNAME | SAFEWORD_FIELD_PASSWORD))
+		cursor->_access = db;
+	return 0;
+fail:
+	return -1;
+}
+
+int safeword_cursor_credential(struct safeword_db *db, struct safeword_cursor *cursor, long int credential_id)
+{
+	return safeword_cursor_credential_fields(db, cursor, credential_id,
+		SAFEWORD_FIELD_USERNAME | SAFEWORD_FIELD_PASSWORD | SAFEWORD_FIELD_DESCRIPTION);
+}
+
+int safeword_cursor_credential_tags(struct safeword_db *db, struct safeword_cursor *cursor, long int credential_id)
+{
+	/* the count is evaluated once and lets a copy be sized from the first row */
+	char *sql = "SELECT tc.credentialid, t.tag, "
+		"(SELECT count(*) FROM tagged_credentials WHERE credentialid = ?1) "
+		"FROM tags AS t INNER JOIN tagged_credentials AS tc "
+		"ON (tc.tagid = t.id) WHERE tc.credentialid = ?1;";
+
+	safeword_check(credential_id > 0, ESAFEWORD_INVARG, fail);
+
+	return cursor_open(db, cursor, sql, credential_id, -1, -1, -1, 1);
+fail:
+	return -1;
+}
+
+int safeword_cursor_tags(struct safeword_db *db, struct safeword_cursor *cursor,
+	unsigned int filter_size, const char **filter)
+{
+	safeword_check(cursor != NULL, ESAFEWORD_INVARG, fail);
+
+	if (!filter_size)
+		return cursor_open(db, cursor, "SELECT id,tag FROM tags;", 0, -1, -1, -1, 1);
+
+	safeword_check(db != NULL, ESAFEWORD_INVARG, fail);
+	cursor->_access = NULL;
+	cursor->columns[0] = cursor->columns[1] = cursor->columns[2] = -1;
+	cursor->columns[3] = 1;
+	cursor->stmt = get_filter_prepared_stmt(db, filter_size, filter, 0);
+	safeword_check(cursor->stmt != NULL, safeword_errno, fail);
+
+	return 0;
+fail:
+	return -1;
+}
+
+int safeword_cursor_next(struct safeword_cursor *cursor)
+{
+	int ret;
+
+	safeword_check(cursor != NULL && cursor->stmt != NULL, ESAFEWORD_INVARG, fail);
+
+	ret = sqlite3_step(cursor->stmt);
+	if (ret == SQLITE_ROW) {
+		if (cursor->_access) {
+			record_access(cursor->_access, (long int) sqlite3_column_int64(cursor->stmt, 0));
+			cursor->_access = NULL;
+		}
+		return 1;
+	}
 	safeword_check(ret == SQLITE_DONE, ESAFEWORD_BACKENDSTORAGE, fail);
-	ret = sqlite3_finalize(stmt);
+
+	return 0;
+fail:
+	return -1;
+}
+
+long int safeword_cursor_id(struct safeword_cursor *cursor)
+{
+	safeword_check(cursor != NULL && cursor->stmt != NULL, ESAFEWORD_INVARG, fail);
+
+	return (long int) sqlite3_column_int64(cursor->stmt, 0);
+fail:
+	return 0;
+}
+
+const char *safeword_cursor_text(struct safeword_cursor *cursor, int field, size_t *size)
+{
+	int column, index = field_index(field);
+	const char *text = NULL;
+
+	if (size)
+		*size = 0;
+	safeword_check(cursor != NULL && cursor->stmt != NULL, ESAFEWORD_INVARG, fail);
+	safeword_check(index >= 0, ESAFEWORD_INVARG, fail);
+
+	column = cursor->columns[index];
+	if (column < 0)
+		return NULL;
+
+	text = (const char*) sqlite3_column_text(cursor->stmt, column);
+	if (text && size)
+		*size = sqlite3_column_bytes(cursor->stmt, column);
+
+fail:
+	return text;
+}
+
+int safeword_cursor_close(struct safeword_cursor *cursor)
+{
+	int ret;
+
+	if (!cursor || !cursor->stmt)
+		return 0;
+
+	ret = sqlite3_finalize(cursor->stmt);
+	cursor->stmt = NULL;
 	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
-skip_tags:
 
-	free(sql);
 	return 0;
-nocredential:
+fail:
+	return -1;
+}
+
+/* #endregion safeword cursor functions */
+
+/* #region safeword info functions */
+
+char* safeword_credential_tostring(struct safeword_credential *credential)
+{
+	int i, len = 0;
+	char *str;
+
+	if (!credential)
+		return NULL;
+
+	if (credential->username)
+		len += strlen(credential->username);
+	if (credential->password)
+		len += strlen(credential->password);
+	if (credential->description)
+		len += strlen(credential->description);
+	for (i = 0; i < credential->tags_size; i++)
+		if (credential->tags[i])
+			len += strlen(credential->tags[i]);
+
+	str = calloc(256 + len + 1, sizeof(char));
+	safeword_check(str != NULL, ESAFEWORD_NOMEM, fail);
+
+	len = sprintf(str, "{ id='%d', username='%s', password='%s', description='%s', tags='",
+		credential->id,
+		credential->username ? credential->username : "",
+		credential->password ? credential->password : "",
+		credential->description ? credential->description : "");
+
+	for (i = 0; i < credential->tags_size; i++) {
+		if (!credential->tags[i])
+			continue;
+		if (i != 0)
+			len += sprintf(len + str, " ");
+		len += sprintf(len + str, "%s", credential->tags[i]);
+	}
+	sprintf(len + str, "' }");
+
+	return str;
+fail:
+	return NULL;
+}
+
+static int credential_exists_callback(void* existsptr, int argc, char** argv, char** columns)
+{
+	int *exists = (int*) existsptr;
+	*exists = 1;
 	return 0;
-fail_tag:
-	for (; i > 0; i--)
-		free(credential->tags[i]);
-fail_tags:
-	free(credential->tags);
+}
+
+int safeword_credential_exists(struct safeword_db *db, long int credential_id)
+{
+	int ret, exists = 0;
+	char* sql;
+
+	/* Credential ids are only positive. */
+	if (credential_id < 0) return 0;
+
+	safeword_check(db != NULL, ESAFEWORD_INVARG, fail);
+
+	sql = calloc(256, sizeof(char));
+	safeword_check(sql, ESAFEWORD_NOMEM, fail);
+
+	sprintf(sql, "SELECT id FROM credentials WHERE id = %ld;", credential_id);
+	ret = sqlite3_exec(db->handle, sql, &credential_exists_callback, &exists, 0);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_sql);
+
+	free(sql);
+
+	return exists;
 fail_sql:
 	free(sql);
+fail:
+	return 0;
+}
+
+/* allocate from @c arena, or from the heap if @c arena is NULL */
+static void *result_alloc(struct safeword_arena *arena, size_t size)
+{
+	return arena ? safeword_arena_alloc(arena, size) : calloc(1, size);
+}
+
+static char *result_strndup(struct safeword_arena *arena, const char *str, size_t size)
+{
+	char *copy;
+
+	if (!str)
+		return NULL;
+	copy = result_alloc(arena, size + 1);
+	if (copy)
+		memcpy(copy, str, size);
+	return copy;
+}
+
+static int credential_read(struct safeword_db *db, struct safeword_arena *arena,
+	struct safeword_credential *credential, int fields)
+{
+	int ret, i = 0;
+	size_t size;
+	const char *text;
+	char *username = NULL, *password = NULL, *description = NULL, **tags = NULL;
+	unsigned int tags_size = 0;
+	struct safeword_cursor cursor;
+
+	safeword_check(db != NULL, ESAFEWORD_INVARG, fail);
+	safeword_check(credential != NULL, ESAFEWORD_INVARG, fail);
+	/* Credential ids are only positive. */
+	if (credential->id <= 0)
+		return 0;
+
+	/* the row is read even for the tags alone, to tell if the credential exists */
+	ret = safeword_cursor_credential_fields(db, &cursor, credential->id, fields & ~SAFEWORD_FIELD_TAGS);
+	safeword_check(ret == 0, safeword_errno, fail);
+	ret = safeword_cursor_next(&cursor);
+	if (ret == 0) {
+		/* nothing to read, leave the credential untouched */
+		safeword_cursor_close(&cursor);
+		return 0;
+	}
+	safeword_check(ret == 1, ESAFEWORD_BACKENDSTORAGE, fail_cursor);
+
+	text = safeword_cursor_text(&cursor, SAFEWORD_FIELD_USERNAME, &size);
+	username = result_strndup(arena, text, size);
+	safeword_check(username || !text, ESAFEWORD_NOMEM, fail_strings);
+	text = safeword_cursor_text(&cursor, SAFEWORD_FIELD_PASSWORD, &size);
+	password = result_strndup(arena, text, size);
+	safeword_check(password || !text, ESAFEWORD_NOMEM, fail_strings);
+	text = safeword_cursor_text(&cursor, SAFEWORD_FIELD_DESCRIPTION, &size);
+	description = result_strndup(arena, text, size);
+	safeword_check(description || !text, ESAFEWORD_NOMEM, fail_strings);
+	safeword_cursor_close(&cursor);
+	if (!(fields & SAFEWORD_FIELD_TAGS))
+		goto done;
+
+	/* Find all tags for the specified credential ID */
+	ret = safeword_cursor_credential_tags(db, &cursor, credential->id);
+	safeword_check(ret == 0, safeword_errno, fail_strings);
+	while ((ret = safeword_cursor_next(&cursor)) == 1) {
+		if (!tags) {
+			/* the tag count is selected along with every tag */
+			tags_size = sqlite3_column_int(cursor.stmt, 2);
+			tags = result_alloc(arena, tags_size * sizeof(char*));
+			safeword_check(tags, ESAFEWORD_NOMEM, fail_strings);
+		}
+		text = safeword_cursor_text(&cursor, SAFEWORD_FIELD_TAGS, &size);
+		if (!text || i >= tags_size) continue;
+		tags[i] = result_strndup(arena, text, size);
+		safeword_check(tags[i], ESAFEWORD_NOMEM, fail_strings);
+		i++;
+	}
+	safeword_check(ret == 0, ESAFEWORD_BACKENDSTORAGE, fail_strings);
+	safeword_cursor_close(&cursor);
+
+done:
+	if (!arena) {
+		free(credential->username);
+		free(credential->password);
+		free(credential->description);
+		if (credential->tags) {
+			for (ret = 0; ret < credential->tags_size; ret++)
+				free(credential->tags[ret]);
+			free(credential->tags);
+		}
+	}
+	credential->username = username;
+	credential->password = password;
+	credential->description = description;
+	credential->tags_size = i;
+	credential->tags = tags;
+
+	return 0;
+fail_strings:
+	if (!arena) {
+		free(username);
+		free(password);
+		free(description);
+		for (; i > 0; i--)
+			free(tags[i - 1]);
+		free(tags);
+	}
+fail_cursor:
+	safeword_cursor_close(&cursor);
+fail:
+	return -1;
+}
+
+int safeword_credential_read(struct safeword_db *db, struct safeword_credential *credential)
+{
+	return credential_read(db, NULL, credential, SAFEWORD_FIELD_ALL);
+}
+
+int safeword_credential_read_fields(struct safeword_db *db, struct safeword_credential *credential, int fields)
+{
+	safeword_check(fields != 0, ESAFEWORD_INVARG, fail);
+
+	return credential_read(db, NULL, credential, fields);
+fail:
+	return -1;
+}
+
+int safeword_credential_read_arena(struct safeword_db *db, struct safeword_arena *arena,
+	struct safeword_credential *credential)
+{
+	safeword_check(arena != NULL, ESAFEWORD_INVARG, fail);
+
+	return credential_read(db, arena, credential, SAFEWORD_FIELD_ALL);
+fail:
+	return -1;
+}
+
+/* ids bound to one statement, well below SQLite's limit of 999 variables */
+#define READ_MANY_CHUNK 500
+
+struct read_slot {
+	long int id;
+	/* where in the caller's array the credential goes */
+	unsigned int index;
+	unsigned int tags_capacity;
+};
+
+static int compare_slots(const void *a, const void *b)
+{
+	const struct read_slot *x = a, *y = b;
+
+	if (x->id != y->id)
+		return x->id < y->id ? -1 : 1;
+	return x->index < y->index ? -1 : x->index > y->index;
+}
+
+static int compare_slot_id(const void *key, const void *slot)
+{
+	long int id = *(const long int*) key;
+	const struct read_slot *y = slot;
+
+	return id < y->id ? -1 : id > y->id;
+}
+
+/* prepare @c head followed by @c size parameters and @c tail */
+static sqlite3_stmt *prepare_in(sqlite3 *handle, const char *head, const char *tail, unsigned int size)
+{
+	unsigned int i;
+	char *sql, *at;
+	sqlite3_stmt *stmt = NULL;
+
+	sql = malloc(strlen(head) + 2 * size + strlen(tail) + 1);
+	safeword_check(sql != NULL, ESAFEWORD_NOMEM, fail);
+	at = sql + sprintf(sql, "%s", head);
+	for (i = 0; i < size; i++)
+		at += sprintf(at, i ? ",?" : "?");
+	strcpy(at, tail);
+
+	if (sqlite3_prepare_v2(handle, sql, -1, &stmt, NULL) != SQLITE_OK)
+		stmt = NULL;
+	free(sql);
+	safeword_check(stmt != NULL, ESAFEWORD_BACKENDSTORAGE, fail);
+
+	return stmt;
+fail:
+	return NULL;
+}
+
+int safeword_credential_read_many(struct safeword_db *db, const long int *ids, unsigned int ids_size,
+	struct safeword_credential *credentials)
+{
+	int ret;
+	unsigned int i, j, unique = 0, start, size, prepared = 0;
+	size_t text_size;
+	const char *text;
+	char **tags;
+	long int id;
+	struct read_slot *slots = NULL, *slot;
+	struct safeword_credential *credential;
+	sqlite3_stmt *stmt = NULL, *tags_stmt = NULL;
+
+	safeword_check(db != NULL, ESAFEWORD_INVARG, fail);
+	safeword_check(!ids_size || (ids && credentials), ESAFEWORD_INVARG, fail);
+	if (!ids_size)
+		return 0;
+	memset(credentials, 0, ids_size * sizeof(*credentials));
+
+	/* sorted, so each row finds its credential with a binary search */
+	slots = calloc(ids_size, sizeof(*slots));
+	safeword_check(slots != NULL, ESAFEWORD_NOMEM, fail);
+	for (i = 0; i < ids_size; i++) {
+		slots[i].id = ids[i];
+		slots[i].index = i;
+	}
+	qsort(slots, ids_size, sizeof(*slots), compare_slots);
+	for (i = 0; i < ids_size; i++)
+		if (!unique || slots[i].id != slots[unique - 1].id)
+			slots[unique++] = slots[i];
+
+	/* one read transaction, so every chunk reads the same vault */
+	ret = sqlite3_exec(db->handle, "SAVEPOINT read_many;", 0, 0, 0);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_slots);
+
+	for (start = 0; start < unique; start += size) {
+		size = unique - start < READ_MANY_CHUNK ? unique - start : READ_MANY_CHUNK;
+		/* every chunk but the last has the same size, and the same statements */
+		if (size != prepared) {
+			sqlite3_finalize(stmt);
+			sqlite3_finalize(tags_stmt);
+			tags_stmt = NULL;
+			stmt = prepare_in(db->handle, "SELECT c.id, u.username, p.password, c.description "
+				"FROM credentials AS c "
+				"LEFT JOIN usernames AS u ON (c.usernameid = u.id) "
+				"LEFT JOIN passwords AS p ON (c.passwordid = p.id) "
+				"WHERE c.id IN (", ");", size);
+			safeword_check(stmt != NULL, safeword_errno, fail_savepoint);
+			tags_stmt = prepare_in(db->handle, "SELECT tc.credentialid, t.tag "
+				"FROM tagged_credentials AS tc INNER JOIN tags AS t ON (t.id = tc.tagid) "
+				"WHERE tc.credentialid IN (", ");", size);
+			safeword_check(tags_stmt != NULL, safeword_errno, fail_savepoint);
+			prepared = size;
+		} else {
+			sqlite3_reset(stmt);
+			sqlite3_reset(tags_stmt);
+		}
+		for (i = 0; i < size; i++) {
+			ret = sqlite3_bind_int64(stmt, i + 1, slots[start + i].id);
+			safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_savepoint);
+			ret = sqlite3_bind_int64(tags_stmt, i + 1, slots[start + i].id);
+			safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_savepoint);
+		}
+
+		while ((ret = sqlite3_step(stmt)) == SQLITE_ROW) {
+			id = sqlite3_column_int64(stmt, 0);
+			slot = bsearch(&id, slots + start, size, sizeof(*slots), compare_slot_id);
+			if (!slot)
+				continue;
+			credential = &credentials[slot->index];
+			credential->id = id;
+			for (j = 1; j <= 3; j++) {
+				text = (const char*) sqlite3_column_text(stmt, j);
+				text_size = sqlite3_column_bytes(stmt, j);
+				if (!text)
+					continue;
+				text = result_strndup(NULL, text, text_size);
+				safeword_check(text != NULL, ESAFEWORD_NOMEM, fail_savepoint);
+				if (j == 1)
+					credential->username = (char*) text;
+				else if (j == 2)
+					credential->password = (char*) text;
+				else
+					credential->description = (char*) text;
+			}
+		}
+		safeword_check(ret == SQLITE_DONE, ESAFEWORD_BACKENDSTORAGE, fail_savepoint);
+
+		while ((ret = sqlite3_step(tags_stmt)) == SQLITE_ROW) {
+			id = sqlite3_column_int64(tags_stmt, 0);
+			slot = bsearch(&id, slots + start, size, sizeof(*slots), compare_slot_id);
+			if (!slot || !credentials[slot->index].id)
+				continue;
+			credential = &credentials[slot->index];
+			if (credential->tags_size == slot->tags_capacity) {
+				slot->tags_capacity = slot->tags_capacity ? 2 * slot->tags_capacity : 4;
+				tags = realloc(credential->tags, slot->tags_capacity * sizeof(*tags));
+				safeword_check(tags != NULL, ESAFEWORD_NOMEM, fail_savepoint);
+				credential->tags = tags;
+			}
+			text = result_strndup(NULL, (const char*) sqlite3_column_text(tags_stmt, 1),
+				sqlite3_column_bytes(tags_stmt, 1));
+			safeword_check(text != NULL, ESAFEWORD_NOMEM, fail_savepoint);
+			credential->tags[credential->tags_size++] = (char*) text;
+		}
+		safeword_check(ret == SQLITE_DONE, ESAFEWORD_BACKENDSTORAGE, fail_savepoint);
+	}
+
+	sqlite3_finalize(stmt);
+	sqlite3_finalize(tags_stmt);
+	sqlite3_exec(db->handle, "RELEASE read_many;", 0, 0, 0);
+
+	/* each credential read is an access, as when read on its own */
+	for (i = 0; i < unique; i++)
+		if (credentials[slots[i].index].id)
+			record_access(db, slots[i].id);
+	free(slots);
+	return 0;
+fail_savepoint:
+	sqlite3_finalize(stmt);
+	sqlite3_finalize(tags_stmt);
+	sqlite3_exec(db->handle, "ROLLBACK TO read_many; RELEASE read_many;", 0, 0, 0);
+	for (i = 0; i < ids_size; i++)
+		safeword_credential_free(&credentials[i]);
+	memset(credentials, 0, ids_size * sizeof(*credentials));
+fail_slots:
+	free(slots);
 fail:
 	return -1;
 }
@@ -558,6 +1888,102 @@ fail:
 	return NULL;
 }
 
+/*
+ * A compressed wiki is stored as this magic, its uncompressed size as 8 bytes
+ * big endian and a zlib stream. Text never starts with a NUL, so wikis
+ * stored uncompressed read as they are.
+ */
+#define WIKI_MAGIC       "\0swz"
+#define WIKI_MAGIC_SIZE  4
+#define WIKI_HEADER_SIZE (WIKI_MAGIC_SIZE + 8)
+
+static int wiki_is_packed(const unsigned char *data, sqlite3_int64 bytes)
+{
+	return bytes >= WIKI_HEADER_SIZE && !memcmp(data, WIKI_MAGIC, WIKI_MAGIC_SIZE);
+}
+
+#ifdef SAFEWORD_ZLIB
+static void wiki_header(unsigned char *header, sqlite3_int64 size)
+{
+	int i;
+
+	memcpy(header, WIKI_MAGIC, WIKI_MAGIC_SIZE);
+	for (i = 0; i < 8; i++)
+		header[WIKI_MAGIC_SIZE + i] = (unsigned char) (size >> (56 - 8 * i));
+}
+
+static sqlite3_int64 wiki_header_size(const unsigned char *header)
+{
+	int i;
+	sqlite3_int64 size = 0;
+
+	for (i = 0; i < 8; i++)
+		size = (size << 8) | header[WIKI_MAGIC_SIZE + i];
+	return size;
+}
+
+/* @c wiki compressed behind its header, NULL if that would not be smaller */
+static unsigned char *wiki_pack(const char *wiki, size_t size, size_t *packed_size)
+{
+	uLongf bound = compressBound(size);
+	unsigned char *packed;
+
+	if (!_compress || size < SAFEWORD_COMPRESS_MIN)
+		return NULL;
+	packed = malloc(WIKI_HEADER_SIZE + bound);
+	if (!packed)
+		return NULL;
+	if (compress2(packed + WIKI_HEADER_SIZE, &bound, (const Bytef*) wiki, size,
+		Z_DEFAULT_COMPRESSION) != Z_OK || WIKI_HEADER_SIZE + bound >= size) {
+		free(packed);
+		return NULL;
+	}
+	wiki_header(packed, size);
+	*packed_size = WIKI_HEADER_SIZE + bound;
+
+	return packed;
+}
+#endif
+
+/* the text of a stored wiki, uncompressed if it was compressed */
+static char *wiki_unpack(const unsigned char *data, int bytes)
+{
+	char *wiki;
+#ifdef SAFEWORD_ZLIB
+	int ret;
+	uLongf len;
+	sqlite3_int64 size;
+#endif
+
+	if (!wiki_is_packed(data, bytes)) {
+		wiki = malloc(bytes + 1);
+		safeword_check(wiki != NULL, ESAFEWORD_NOMEM, fail);
+		memcpy(wiki, data, bytes);
+		wiki[bytes] = '\0';
+		return wiki;
+	}
+
+#ifdef SAFEWORD_ZLIB
+	size = wiki_header_size(data);
+	safeword_check(size >= 0 && (sqlite3_uint64) size < SIZE_MAX, ESAFEWORD_COMPRESSED, fail);
+	wiki = malloc(size + 1);
+	safeword_check(wiki != NULL, ESAFEWORD_NOMEM, fail);
+	len = size;
+	ret = uncompress((Bytef*) wiki, &len, data + WIKI_HEADER_SIZE, bytes - WIKI_HEADER_SIZE);
+	safeword_check(ret == Z_OK && len == (uLongf) size, ESAFEWORD_COMPRESSED, fail_wiki);
+	wiki[size] = '\0';
+
+	return wiki;
+fail_wiki:
+	free(wiki);
+#else
+	/* compressed by a build with zlib */
+	safeword_check(0, ESAFEWORD_COMPRESSED, fail);
+#endif
+fail:
+	return NULL;
+}
+
 int safeword_tag_read(struct safeword_db *db, struct safeword_tag *tag)
 {
 	int ret;
@@ -568,25 +1994,26 @@ int safeword_tag_read(struct safeword_db *db, struct safeword_tag *tag)
 	safeword_check(tag != NULL, ESAFEWORD_INVARG, fail);
 	safeword_check(tag->tag != NULL, ESAFEWORD_INVARG, fail);
 
-	sql = "SELECT wiki FROM tags WHERE tag = ?;";
+	sql = "SELECT w.wiki FROM tags AS t INNER JOIN tag_wikis AS w ON (w.tagid = t.id) "
+		"WHERE t.tag = ?;";
 	ret = sqlite3_prepare_v2(db->handle, sql, strlen(sql) + 1, &stmt, NULL);
 	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
 	ret = sqlite3_bind_text(stmt, 1, tag->tag, strlen(tag->tag), SQLITE_STATIC);
 	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
 	ret = sqlite3_step(stmt);
 	if (ret == SQLITE_ROW) {
-		const char *col = (const char*) sqlite3_column_text(stmt, 0);
+		const unsigned char *col = sqlite3_column_blob(stmt, 0);
 		if (col) {
-			tag->wiki = calloc(strlen(col) + 1, sizeof(char));
-			if (tag->wiki) {
-				strcpy(tag->wiki, col);
-			}
+			tag->wiki = wiki_unpack(col, sqlite3_column_bytes(stmt, 0));
+			safeword_check(tag->wiki != NULL, safeword_errno, fail_stmt);
 		}
 	}
 	ret = sqlite3_finalize(stmt);
 	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
 
 	return 0;
+fail_stmt:
+	sqlite3_finalize(stmt);
 fail:
 	return -1;
 }
@@ -595,8 +2022,9 @@ fail:
 
 /* #region safeword credential functions */
 
-static int map_to_credential(sqlite3* handle, const char* value, const char* table, const char* field,
-	sqlite3_int64 credential_rowid)
+/* get the id of @c value in @c table, adding it if it is not there yet */
+static int value_id(sqlite3* handle, const char* value, const char* table, const char* field,
+	sqlite3_int64 *value_rowid)
 {
 	int ret;
 	char* sql = 0;
@@ -609,7 +2037,7 @@ static int map_to_credential(sqlite3* handle, const char* value, const char* tab
 	sprintf(sql, "SELECT id FROM %s WHERE %s = ?;", table, field);;
 	ret = sqlite3_prepare_v2(handle, sql, strlen(sql) + 1, &stmt, NULL);
 	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
-	ret = sqlite3_bind_text(stmt, 1, value, strlen(value) + 1, SQLITE_STATIC);
+	ret = sqlite3_bind_text(stmt, 1, value, strlen(value), SQLITE_STATIC);
 	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
 	ret = sqlite3_step(stmt);
 	if (ret == SQLITE_ROW)
@@ -622,7 +2050,7 @@ static int map_to_credential(sqlite3* handle, const char* value, const char* tab
 		sprintf(sql, "INSERT INTO %s (%s) VALUES (?);", table, field);
 		ret = sqlite3_prepare_v2(handle, sql, strlen(sql) + 1, &stmt, NULL);
 		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
-		ret = sqlite3_bind_text(stmt, 1, value, strlen(value) + 1, SQLITE_STATIC);
+		ret = sqlite3_bind_text(stmt, 1, value, strlen(value), SQLITE_STATIC);
 		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
 		ret = sqlite3_step(stmt);
 		safeword_check(ret == SQLITE_DONE, ESAFEWORD_BACKENDSTORAGE, fail);
@@ -630,15 +2058,31 @@ static int map_to_credential(sqlite3* handle, const char* value, const char* tab
 		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
 		id = sqlite3_last_insert_rowid(handle);
 	}
+	free(sql);
+
+	*value_rowid = id;
+	return 0;
+fail:
+	free(sql);
+	return -1;
+}
+
+static int map_to_credential(sqlite3* handle, const char* value, const char* table, const char* field,
+	sqlite3_int64 credential_rowid)
+{
+	int ret;
+	char sql[64];
+	sqlite3_int64 id;
+
+	if (value_id(handle, value, table, field, &id))
+		goto fail;
 
 	sprintf(sql, "UPDATE credentials SET %sid = %d WHERE id = %d;", field, (int) id, (int) credential_rowid);
 	ret = sqlite3_exec(handle, sql, 0, 0, 0);
 	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
-	free(sql);
 
 	return 0;
 fail:
-	free(sql);
 	return -1;
 }
 
@@ -655,36 +2099,41 @@ int map_password(sqlite3* handle, const char* password, sqlite3_int64 credential
 int safeword_credential_add(struct safeword_db *db, struct safeword_credential *credential)
 {
 	int ret = 0;
-	char *sql_insert = "INSERT INTO credentials DEFAULT VALUES;";
-	char *sql_update = "UPDATE credentials SET description = ? WHERE id = ?;";
+	sqlite3_int64 usernameid, passwordid;
+	/* a single insert, so the change log and sync see one change per add */
+	char *sql_insert = "INSERT INTO credentials (usernameid, passwordid, description) "
+		"VALUES (?, ?, ?);";
 	sqlite3_stmt *stmt = NULL;
 
 	safeword_check(db != NULL, ESAFEWORD_INVARG, fail);
 	safeword_check(credential != NULL, ESAFEWORD_INVARG, fail);
 
-	ret = sqlite3_exec(db->handle, sql_insert, 0, 0, 0);
-	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
-	credential->id = sqlite3_last_insert_rowid(db->handle);
-
-	if (credential->description) {
-		ret = sqlite3_prepare_v2(db->handle, sql_update, strlen(sql_update) + 1, &stmt, NULL);
-		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
-		ret = sqlite3_bind_int64(stmt, 2, credential->id);
-		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
-		ret = sqlite3_bind_text(stmt, 1, credential->description, strlen(credential->description) + 1, SQLITE_STATIC);
-		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
-		ret = sqlite3_step(stmt);
-		safeword_check(ret == SQLITE_DONE, ESAFEWORD_BACKENDSTORAGE, fail);
-		ret = sqlite3_finalize(stmt);
-		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
-	}
+	if (credential->username &&
+		value_id(db->handle, credential->username, "usernames", "username", &usernameid))
+		goto fail;
+	if (credential->password &&
+		value_id(db->handle, credential->password, "passwords", "password", &passwordid))
+		goto fail;
 
+	ret = sqlite3_prepare_v2(db->handle, sql_insert, -1, &stmt, NULL);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
 	if (credential->username)
-		map_username(db->handle, credential->username, credential->id);
+		ret = sqlite3_bind_int64(stmt, 1, usernameid);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_stmt);
 	if (credential->password)
-		map_password(db->handle, credential->password, credential->id);
+		ret = sqlite3_bind_int64(stmt, 2, passwordid);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_stmt);
+	if (credential->description)
+		ret = sqlite3_bind_text(stmt, 3, credential->description, -1, SQLITE_STATIC);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_stmt);
+	ret = sqlite3_step(stmt);
+	safeword_check(ret == SQLITE_DONE, ESAFEWORD_BACKENDSTORAGE, fail_stmt);
+	sqlite3_finalize(stmt);
+	credential->id = sqlite3_last_insert_rowid(db->handle);
 
 	return 0;
+fail_stmt:
+	sqlite3_finalize(stmt);
 fail:
 	return -1;
 }
@@ -803,7 +2252,7 @@ static sqlite3_int64 _safeword_get_tag_id(struct safeword_db *db, const char *ta
 
 	ret = sqlite3_prepare_v2(db->handle, sql, strlen(sql) + 1, &stmt, NULL);
 	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
-	ret = sqlite3_bind_text(stmt, 1, tag, strlen(tag) + 1, SQLITE_STATIC);
+	ret = sqlite3_bind_text(stmt, 1, tag, strlen(tag), SQLITE_STATIC);
 	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
 	ret = sqlite3_step(stmt);
 	id = sqlite3_column_int64(stmt, 0);
@@ -818,7 +2267,8 @@ int safeword_credential_tag(struct safeword_db *db, long int credential_id, cons
 {
 	int ret;
 	char *id_sql = "INSERT INTO tags (tag) VALUES (?);";
-	char *map_sql = "INSERT OR REPLACE INTO tagged_credentials (credentialid, tagid) VALUES (?, ?);";
+	/* REPLACE would count an existing mapping again in tag_stats */
+	char *map_sql = "INSERT OR IGNORE INTO tagged_credentials (credentialid, tagid) VALUES (?, ?);";
 	sqlite3_int64 tag_id = 0; /* set to invalid value to represent it does not exist */
 	sqlite3_stmt *id_stmt = NULL, *map_stmt = NULL;
 
@@ -830,7 +2280,7 @@ int safeword_credential_tag(struct safeword_db *db, long int credential_id, cons
 	if (!tag_id) {
 		ret = sqlite3_prepare_v2(db->handle, id_sql, strlen(id_sql) + 1, &id_stmt, NULL);
 		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
-		ret = sqlite3_bind_text(id_stmt, 1, tag, strlen(tag) + 1, SQLITE_STATIC);
+		ret = sqlite3_bind_text(id_stmt, 1, tag, strlen(tag), SQLITE_STATIC);
 		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
 		ret = sqlite3_step(id_stmt);
 		safeword_check(ret == SQLITE_DONE, ESAFEWORD_BACKENDSTORAGE, fail);
@@ -893,19 +2343,27 @@ fail:
 int safeword_tag_update(struct safeword_db *db, struct safeword_tag *tag)
 {
 	int ret;
-	char *sql = "UPDATE OR ABORT tags SET wiki = ? WHERE tag = ?;";
+	char *sql = "INSERT OR REPLACE INTO tag_wikis (tagid, wiki) SELECT id, ? FROM tags WHERE tag = ?;";
 	sqlite3_stmt *stmt = NULL;
+	unsigned char *packed = NULL;
+	size_t packed_size = 0;
 
 	safeword_check(tag != NULL, ESAFEWORD_INVARG, fail);
 	safeword_check(tag->tag != NULL, ESAFEWORD_INVARG, fail);
 
 	if (tag->wiki) {
+#ifdef SAFEWORD_ZLIB
+		packed = wiki_pack(tag->wiki, strlen(tag->wiki), &packed_size);
+#endif
 		/* Replace the existing wiki column value with the new value */
 		ret = sqlite3_prepare_v2(db->handle, sql, strlen(sql) + 1, &stmt, NULL);
 		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
-		ret = sqlite3_bind_text(stmt, 1, tag->wiki, strlen(tag->wiki) + 1, SQLITE_STATIC);
+		if (packed)
+			ret = sqlite3_bind_blob(stmt, 1, packed, packed_size, free);
+		else
+			ret = sqlite3_bind_text(stmt, 1, tag->wiki, strlen(tag->wiki), SQLITE_STATIC);
 		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
-		ret = sqlite3_bind_text(stmt, 2, tag->tag, strlen(tag->tag) + 1, SQLITE_STATIC);
+		ret = sqlite3_bind_text(stmt, 2, tag->tag, strlen(tag->tag), SQLITE_STATIC);
 		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
 		ret = sqlite3_step(stmt);
 		safeword_check(ret == SQLITE_DONE, ESAFEWORD_BACKENDSTORAGE, fail);
@@ -918,73 +2376,405 @@ fail:
 	return -1;
 }
 
+/*
+ * The size of the rest of @c in. A stream whose size is not known up front,
+ * such as a pipe, is first copied to @c *spool, a temporary file read in its
+ * place, so the wiki can be written without holding it in memory.
+ */
+static int wiki_input_size(FILE *in, FILE **spool, sqlite3_int64 *size)
+{
+	char chunk[SAFEWORD_WIKI_CHUNK];
+	size_t n;
+	off_t at;
+	struct stat st;
+
+	*spool = NULL;
+	at = ftello(in);
+	if (at != -1 && !fstat(fileno(in), &st) && S_ISREG(st.st_mode)) {
+		*size = st.st_size - at;
+		return 0;
+	}
+
+	*spool = tmpfile();
+	safeword_check(*spool != NULL, ESAFEWORD_NOMEM, fail);
+	while ((n = fread(chunk, 1, sizeof(chunk), in)) > 0)
+		safeword_check(fwrite(chunk, 1, n, *spool) == n, ESAFEWORD_NOMEM, fail_spool);
+	safeword_check(!ferror(in), ESAFEWORD_INVARG, fail_spool);
+	*size = ftello(*spool);
+	rewind(*spool);
+
+	return 0;
+fail_spool:
+	fclose(*spool);
+	*spool = NULL;
+fail:
+	return -1;
+}
+
+#ifdef SAFEWORD_ZLIB
+/*
+ * Compress the @c size bytes left in @c in to @c *packed, a temporary file
+ * starting with the wiki header. @c *packed is NULL if compressing would not
+ * make the wiki smaller, @c in is then at an unknown position.
+ */
+static int wiki_deflate(FILE *in, sqlite3_int64 size, FILE **packed, sqlite3_int64 *packed_size)
+{
+	int ret, flush;
+	unsigned char chunk[SAFEWORD_WIKI_CHUNK], out[SAFEWORD_WIKI_CHUNK];
+	size_t n, have;
+	sqlite3_int64 left = size;
+	z_stream z;
+
+	*packed = NULL;
+	if (!_compress || size < SAFEWORD_COMPRESS_MIN)
+		return 0;
+
+	memset(&z, 0, sizeof(z));
+	ret = deflateInit(&z, Z_DEFAULT_COMPRESSION);
+	safeword_check(ret == Z_OK, ESAFEWORD_NOMEM, fail);
+	*packed = tmpfile();
+	safeword_check(*packed != NULL, ESAFEWORD_NOMEM, fail_stream);
+
+	wiki_header(out, size);
+	safeword_check(fwrite(out, 1, WIKI_HEADER_SIZE, *packed) == WIKI_HEADER_SIZE,
+		ESAFEWORD_NOMEM, fail_packed);
+	*packed_size = WIKI_HEADER_SIZE;
+	do {
+		n = fread(chunk, 1, left < (sqlite3_int64) sizeof(chunk) ? (size_t) left : sizeof(chunk), in);
+		left -= n;
+		flush = n && left ? Z_NO_FLUSH : Z_FINISH;
+		z.next_in = chunk;
+		z.avail_in = n;
+		do {
+			z.next_out = out;
+			z.avail_out = sizeof(out);
+			ret = deflate(&z, flush);
+			have = sizeof(out) - z.avail_out;
+			safeword_check(fwrite(out, 1, have, *packed) == have, ESAFEWORD_NOMEM, fail_packed);
+			*packed_size += have;
+		} while (z.avail_out == 0);
+		/* incompressible, it is stored as it is */
+		if (*packed_size >= size) {
+			fclose(*packed);
+			*packed = NULL;
+			deflateEnd(&z);
+			return 0;
+		}
+	} while (flush != Z_FINISH);
+	/* a file shrinking while read is an error, as when it is stored as it is */
+	safeword_check(ret == Z_STREAM_END && !left, ESAFEWORD_INVARG, fail_packed);
+	deflateEnd(&z);
+	rewind(*packed);
+
+	return 0;
+fail_packed:
+	fclose(*packed);
+	*packed = NULL;
+fail_stream:
+	deflateEnd(&z);
+fail:
+	return -1;
+}
+
+/* uncompress the wiki in @c blob, behind its header, to @c out */
+static int wiki_inflate(sqlite3_blob *blob, const unsigned char *header, FILE *out, size_t *size)
+{
+	/* sqlite3 and zlib codes are kept apart, each is translated on its own */
+	int rc, zret = Z_OK, bytes, offset, n;
+	unsigned char chunk[SAFEWORD_WIKI_CHUNK], buf[SAFEWORD_WIKI_CHUNK];
+	size_t have;
+	sqlite3_int64 written = 0;
+	z_stream z;
+
+	memset(&z, 0, sizeof(z));
+	zret = inflateInit(&z);
+	safeword_check(zret != Z_MEM_ERROR, ESAFEWORD_NOMEM, fail);
+	safeword_check(zret == Z_OK, ESAFEWORD_COMPRESSED, fail);
+	bytes = sqlite3_blob_bytes(blob);
+	for (offset = WIKI_HEADER_SIZE; offset < bytes && zret != Z_STREAM_END; offset += n) {
+		n = bytes - offset < (int) sizeof(chunk) ? bytes - offset : (int) sizeof(chunk);
+		rc = sqlite3_blob_read(blob, chunk, n, offset);
+		safeword_check(rc == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_stream);
+		z.next_in = chunk;
+		z.avail_in = n;
+		do {
+			z.next_out = buf;
+			z.avail_out = sizeof(buf);
+			zret = inflate(&z, Z_NO_FLUSH);
+			safeword_check(zret != Z_MEM_ERROR, ESAFEWORD_NOMEM, fail_stream);
+			/* Z_BUF_ERROR only asks for more input */
+			safeword_check(zret == Z_OK || zret == Z_STREAM_END || zret == Z_BUF_ERROR,
+				ESAFEWORD_COMPRESSED, fail_stream);
+			have = sizeof(buf) - z.avail_out;
+			safeword_check(fwrite(buf, 1, have, out) == have, ESAFEWORD_INVARG, fail_stream);
+			written += have;
+		} while (z.avail_out == 0);
+	}
+	safeword_check(zret == Z_STREAM_END && written == wiki_header_size(header),
+		ESAFEWORD_COMPRESSED, fail_stream);
+	inflateEnd(&z);
+
+	if (size)
+		*size = written;
+	return 0;
+fail_stream:
+	inflateEnd(&z);
+fail:
+	return -1;
+}
+#endif
+
+int safeword_tag_wiki_write(struct safeword_db *db, const char *tag, FILE *in)
+{
+	int ret;
+	char chunk[SAFEWORD_WIKI_CHUNK];
+	size_t n;
+	FILE *spool, *packed = NULL;
+	sqlite3_int64 id, size, written = 0;
+	sqlite3_blob *blob = NULL;
+	sqlite3_stmt *stmt = NULL;
+	/* a zeroblob takes no memory, it is filled in place below */
+	const char *sql = "INSERT OR REPLACE INTO tag_wikis (tagid, wiki) VALUES (?2, zeroblob(?1));";
+
+	safeword_check(db != NULL, ESAFEWORD_INVARG, fail);
+	safeword_check(tag != NULL, ESAFEWORD_INVARG, fail);
+	safeword_check(in != NULL, ESAFEWORD_INVARG, fail);
+
+	id = _safeword_get_tag_id(db, tag);
+	safeword_check(id > 0, ESAFEWORD_INVARG, fail);
+
+	if (wiki_input_size(in, &spool, &size))
+		goto fail;
+	if (spool)
+		in = spool;
+#ifdef SAFEWORD_ZLIB
+	{
+		off_t at = ftello(in);
+		sqlite3_int64 packed_size;
+
+		if (wiki_deflate(in, size, &packed, &packed_size))
+			goto fail_spool;
+		if (packed) {
+			in = packed;
+			size = packed_size;
+		} else {
+			safeword_check(!fseeko(in, at, SEEK_SET), ESAFEWORD_INVARG, fail_spool);
+		}
+	}
+#endif
+	safeword_check(size <= sqlite3_limit(db->handle, SQLITE_LIMIT_LENGTH, -1),
+		ESAFEWORD_INVARG, fail_spool);
+
+	/* the wiki is replaced as a whole or not at all */
+	ret = sqlite3_exec(db->handle, "SAVEPOINT wiki;", 0, 0, 0);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_spool);
+
+	ret = sqlite3_prepare_v2(db->handle, sql, -1, &stmt, NULL);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_savepoint);
+	ret = sqlite3_bind_int64(stmt, 1, size);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_savepoint);
+	ret = sqlite3_bind_int64(stmt, 2, id);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_savepoint);
+	ret = sqlite3_step(stmt);
+	safeword_check(ret == SQLITE_DONE, ESAFEWORD_BACKENDSTORAGE, fail_savepoint);
+
+	ret = sqlite3_blob_open(db->handle, "main", "tag_wikis", "wiki", id, 1, &blob);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_savepoint);
+	while (written < size && (n = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+		/* a file growing while read is cut at the size it had */
+		if ((sqlite3_int64) n > size - written)
+			n = size - written;
+		ret = sqlite3_blob_write(blob, chunk, (int) n, (int) written);
+		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_savepoint);
+		written += n;
+	}
+	/* nor may it shrink, that would leave zeros at the end */
+	safeword_check(written == size, ESAFEWORD_INVARG, fail_savepoint);
+
+	ret = sqlite3_blob_close(blob);
+	blob = NULL;
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_savepoint);
+	sqlite3_finalize(stmt);
+	ret = sqlite3_exec(db->handle, "RELEASE wiki;", 0, 0, 0);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_savepoint);
+
+	if (packed)
+		fclose(packed);
+	if (spool)
+		fclose(spool);
+	return 0;
+fail_savepoint:
+	sqlite3_blob_close(blob);
+	sqlite3_finalize(stmt);
+	sqlite3_exec(db->handle, "ROLLBACK TO wiki; RELEASE wiki;", 0, 0, 0);
+fail_spool:
+	if (packed)
+		fclose(packed);
+	if (spool)
+		fclose(spool);
+fail:
+	return -1;
+}
+
+int safeword_tag_wiki_read(struct safeword_db *db, const char *tag, FILE *out, size_t *size)
+{
+	int ret, bytes, offset, n;
+	unsigned char chunk[SAFEWORD_WIKI_CHUNK];
+	sqlite3_int64 id;
+	sqlite3_blob *blob = NULL;
+	sqlite3_stmt *stmt = NULL;
+	const char *sql = "SELECT w.tagid FROM tags AS t INNER JOIN tag_wikis AS w ON (w.tagid = t.id) "
+		"WHERE t.tag = ?;";
+
+	safeword_check(db != NULL, ESAFEWORD_INVARG, fail);
+	safeword_check(tag != NULL, ESAFEWORD_INVARG, fail);
+	safeword_check(out != NULL, ESAFEWORD_INVARG, fail);
+
+	if (size)
+		*size = 0;
+
+	ret = sqlite3_prepare_v2(db->handle, sql, -1, &stmt, NULL);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+	ret = sqlite3_bind_text(stmt, 1, tag, -1, SQLITE_STATIC);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_stmt);
+	ret = sqlite3_step(stmt);
+	safeword_check(ret == SQLITE_ROW || ret == SQLITE_DONE, ESAFEWORD_BACKENDSTORAGE, fail_stmt);
+	/* no such tag or no wiki, nothing to write */
+	if (ret == SQLITE_DONE) {
+		sqlite3_finalize(stmt);
+		return 0;
+	}
+	id = sqlite3_column_int64(stmt, 0);
+	sqlite3_finalize(stmt);
+	stmt = NULL;
+
+	ret = sqlite3_blob_open(db->handle, "main", "tag_wikis", "wiki", id, 0, &blob);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+	bytes = sqlite3_blob_bytes(blob);
+
+	/* only the wiki is written, uncompressed if it was stored compressed */
+	if (bytes >= WIKI_HEADER_SIZE) {
+		ret = sqlite3_blob_read(blob, chunk, WIKI_HEADER_SIZE, 0);
+		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_blob);
+		if (wiki_is_packed(chunk, WIKI_HEADER_SIZE)) {
+#ifdef SAFEWORD_ZLIB
+			ret = wiki_inflate(blob, chunk, out, size);
+			sqlite3_blob_close(blob);
+			return ret;
+#else
+			safeword_check(0, ESAFEWORD_COMPRESSED, fail_blob);
+#endif
+		}
+	}
+	for (offset = 0; offset < bytes; offset += n) {
+		n = bytes - offset < (int) sizeof(chunk) ? bytes - offset : (int) sizeof(chunk);
+		ret = sqlite3_blob_read(blob, chunk, n, offset);
+		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_blob);
+		safeword_check(fwrite(chunk, 1, n, out) == (size_t) n, ESAFEWORD_INVARG, fail_blob);
+	}
+	sqlite3_blob_close(blob);
+
+	if (size)
+		*size = bytes;
+	return 0;
+fail_blob:
+	sqlite3_blob_close(blob);
+	return -1;
+fail_stmt:
+	sqlite3_finalize(stmt);
+fail:
+	return -1;
+}
+
 static sqlite3_stmt *get_filter_prepared_stmt(struct safeword_db *db, unsigned int filter_size, const char **filter,
 	int select_count)
 {
-	int ret = 0, i = 0;
-	/* Include enough for the '?' and ',' for the prepared statement. */
-	char sql[512 + (filter_size * 4)];
+	int ret = 0, i = 0, exact = 0, param = 1;
+	char *sql;
 	sqlite3_stmt *stmt = NULL;
 
 	safeword_check(filter != NULL, ESAFEWORD_INVARG, fail);
-	memset(sql, 0, sizeof(sql));
+
+	sql = calloc(512 + filter_size * 64, sizeof(char));
+	safeword_check(sql, ESAFEWORD_NOMEM, fail);
+	for (i = 0; i < filter_size; i++)
+		if (!tag_is_prefix(filter[i]))
+			exact++;
 
 	if (select_count)
-		sprintf(sql, "SELECT count(*) FROM (");
-	sprintf(sql + strlen(sql),
-	"SELECT tag FROM tags WHERE id IN ("
-	  "SELECT tagid FROM tagged_credentials WHERE credentialid IN ("
-	    "SELECT credentialid FROM tagged_credentials "
-	    "WHERE tagid IN "
-	      "(SELECT id FROM tags WHERE tag LIKE ");
-	for (i = 0; i < filter_size; i++) {
-		if (i != 0)
-			strcat(sql, " OR tag LIKE ");
-		strcat(sql, "?");
-	}
-	sprintf(sql + strlen(sql),
-	      ") "
-	    "GROUP BY credentialid "
-	    "HAVING count(DISTINCT tagid) = %d"
-	    ")"
-	") AND tag NOT LIKE ", filter_size);
-	for (i = 0; i < filter_size; i++) {
-		if (i != 0)
-			strcat(sql, " AND tag NOT LIKE ");
-		strcat(sql, "?");
+		strcat(sql, "SELECT count(*) FROM (");
+	strcat(sql, "SELECT id,tag FROM tags WHERE 1");
+	/* tags sharing a credential with all of the exact terms */
+	if (exact) {
+		strcat(sql, " AND id IN ("
+		  "SELECT tagid FROM tagged_credentials WHERE credentialid IN ("
+		    "SELECT tc.credentialid FROM tagged_credentials AS tc "
+		    "INNER JOIN tags AS t ON (tc.tagid = t.id) "
+		    "WHERE t.tag_folded IN (");
+		for (i = 0; i < exact; i++)
+			sprintf(sql + strlen(sql), i ? ",?%d" : "?%d", i + 1);
+		sprintf(sql + strlen(sql), ") "
+		    "GROUP BY tc.credentialid "
+		    "HAVING count(DISTINCT tc.tagid) = %d"
+		  ")"
+		") AND tag_folded NOT IN (", exact);
+		for (i = 0; i < exact; i++)
+			sprintf(sql + strlen(sql), i ? ",?%d" : "?%d", i + 1);
+		strcat(sql, ")");
+	}
+	/* within any of the prefixes */
+	if (exact < filter_size) {
+		strcat(sql, " AND (");
+		for (i = 0, param = exact + 1; param <= filter_size + (filter_size - exact); param += 2, i++)
+			sprintf(sql + strlen(sql), "%s(tag_folded >= ?%d AND tag_folded < ?%d)",
+				i ? " OR " : "", param, param + 1);
+		strcat(sql, ")");
 	}
 	if (select_count)
 		strcat(sql, ")");
-	sprintf(sql + strlen(sql), " ;");
+	strcat(sql, ";");
 
-	ret = sqlite3_prepare_v2(db->handle, sql, strlen(sql) + 1, &stmt, NULL);
+	ret = sqlite3_prepare_v2(db->handle, sql, -1, &stmt, NULL);
+	free(sql);
 	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
-	for (i = 0; i < filter_size; i++) {
-		ret = sqlite3_bind_text(stmt, i + 1, filter[i], strlen(filter[i]), SQLITE_STATIC);
-		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+
+	for (i = 0, param = 1; i < filter_size; i++) {
+		if (tag_is_prefix(filter[i]))
+			continue;
+		ret = bind_tag_folded(stmt, param++, filter[i]);
+		safeword_check(!ret, safeword_errno, fail_stmt);
 	}
 	for (i = 0; i < filter_size; i++) {
-		ret = sqlite3_bind_text(stmt, i + filter_size + 1, filter[i], strlen(filter[i]), SQLITE_STATIC);
-		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+		if (!tag_is_prefix(filter[i]))
+			continue;
+		ret = bind_tag_folded(stmt, param, filter[i]);
+		safeword_check(!ret, safeword_errno, fail_stmt);
+		param += 2;
 	}
 
 	return stmt;
+fail_stmt:
+	sqlite3_finalize(stmt);
 fail:
 	return NULL;
 }
 
-int safeword_list_tags(struct safeword_db *db, unsigned int *tags_size, char ***tags,
-	unsigned int filter_size, const char **filter)
+static int list_tags(struct safeword_db *db, struct safeword_arena *arena, unsigned int *tags_size,
+	char ***tags, unsigned int filter_size, const char **filter)
 {
 	int ret = 0, rows = 0, i = 0;
 	char *sql_tags_count = "SELECT count(*) FROM (SELECT tag FROM tags);";
-	char *sql_tags = "SELECT tag FROM tags;";
+	char *sql_tags = "SELECT id,tag FROM tags;";
 	const char *tag;
 	sqlite3_stmt *stmt = NULL;
 
+	safeword_check(db != NULL, ESAFEWORD_INVARG, fail);
 	safeword_check(tags_size != NULL, ESAFEWORD_INVARG, fail);
 	safeword_check(tags != NULL, ESAFEWORD_INVARG, fail);
 
+	*tags_size = 0;
+	*tags = NULL;
+
 	if (filter_size > 0) {
 		stmt = get_filter_prepared_stmt(db, filter_size, filter, 1);
 		safeword_check(stmt != NULL, safeword_errno, fail);
@@ -1001,7 +2791,8 @@ int safeword_list_tags(struct safeword_db *db, unsigned int *tags_size, char ***
 	stmt = NULL;
 	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
 
-	*tags_size = rows;
+	if (rows == 0)
+		return 0;
 
 	/* Now bind the tags to the prepared statement. */
 	if (filter_size > 0) {
@@ -1012,32 +2803,162 @@ int safeword_list_tags(struct safeword_db *db, unsigned int *tags_size, char ***
 		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
 	}
 
-	/* If we have any tags, create an array and copy them. */
-	if (*tags_size > 0) {
-		*tags = calloc(*tags_size, sizeof(char*));
-		safeword_check(*tags != NULL, ESAFEWORD_NOMEM, fail);
+	/* We have tags, create an array and copy them. */
+	*tags = result_alloc(arena, rows * sizeof(char*));
+	safeword_check(*tags != NULL, ESAFEWORD_NOMEM, fail_stmt);
 
-		i = 0; /* reset */
-		do {
-			ret = sqlite3_step(stmt);
-			if (ret == SQLITE_ROW) {
-				tag = (const char*) sqlite3_column_text(stmt, 0);
-				if (!tag) continue;
-				(*tags)[i] = calloc(strlen(tag) + 1, sizeof(char));
-				if (!((*tags)[i])) continue;
-				strcpy((*tags)[i], tag);
-				i++;
-			}
-		} while (ret == SQLITE_ROW);
+	while ((ret = sqlite3_step(stmt)) == SQLITE_ROW && i < rows) {
+		tag = (const char*) sqlite3_column_text(stmt, 1);
+		if (!tag) continue;
+		(*tags)[i] = result_strndup(arena, tag, sqlite3_column_bytes(stmt, 1));
+		safeword_check((*tags)[i], ESAFEWORD_NOMEM, fail_tags);
+		i++;
 	}
+	*tags_size = i;
 	ret = sqlite3_finalize(stmt);
 	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
 
 	return 0;
+fail_tags:
+	if (!arena)
+		safeword_tags_free(i, *tags);
+	*tags = NULL;
+fail_stmt:
+	sqlite3_finalize(stmt);
+fail:
+	return -1;
+}
+
+int safeword_list_tags(struct safeword_db *db, unsigned int *tags_size, char ***tags,
+	unsigned int filter_size, const char **filter)
+{
+	return list_tags(db, NULL, tags_size, tags, filter_size, filter);
+}
+
+int safeword_list_tag_stats(struct safeword_db *db, unsigned int *stats_size, struct safeword_tag_stats **stats)
+{
+	int ret = 0;
+	unsigned int size = 0, allocated = 0;
+	struct safeword_tag_stats *list = NULL, *grown;
+	char *sql = "SELECT tag, count, modified FROM tag_stats ORDER BY count DESC;";
+	sqlite3_stmt *stmt = NULL;
+
+	safeword_check(db != NULL, ESAFEWORD_INVARG, fail);
+	safeword_check(stats_size != NULL, ESAFEWORD_INVARG, fail);
+	safeword_check(stats != NULL, ESAFEWORD_INVARG, fail);
+
+	ret = sqlite3_prepare_v2(db->handle, sql, -1, &stmt, NULL);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+
+	while ((ret = sqlite3_step(stmt)) == SQLITE_ROW) {
+		if (size == allocated) {
+			allocated = allocated ? allocated * 2 : 16;
+			grown = realloc(list, allocated * sizeof(*list));
+			safeword_check(grown, ESAFEWORD_NOMEM, fail_list);
+			list = grown;
+		}
+		list[size].tag = result_strndup(NULL, (const char*) sqlite3_column_text(stmt, 0),
+			sqlite3_column_bytes(stmt, 0));
+		safeword_check(list[size].tag, ESAFEWORD_NOMEM, fail_list);
+		list[size].count = sqlite3_column_int(stmt, 1);
+		list[size].modified = (long int) sqlite3_column_int64(stmt, 2);
+		size++;
+	}
+	safeword_check(ret == SQLITE_DONE, ESAFEWORD_BACKENDSTORAGE, fail_list);
+	sqlite3_finalize(stmt);
+
+	*stats_size = size;
+	*stats = list;
+
+	return 0;
+fail_list:
+	safeword_tag_stats_free(size, list);
+	sqlite3_finalize(stmt);
+fail:
+	return -1;
+}
+
+int safeword_tag_stats_free(unsigned int stats_size, struct safeword_tag_stats *stats)
+{
+	int i;
+
+	if (!stats)
+		return 0;
+
+	for (i = 0; i < stats_size; i++)
+		free(stats[i].tag);
+	free(stats);
+
+	return 0;
+}
+
+int safeword_list_namespaces(struct safeword_db *db, unsigned int *namespaces_size, char ***namespaces)
+{
+	int ret = 0;
+	unsigned int size = 0, allocated = 0;
+	char **list = NULL, **grown;
+	const char *ns;
+	char *sql = "SELECT DISTINCT substr(tag_folded, 1, instr(tag_folded, ':') - 1) FROM tags "
+		"WHERE instr(tag_folded, ':') > 1 ORDER BY 1;";
+	sqlite3_stmt *stmt = NULL;
+
+	safeword_check(db != NULL, ESAFEWORD_INVARG, fail);
+	safeword_check(namespaces_size != NULL, ESAFEWORD_INVARG, fail);
+	safeword_check(namespaces != NULL, ESAFEWORD_INVARG, fail);
+
+	ret = sqlite3_prepare_v2(db->handle, sql, -1, &stmt, NULL);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+
+	while ((ret = sqlite3_step(stmt)) == SQLITE_ROW) {
+		if (size == allocated) {
+			allocated = allocated ? allocated * 2 : 8;
+			grown = realloc(list, allocated * sizeof(*list));
+			safeword_check(grown, ESAFEWORD_NOMEM, fail_list);
+			list = grown;
+		}
+		ns = (const char*) sqlite3_column_text(stmt, 0);
+		list[size] = result_strndup(NULL, ns, sqlite3_column_bytes(stmt, 0));
+		safeword_check(list[size], ESAFEWORD_NOMEM, fail_list);
+		size++;
+	}
+	safeword_check(ret == SQLITE_DONE, ESAFEWORD_BACKENDSTORAGE, fail_list);
+	sqlite3_finalize(stmt);
+
+	*namespaces_size = size;
+	*namespaces = list;
+
+	return 0;
+fail_list:
+	safeword_tags_free(size, list);
+	sqlite3_finalize(stmt);
+fail:
+	return -1;
+}
+
+int safeword_list_tags_arena(struct safeword_db *db, struct safeword_arena *arena,
+	unsigned int *tags_size, char ***tags, unsigned int filter_size, const char **filter)
+{
+	safeword_check(arena != NULL, ESAFEWORD_INVARG, fail);
+
+	return list_tags(db, arena, tags_size, tags, filter_size, filter);
 fail:
 	return -1;
 }
 
+int safeword_tags_free(unsigned int tags_size, char **tags)
+{
+	int i;
+
+	if (!tags)
+		return 0;
+
+	for (i = 0; i < tags_size; i++)
+		free(tags[i]);
+	free(tags);
+
+	return 0;
+}
+
 int safeword_tag_delete(struct safeword_db *db, const char *tag)
 {
 	int ret;
@@ -1079,186 +3000,163 @@ fail:
 
 /* #region safeword cp functions */
 
-/* returns the difference in milliseconds */
-static unsigned int diff(struct timespec *start, struct timespec *end)
-{
-	return ((end->tv_sec * 1000) + (end->tv_nsec / 1000000)) -
-		((start->tv_sec * 1000) + (start->tv_nsec / 1000000));
-}
-
 #ifndef WIN32
-struct __async_waiting_data {
-	volatile int *waiting;
-	Display *dpy;
-	Window *win;
-	char *data;
-};
-
-static void* wait_for_clipboard_request(void *waiting_data)
-{
-	struct __async_waiting_data *data = (struct __async_waiting_data*) waiting_data;
-	Display *dpy = data->dpy;
-	Window win = *data->win;
-	XSelectionRequestEvent *req;
-	XEvent e, respond;
-	static Atom targets;
-
-	if (!targets)
-		targets = XInternAtom(dpy, "TARGETS", False);
-
-	XSelectInput(dpy, win, PropertyChangeMask);
-	XSelectInput(dpy, win, StructureNotifyMask+ExposureMask);
-	XSetSelectionOwner(dpy, XA_CLIPBOARD(dpy), win, CurrentTime);
-
-	while (*data->waiting) {
-		XFlush(dpy);
-		XNextEvent(dpy, &e);
-		if (e.type == SelectionRequest) {
-			req=&(e.xselectionrequest);
-			if (req->target == targets) {
-				Atom supported[] = {
-					XA_UTF8_STRING(dpy),
-					XA_STRING
-				};
-				XChangeProperty(dpy,
-					req->requestor,
-					req->property,
-					XA_ATOM,
-					32,
-					PropModeReplace,
-					(unsigned char*) supported,
-					(int) (sizeof(supported) / sizeof(Atom)));
-				respond.xselection.property=req->property;
-			} else if (req->target == XA_UTF8_STRING(dpy) ||
-				req->target == XA_STRING) {
-				XChangeProperty(dpy,
-					req->requestor,
-					req->property,
-					req->target,
-					8,
-					PropModeReplace,
-					(unsigned char*) data->data,
-					strlen(data->data));
-				respond.xselection.property=req->property;
-
-				if (_copy_once) {
-					*data->waiting = 0;
-				}
-			} else {
-				respond.xselection.property= None;
-			}
-			respond.xselection.type= SelectionNotify;
-			respond.xselection.display= req->display;
-			respond.xselection.requestor= req->requestor;
-			respond.xselection.selection=req->selection;
-			respond.xselection.target= req->target;
-			respond.xselection.time = req->time;
-			XSendEvent(dpy, req->requestor,0,0,&respond);
-			XFlush(dpy);
+typedef int (*x11_copy_fn)(const char **texts, const size_t *sizes, unsigned int count,
+	unsigned int ms, int copy_once);
+
+/*
+ * The X11 backend lives in its own module so only copying loads the X
+ * libraries. SAFEWORD_X11_MODULE overrides where it is looked for, then the
+ * directory of the executable (a build tree), the install directory and
+ * finally the dynamic linker's search path.
+ */
+static x11_copy_fn load_x11(int background)
+{
+	static x11_copy_fn copy, hold;
+	static int loaded;
+	char paths[3][PATH_MAX];
+	const char *path;
+	void *module = NULL;
+	ssize_t size;
+	char *slash;
+	int i = 0;
+
+	if (loaded)
+		return background ? hold : copy;
+	loaded = 1;
+
+	path = getenv("SAFEWORD_X11_MODULE");
+	if (path && *path)
+		snprintf(paths[i++], PATH_MAX, "%s", path);
+#ifdef __linux__
+	size = readlink("/proc/self/exe", paths[i], PATH_MAX - sizeof(SAFEWORD_X11_MODULE_NAME));
+	if (size > 0) {
+		paths[i][size] = '\0';
+		if ((slash = strrchr(paths[i], '/'))) {
+			strcpy(slash + 1, SAFEWORD_X11_MODULE_NAME);
+			i++;
 		}
 	}
-	return 0;
+#endif
+#ifdef SAFEWORD_MODULE_DIR
+	snprintf(paths[i++], PATH_MAX, "%s/%s", SAFEWORD_MODULE_DIR, SAFEWORD_X11_MODULE_NAME);
+#endif
+
+	for (size = 0; size <= i && !module; size++) {
+		path = size < i ? paths[size] : SAFEWORD_X11_MODULE_NAME;
+		module = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+		if (!module)
+			debug("could not load '%s': %s", path, dlerror());
+	}
+	if (module) {
+		copy = (x11_copy_fn) dlsym(module, "safeword_x11_copy_fields");
+		hold = (x11_copy_fn) dlsym(module, "safeword_x11_hold_fields");
+	}
+
+	return background ? hold : copy;
 }
 #endif
 
-static int copy_credential_callback(void* millis, int argc, char** argv, char** col_name)
+/* the texts are served straight from the row, they stay valid until this returns */
+static int copy_to_clipboard(const char **texts, const size_t *sizes, unsigned int count,
+	unsigned int ms)
 {
 #ifdef WIN32
-	DWORD len = strlen(argv[0]);
+	/* without paste notifications only the first field can be copied */
+	int ret;
+	const char *text = texts[0];
+	DWORD len = sizes[0];
 	HGLOBAL lock;
 	LPWSTR data;
 
 	lock = GlobalAlloc(GMEM_MOVEABLE | GMEM_DDESHARE, (len + 1) * sizeof(char));
 	data = (LPWSTR)GlobalLock(lock);
-	memcpy(data, argv[0], len * sizeof(char));
+	memcpy(data, text, len * sizeof(char));
 	data[len] = 0;
 	GlobalUnlock(lock);
 
 	// Set clipboard data
-	if (!OpenClipboard(NULL)) return GetLastError();
+	safeword_check(OpenClipboard(NULL), ESAFEWORD_NOCLIPBOARD, fail);
 	EmptyClipboard();
-	if (!SetClipboardData(CF_TEXT, lock)) return GetLastError();
+	ret = SetClipboardData(CF_TEXT, lock) != NULL;
 	CloseClipboard();
+	safeword_check(ret, ESAFEWORD_NOCLIPBOARD, fail);
 
 	return 0;
+fail:
+	return -1;
 #else
-	int ret = 0;
-	unsigned int *ms = millis;
-	volatile int waiting = 1;
-	char *data;
-	struct timespec start, now;
-	Display *dpy;
-	Window win;
-
-	/* copy the data to local variable that will stay in scope for waiting thread */
-	data = calloc(strlen(argv[0]) + 1, sizeof(char));
-	safeword_check(data, ESAFEWORD_NOMEM, fail);
-
-	strcpy(data, argv[0]);
-
-	if (!(dpy = XOpenDisplay(NULL))) {
-		debug("could not open display\n");
-		ret = ESAFEWORD_BACKENDSTORAGE;
-		goto fail;
-	}
-
-	/* create a window to trap events */
-	win = XCreateSimpleWindow(dpy, DefaultRootWindow(dpy), 0, 0, 1, 1, 0, 0, 0);
-
-	clock_gettime(CLOCK_MONOTONIC, &start);
-	clock_gettime(CLOCK_MONOTONIC, &now);
-
-	struct __async_waiting_data waiting_data;
-	waiting_data.waiting = &waiting;
-	waiting_data.dpy = dpy;
-	waiting_data.win = &win;
-	waiting_data.data = data;
-
-	pthread_t tid;
-	pthread_create(&tid, NULL, &wait_for_clipboard_request, &waiting_data);
+	int ret;
+	x11_copy_fn copy;
+	long long span = safeword_trace_enabled ? safeword_trace_now() : 0;
 
-	while (waiting) {
-		if (diff(&start, &now) > *ms) {
-			pthread_cancel(tid);
-			waiting = 0;
-		}
+	copy = load_x11(_copy_background);
+	safeword_trace_span("x11", "load " SAFEWORD_X11_MODULE_NAME, span, copy ? NULL : "not found", -1);
+	safeword_check(copy != NULL, ESAFEWORD_NOCLIPBOARD, fail);
 
-		clock_gettime(CLOCK_MONOTONIC, &now);
-	}
+	if (safeword_trace_enabled)
+		span = safeword_trace_now();
+	ret = copy(texts, sizes, count, ms, _copy_once);
+	safeword_trace_span("x11", _copy_background ? "clipboard handed to holder" : "clipboard",
+		span, NULL, count);
+	/* the backend returns a safeword error number */
+	safeword_check(ret == 0, ret, fail);
 
+	return 0;
 fail:
-	free(data);
-	return ret;
+	return -1;
 #endif
 }
 
-static int safeword_cp(struct safeword_db *db, int credential_id, unsigned int ms,
-	const char* table, const char* field)
+int safeword_cp_fields(struct safeword_db *db, int credential_id, const int *fields,
+	unsigned int fields_size, unsigned int ms)
 {
-	int ret;
-	char *sql;
-
-	sql = calloc(256, sizeof(char));
-	safeword_check(sql != NULL, ESAFEWORD_NOMEM, fail);
-
-	sprintf(sql, "SELECT t.%s FROM %s AS t "
-		"INNER JOIN credentials AS c "
-		"ON (c.%sid = t.id) WHERE c.id = %d;", field, table, field, credential_id);
-	ret = sqlite3_exec(db->handle, sql, copy_credential_callback, &ms, 0);
-	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
-	free(sql);
-fail:
+	int ret, mask = 0;
+	unsigned int i, count = 0;
+	const char *texts[SAFEWORD_CP_FIELDS_MAX];
+	size_t sizes[SAFEWORD_CP_FIELDS_MAX];
+	struct safeword_cursor cursor;
+
+	safeword_check(fields != NULL, ESAFEWORD_INVARG, fail);
+	safeword_check(fields_size > 0 && fields_size <= SAFEWORD_CP_FIELDS_MAX, ESAFEWORD_INVARG, fail);
+
+	/* every field comes from the one row, which holds only the fields copied */
+	for (i = 0; i < fields_size; i++)
+		mask |= fields[i];
+	ret = safeword_cursor_credential_fields(db, &cursor, credential_id, mask & ~SAFEWORD_FIELD_TAGS);
+	safeword_check(ret == 0, safeword_errno, fail);
+
+	ret = safeword_cursor_next(&cursor);
+	safeword_check(ret >= 0, safeword_errno, fail_cursor);
+	safeword_check(ret == 1, ESAFEWORD_NOCREDENTIAL, fail_cursor);
+
+	/* fields the credential does not have are skipped */
+	for (i = 0; i < fields_size; i++) {
+		texts[count] = safeword_cursor_text(&cursor, fields[i], &sizes[count]);
+		if (texts[count])
+			count++;
+	}
+	ret = count ? copy_to_clipboard(texts, sizes, count, ms) : 0;
+	safeword_cursor_close(&cursor);
 	return ret;
+fail_cursor:
+	safeword_cursor_close(&cursor);
+fail:
+	return -1;
 }
 
 int safeword_cp_username(struct safeword_db *db, int credential_id, unsigned int ms)
 {
-	return safeword_cp(db, credential_id, ms, "usernames", "username");
+	int field = SAFEWORD_FIELD_USERNAME;
+
+	return safeword_cp_fields(db, credential_id, &field, 1, ms);
 }
 
 int safeword_cp_password(struct safeword_db *db, int credential_id, unsigned int ms)
 {
-	return safeword_cp(db, credential_id, ms, "passwords", "password");
+	int field = SAFEWORD_FIELD_PASSWORD;
+
+	return safeword_cp_fields(db, credential_id, &field, 1, ms);
 }
 
 /* #endregion safeword cp functions */
@@ -13,6 +13,11 @@
 #define STR(x) STR_HELPER(x)
 #define SAFEWORD_VERSION STR(SAFEWORD_VERSION_MAJOR) "." STR(SAFEWORD_VERSION_MINOR) "." STR(SAFEWORD_VERSION_PATCH)
 
+/* version of the database schema written by this library */
+#define SAFEWORD_SCHEMA_VERSION 10
+
+#include <stdio.h>
+#include <stddef.h>
 #include <errno.h>
 #include <sqlite3.h>
 
@@ -21,17 +26,42 @@
 #define ESAFEWORD_BACKENDSTORAGE 3 /* Backend storage */
 #define ESAFEWORD_NOMEM          4 /* Out of memory */
 #define ESAFEWORD_NOCREDENTIAL   5 /* Credential does not exist */
+#define ESAFEWORD_CANCELED       6 /* Request canceled */
+#define ESAFEWORD_SCHEMA         7 /* Database schema is newer than supported */
+#define ESAFEWORD_NOCLIPBOARD    8 /* Clipboard is not available */
+#define ESAFEWORD_COMPACTED      9 /* Changes were compacted */
+#define ESAFEWORD_FORMAT        10 /* Import could not be read */
+#define ESAFEWORD_COMPRESSED    11 /* Compressed data could not be read */
+
+/* the clipboard backend loaded by the safeword_cp functions */
+#ifndef SAFEWORD_X11_MODULE_NAME
+#define SAFEWORD_X11_MODULE_NAME "libsafeword_x11.so"
+#endif
+
+/* database paths opening a vault in memory, see safeword_open */
+#define SAFEWORD_MEMORY             ":memory:"
+#define SAFEWORD_MEMORY_PREFIX      "memory:"
+#define SAFEWORD_MEMORY_SAVE_PREFIX "memory+save:"
 
-extern int safeword_errno;
+/* thread-local so async workers do not clobber the caller's error */
+extern __thread int safeword_errno;
 
 #define safeword_check(T, ERR, GOTO) if (!(T)) { safeword_errno = (ERR); goto GOTO; }
 
 char* safeword_strerror(int errnum);
 void safeword_perror(const char *string);
 
+struct safeword_access;
+
 struct safeword_db {
 	char    *path;
+	/* the file an in-memory database is written back to, within path */
+	const char *save_path;
 	sqlite3 *handle;
+	/* credential accesses not yet written, see safeword_flush_accesses */
+	struct safeword_access *accesses;
+	unsigned int accesses_size;
+	unsigned int accesses_capacity;
 };
 
 struct safeword_tag {
@@ -39,6 +69,36 @@ struct safeword_tag {
 	char *wiki;
 };
 
+struct safeword_tag_stats {
+	char *tag;
+	/* number of credentials with the tag */
+	unsigned int count;
+	/* seconds since the epoch the tag was last mapped or unmapped, 0 if unknown */
+	long int modified;
+};
+
+/* orders of @link safeword_list_credentials_page @endlink */
+#define SAFEWORD_SORT_ID          0
+#define SAFEWORD_SORT_DESCRIPTION 1
+
+/**
+ * bounds and order of a page of credentials
+ *
+ * A page resumes after the last credential of the previous one: pass its
+ * @c id as @c after_id and, when sorting by description, its description
+ * as @c after_description (or leave it @c NULL to have it looked up).
+ */
+struct safeword_list_options {
+	/* maximum number of credentials, 0 for no limit */
+	unsigned int limit;
+	/* SAFEWORD_SORT_ID or SAFEWORD_SORT_DESCRIPTION */
+	int sort;
+	/* list credentials after this one, 0 to start from the beginning */
+	long int after_id;
+	/* description sort key to resume after */
+	const char *after_description;
+};
+
 struct safeword_credential {
 	int  id;
 	char *username;
@@ -48,6 +108,148 @@ struct safeword_credential {
 	char **tags;
 };
 
+/* credential fields, combinable as a mask */
+#define SAFEWORD_FIELD_USERNAME    0x1
+#define SAFEWORD_FIELD_PASSWORD    0x2
+#define SAFEWORD_FIELD_DESCRIPTION 0x4
+#define SAFEWORD_FIELD_TAGS        0x8
+#define SAFEWORD_FIELD_ALL         0xf
+
+/**
+ * rows of a query that are read in place
+ *
+ * The text returned by @link safeword_cursor_text @endlink points into the
+ * current row and is only valid until the cursor advances or is closed.
+ */
+struct safeword_cursor {
+	sqlite3_stmt *stmt;
+	/* column of each field in stmt, -1 if it is not selected */
+	int columns[4];
+	/* private, records an access of the credential once its row is read */
+	struct safeword_db *_access;
+};
+
+struct safeword_arena_block;
+
+/**
+ * memory that read results are carved from
+ *
+ * Results read into an arena share one allocation and are released together
+ * by @link safeword_arena_reset @endlink or @link safeword_arena_free
+ * @endlink, never with @link safeword_credential_free @endlink. When a reset
+ * arena is reused for results no larger than before no memory is allocated.
+ */
+struct safeword_arena {
+	struct safeword_arena_block *blocks;
+	/* number of times memory was requested from the system */
+	unsigned int allocations;
+};
+
+/**
+ * called once per credential by the list functions
+ *
+ * The strings in @c credential are only valid for the duration of the call.
+ * Returning non-zero stops the iteration.
+ */
+typedef int (*safeword_credential_callback)(struct safeword_credential *credential, void *arg);
+/**
+ * called after each committed chunk of a schema migration
+ *
+ * @c done and @c total are in rows of the migration to @c version.
+ * Returning non-zero interrupts the migration; it resumes from the last
+ * committed chunk the next time the database is migrated.
+ */
+typedef int (*safeword_progress_callback)(int version, long int done, long int total, void *arg);
+/**
+ * called after each step of a backup
+ *
+ * @c done and @c total are in pages of the database being backed up.
+ * Returning non-zero cancels the backup.
+ */
+typedef int (*safeword_backup_callback)(int done, int total, void *arg);
+
+/* what a change applies to, see struct safeword_change */
+#define SAFEWORD_CHANGE_CREDENTIAL 0
+#define SAFEWORD_CHANGE_TAG        1
+#define SAFEWORD_CHANGE_TAGGING    2
+
+#define SAFEWORD_CHANGE_INSERT 0
+#define SAFEWORD_CHANGE_UPDATE 1
+#define SAFEWORD_CHANGE_DELETE 2
+
+struct safeword_change {
+	long long seq;
+	int kind;
+	int op;
+	/* the credential or the tag, the credential for a tagging */
+	long int id;
+	/* the tag of a tagging */
+	long int tag_id;
+	/* seconds since the epoch */
+	long int at;
+};
+
+/**
+ * called for each change read from the change log
+ *
+ * Returning non-zero stops the iteration.
+ */
+typedef int (*safeword_change_callback)(const struct safeword_change *change, void *arg);
+
+/* what @link safeword_audit_reuse @endlink looks for shared values of */
+#define SAFEWORD_REUSE_USERNAME 1
+#define SAFEWORD_REUSE_PASSWORD 2
+
+/**
+ * called for each group of credentials sharing a username or a password
+ *
+ * @c field is @a SAFEWORD_REUSE_USERNAME or @a SAFEWORD_REUSE_PASSWORD and
+ * @c ids, valid only during the call, the credentials sharing it in
+ * ascending order. Returning non-zero stops the iteration.
+ */
+typedef int (*safeword_reuse_callback)(int field, unsigned int ids_size, const long int *ids, void *arg);
+
+struct safeword_sync_stats {
+	/* changes merged into the vault from its peer */
+	unsigned int received;
+	/* changes merged into the peer */
+	unsigned int sent;
+	/* changes made in both that lost to the other's */
+	unsigned int conflicts;
+};
+
+/* bytes a tag wiki is read and written in at a time */
+#define SAFEWORD_WIKI_CHUNK 8192
+/* wikis shorter than this are never compressed */
+#define SAFEWORD_COMPRESS_MIN 512
+
+#define SAFEWORD_IMPORT_KEEPASS_CSV 0
+
+/* credentials added per transaction by safeword_import */
+#define SAFEWORD_IMPORT_BATCH 1000
+
+struct safeword_import_stats {
+	/* credentials added to the vault */
+	unsigned int imported;
+	/* the line of the input the last record read starts on */
+	unsigned int line;
+};
+
+/* pages copied per backup step and the pause between steps by default */
+#define SAFEWORD_BACKUP_PAGES    64
+#define SAFEWORD_BACKUP_SLEEP_MS 10
+
+struct safeword_backup_options {
+	/* pages copied per step, 0 for SAFEWORD_BACKUP_PAGES */
+	int pages;
+	/* milliseconds between steps for writers to get the vault, 0 not to pause */
+	int sleep_ms;
+	/* backups kept including the new one, 0 or 1 to only keep that */
+	unsigned int keep;
+	safeword_backup_callback progress;
+	void *arg;
+};
+
 /**
  * create a safeword database
  *
@@ -64,10 +266,23 @@ int safeword_init(const char *path);
  * open the safeword database specified by @c path
  *
  * This function opens the safeword database @c path to be used by other
- * safeword functions and initializes @c db.
+ * safeword functions and initializes @c db. A database with an older schema
+ * is migrated first (see @link safeword_migrate @endlink).
+ *
+ * The database is kept in memory instead when @c path is one of:
+ *
+ * - @c SAFEWORD_MEMORY, an empty database that is never written anywhere
+ * - @c SAFEWORD_MEMORY_PREFIX followed by a file, loaded into memory in one
+ *   go; changes are discarded when the database is closed
+ * - @c SAFEWORD_MEMORY_SAVE_PREFIX followed by a file, loaded like the
+ *   above and written back to the file by @link safeword_close @endlink
+ *
+ * Other connections to the same path, such as an async worker's, do not
+ * share an in-memory database.
  *
  * @param db a pointer to the safeword database to be initialized
- * @param path the safeword database file to be initialized
+ * @param path the safeword database file to be initialized, or @c NULL to
+ * use the @a SAFEWORD_DB environment variable
  *
  * @see safeword_init, safeword_close
  */
@@ -75,13 +290,120 @@ int safeword_open(struct safeword_db *db, const char *path);
 /**
  * close the specified safeword database
  *
- * This function cleans up memory allocated in @link safeword_open @endlink.
+ * This function cleans up memory allocated in @link safeword_open @endlink
+ * after writing the credential accesses still pending and, for a database
+ * opened with @c SAFEWORD_MEMORY_SAVE_PREFIX, writing it back to its file.
+ * The database is closed even if writing it back fails.
  *
  * @param db a pointer to the safeword database to be closed
  *
- * @see safeword_init, safeword_open
+ * @see safeword_init, safeword_open, safeword_flush_accesses
  */
 int safeword_close(struct safeword_db *db);
+/**
+ * back up an open safeword database to @c path
+ *
+ * The database is copied a few pages at a time with the SQLite backup API,
+ * pausing between steps, so other connections keep writing to it while the
+ * backup runs. The copy is written to @c path with ".partial" appended and
+ * only replaces @c path once PRAGMA quick_check accepts it. With
+ * @c options->keep above 1 the previous backups are first rotated to
+ * @c path.1, @c path.2 and so on, dropping the oldest.
+ *
+ * @param db the safeword database to back up
+ * @param path the backup file
+ * @param options how to pace the backup, may be @c NULL for the defaults
+ * @return 0 on success, -1 on failure; @a ESAFEWORD_CANCELED if the
+ *         progress callback canceled the backup
+ */
+int safeword_backup(struct safeword_db *db, const char *path,
+	const struct safeword_backup_options *options);
+/**
+ * merge an open safeword database and the one at @c path both ways
+ *
+ * Every credential, tag and tagging carries a uuid and the revision of the
+ * vault's clock it last changed at; deletions leave tombstones. Each vault
+ * remembers the other's clock as of their last sync, so only the changes
+ * made since are read and applied, in a single transaction over both. When
+ * both vaults changed the same row the later change wins, and on a tie the
+ * vault with the larger uuid. A tag created in both is merged by its name.
+ *
+ * @param db the safeword database
+ * @param path the peer's file, attached for the duration of the sync
+ * @param stats filled in with the number of changes applied, may be @c NULL
+ * @return 0 on success, -1 on failure in which case neither vault changed
+ */
+int safeword_sync(struct safeword_db *db, const char *path, struct safeword_sync_stats *stats);
+/**
+ * import credentials into a safeword database
+ *
+ * @c in is read once from where it is, as it is streamed, so it may be a
+ * pipe. For @a SAFEWORD_IMPORT_KEEPASS_CSV the first record names the
+ * columns, as KeePass and KeePassX write them; the title, username and
+ * password are imported and every group on the group path becomes a tag.
+ * Credentials are added in transactions of @a SAFEWORD_IMPORT_BATCH, so on
+ * failure the batches before the failing record stay imported.
+ *
+ * @param db the safeword database to import into
+ * @param in the export to read
+ * @param format the format of @c in, a SAFEWORD_IMPORT_ value
+ * @param stats filled in with the credentials imported, may be @c NULL
+ * @return 0 on success, -1 on failure; @a ESAFEWORD_FORMAT if @c in could not
+ *         be read or is not in @c format, @c stats tells on which line
+ */
+int safeword_import(struct safeword_db *db, FILE *in, int format,
+	struct safeword_import_stats *stats);
+/**
+ * write the pending credential accesses of a safeword database
+ *
+ * Reading the username or password of a credential through @link
+ * safeword_cursor_credential @endlink, and so @link safeword_credential_read
+ * @endlink and the @c safeword_cp functions, only remembers the access. An
+ * access is remembered once the credential's row is read, reading only its
+ * description or tags is not an access. The accesses are written in a single
+ * transaction here, which @link safeword_close @endlink calls, so reads never
+ * wait for a write to reach the disk. The worker of @link
+ * safeword_async_create @endlink also calls it between batches, once enough
+ * accesses are pending or some time has passed. Pending accesses are dropped
+ * rather than waiting if another connection holds the vault.
+ *
+ * @param db the safeword database whose accesses are written
+ */
+int safeword_flush_accesses(struct safeword_db *db);
+/**
+ * set the progress callback used when @link safeword_open @endlink migrates
+ *
+ * @param progress the callback, or @c NULL to migrate silently
+ * @param arg passed through to @c progress
+ */
+void safeword_open_progress(safeword_progress_callback progress, void *arg);
+/**
+ * get the schema version of the safeword database
+ *
+ * Databases created before schema versioning are version 0.
+ *
+ * @param db the safeword database
+ * @return the schema version, or -1 on failure
+ */
+int safeword_schema_version(struct safeword_db *db);
+/**
+ * upgrade the safeword database to the latest schema version
+ *
+ * Migrations are applied in order. Long migrations run in chunks of
+ * @c chunk rows, each committed in its own transaction, so the database stays
+ * usable by other connections while it upgrades and an interrupted migration
+ * resumes from the last committed chunk.
+ *
+ * @param db the safeword database
+ * @param chunk rows per transaction, or 0 for the default
+ * @param progress called after each chunk, may be @c NULL
+ * @param arg passed through to @c progress
+ * @return 0 on success, -1 on failure; @a ESAFEWORD_CANCELED if @c progress
+ *         interrupted the migration and @a ESAFEWORD_SCHEMA if the database
+ *         is newer than this library
+ */
+int safeword_migrate(struct safeword_db *db, unsigned int chunk,
+	safeword_progress_callback progress, void *arg);
 int safeword_config(const char* key, const char* value);
 char* safeword_credential_tostring(struct safeword_credential *credential);
 /**
@@ -136,6 +458,59 @@ struct safeword_credential *safeword_credential_create(const char *username, con
  * safeword_credential_delete, safeword_credential_add
  */
 int safeword_credential_read(struct safeword_db *db, struct safeword_credential *credential);
+/**
+ * read only some of the fields of an existing credential
+ *
+ * Behaves like @link safeword_credential_read @endlink except that only the
+ * fields in @c fields are queried and allocated. The members of the other
+ * fields are freed and set to NULL, so a password that is not asked for
+ * never reaches memory.
+ *
+ * @param db the database to query
+ * @param credential a pointer to a @link safeword_credential @endlink to
+ * store data results in
+ * @param fields a mask of the SAFEWORD_FIELD_* values to read
+ *
+ * @see safeword_credential_read, safeword_credential_free
+ */
+int safeword_credential_read_fields(struct safeword_db *db, struct safeword_credential *credential, int fields);
+/**
+ * read an existing credential into an arena
+ *
+ * Behaves like @link safeword_credential_read @endlink except that every
+ * string and the tags array are allocated from @c arena. The members of @c
+ * credential remain valid until @c arena is reset or freed.
+ *
+ * @param db the database to query
+ * @param arena the arena to allocate the results from
+ * @param credential a pointer to a @link safeword_credential @endlink to
+ * store data results in
+ *
+ * @see safeword_credential_read, safeword_arena_reset
+ */
+int safeword_credential_read_arena(struct safeword_db *db, struct safeword_arena *arena,
+	struct safeword_credential *credential);
+/**
+ * read many existing credentials at once
+ *
+ * Reads the credential of each of @c ids, with its tags, into the matching
+ * element of @c credentials. However many ids there are, the credentials
+ * are read with two statements per 500 ids rather than a few per
+ * credential. An id without a credential, or repeating an earlier one,
+ * leaves its element zeroed, @c id 0 included. Each credential read is
+ * remembered as an access, see @link safeword_flush_accesses @endlink.
+ *
+ * @param db the database to query
+ * @param ids the ids of the credentials to read
+ * @param ids_size the number of @c ids
+ * @param credentials @c ids_size credentials, overwritten without being
+ * freed; each has to be freed with @link safeword_credential_free @endlink
+ * @return 0 on success, -1 on failure in which case every element is zeroed
+ *
+ * @see safeword_credential_read, safeword_credential_free
+ */
+int safeword_credential_read_many(struct safeword_db *db, const long int *ids, unsigned int ids_size,
+	struct safeword_credential *credentials);
 /**
  * modify an existing credential
  *
@@ -234,6 +609,43 @@ int safeword_tag_read(struct safeword_db *db, struct safeword_tag *tag);
  * safeword_tag_rename
  */
 int safeword_tag_update(struct safeword_db *db, struct safeword_tag *tag);
+/**
+ * replace the wiki of a tag with the contents of a stream
+ *
+ * The wiki is written in chunks of @a SAFEWORD_WIKI_CHUNK, so memory use does
+ * not depend on its size. @c in is read from where it is to its end; a pipe
+ * is first copied to a temporary file, as the size of the wiki has to be
+ * known before it is written.
+ *
+ * Built with zlib, a wiki of at least @a SAFEWORD_COMPRESS_MIN bytes is
+ * stored compressed when that makes it smaller, unless the @c compress
+ * option of @link safeword_config @endlink is set to 0.
+ *
+ * @param db the database to modify
+ * @param tag the tag whose wiki is replaced, it has to exist
+ * @param in the new wiki
+ * @return 0 on success, -1 on failure in which case the wiki is unchanged
+ *
+ * @see safeword_tag_wiki_read, safeword_tag_update
+ */
+int safeword_tag_wiki_write(struct safeword_db *db, const char *tag, FILE *in);
+/**
+ * write the wiki of a tag to a stream
+ *
+ * The wiki is read in chunks of @a SAFEWORD_WIKI_CHUNK, so memory use does
+ * not depend on its size. A tag without a wiki, or no tag, writes nothing.
+ * A compressed wiki is uncompressed as it is written; without zlib it
+ * cannot be read and fails with @a ESAFEWORD_COMPRESSED.
+ *
+ * @param db the database to query
+ * @param tag the tag whose wiki is written
+ * @param out the stream the wiki is written to
+ * @param size set to the number of bytes written, may be @c NULL
+ * @return 0 on success, -1 on failure
+ *
+ * @see safeword_tag_wiki_write, safeword_tag_read
+ */
+int safeword_tag_wiki_read(struct safeword_db *db, const char *tag, FILE *out, size_t *size);
 /**
  * delete an existing tag
  *
@@ -268,6 +680,7 @@ int safeword_tag_rename(struct safeword_db *db, const char *old, const char *new
  * @param db the database to query
  * @param credential_id the credential id whose username to copy
  * @param ms milliseconds before clearing the clipboard
+ * @return 0 on success, -1 on failure, see @link safeword_cp_fields @endlink
  *
  * @see safeword_cp_password
  */
@@ -282,10 +695,42 @@ int safeword_cp_username(struct safeword_db *db, int credential_id, unsigned int
  * @param db the database to query
  * @param credential_id the credential id whose password to copy
  * @param ms milliseconds before clearing the clipboard
+ * @return 0 on success, -1 on failure, see @link safeword_cp_fields @endlink
  *
  * @see safeword_cp_username
  */
 int safeword_cp_password(struct safeword_db *db, int credential_id, unsigned int ms);
+/* most fields @link safeword_cp_fields @endlink copies in one session */
+#define SAFEWORD_CP_FIELDS_MAX 4
+/**
+ * copy several fields to the clipboard, one paste each
+ *
+ * The fields of the credential whose id is @c credential_id are read in one
+ * query and served by a single clipboard session: @c fields[0] is on the
+ * clipboard first and, if copy_once is set through @link safeword_config
+ * @endlink, each paste moves on to the next field. Without copy_once only
+ * the first field is served. The session ends once the last field is pasted
+ * or after @c ms milliseconds, whichever comes first; an @c ms of 0 never
+ * clears the clipboard. Fields the credential does not have are skipped.
+ *
+ * This blocks for the whole session unless copy_background is set through
+ * @link safeword_config @endlink, in which case a detached process forked
+ * from the caller serves the clipboard and this returns as soon as it owns
+ * it. Copying again replaces a holder that is still serving.
+ *
+ * @param db the database to query
+ * @param credential_id the credential id whose fields to copy
+ * @param fields the SAFEWORD_FIELD_* values to copy, in order
+ * @param fields_size number of @c fields, at most SAFEWORD_CP_FIELDS_MAX
+ * @param ms milliseconds before clearing the clipboard
+ * @return 0 on success, -1 on failure with @a safeword_errno set;
+ *         @a ESAFEWORD_NOCREDENTIAL if the credential does not exist and
+ *         @a ESAFEWORD_NOCLIPBOARD if the clipboard could not be served
+ *
+ * @see safeword_cp_username, safeword_cp_password
+ */
+int safeword_cp_fields(struct safeword_db *db, int credential_id, const int *fields,
+	unsigned int fields_size, unsigned int ms);
 /**
  * list tags in a safeword database
  *
@@ -294,7 +739,10 @@ int safeword_cp_password(struct safeword_db *db, int credential_id, unsigned int
  * in the array.
  *
  * If @c filter_size is zero or @c filter is @c NULL then @c tags will contain
- * all tags within the database.
+ * all tags within the database. Otherwise @c tags contains the tags sharing a
+ * credential with every filter tag. A filter tag ending in '*' (@a env:*) or
+ * ':' (@a env:) is a prefix instead and limits @c tags to those starting
+ * with it. Filters are matched case-insensitively.
  *
  * @param db the safeword database to query
  * @param tags_size number of tags in @c tags
@@ -306,6 +754,164 @@ int safeword_cp_password(struct safeword_db *db, int credential_id, unsigned int
  */
 int safeword_list_tags(struct safeword_db *db, unsigned int *tags_size, char ***tags,
 	unsigned int filter_size, const char **filter);
+/**
+ * list tags in a safeword database into an arena
+ *
+ * Behaves like @link safeword_list_tags @endlink except that the tags array
+ * and every tag are allocated from @c arena.
+ *
+ * @see safeword_list_tags, safeword_arena_reset
+ */
+int safeword_list_tags_arena(struct safeword_db *db, struct safeword_arena *arena,
+	unsigned int *tags_size, char ***tags, unsigned int filter_size, const char **filter);
+/**
+ * free the tags returned by @link safeword_list_tags @endlink
+ *
+ * @param tags_size number of tags in @c tags
+ * @param tags the tags to free
+ */
+int safeword_tags_free(unsigned int tags_size, char **tags);
+/**
+ * list how many credentials carry each tag
+ *
+ * The counts are maintained by the database as tags are mapped, so this
+ * reads them without counting. @c stats is sorted by count, most used tag
+ * first. Free the result with @link safeword_tag_stats_free @endlink.
+ *
+ * @param db the safeword database to query
+ * @param stats_size number of entries in @c stats
+ * @param stats the statistics of every tag
+ */
+int safeword_list_tag_stats(struct safeword_db *db, unsigned int *stats_size, struct safeword_tag_stats **stats);
+/**
+ * free the statistics returned by @link safeword_list_tag_stats @endlink
+ *
+ * @param stats_size number of entries in @c stats
+ * @param stats the statistics to free
+ */
+int safeword_tag_stats_free(unsigned int stats_size, struct safeword_tag_stats *stats);
+/**
+ * list the tag namespaces in a safeword database
+ *
+ * The namespace of a tag is the part before its first ':', so @a env:prod
+ * and @a env:dev are both in the @a env namespace. Namespaces are folded to
+ * lower case and sorted. Free the result with @link safeword_tags_free
+ * @endlink.
+ *
+ * @param db the safeword database to query
+ * @param namespaces_size number of namespaces in @c namespaces
+ * @param namespaces the namespaces found in the database
+ */
+int safeword_list_namespaces(struct safeword_db *db, unsigned int *namespaces_size, char ***namespaces);
+/**
+ * initialize an arena
+ *
+ * @param arena the arena to initialize
+ * @param size number of bytes to reserve up front, zero to reserve on first
+ * use
+ *
+ * @see safeword_arena_free
+ */
+int safeword_arena_init(struct safeword_arena *arena, size_t size);
+/**
+ * allocate zeroed memory from an arena
+ *
+ * @param arena the arena to allocate from
+ * @param size number of bytes to allocate
+ */
+void *safeword_arena_alloc(struct safeword_arena *arena, size_t size);
+/**
+ * release every allocation made from an arena at once
+ *
+ * The memory is kept for reuse. If the arena had to grow since the last reset
+ * its memory is consolidated into one block of the combined size.
+ *
+ * @param arena the arena to reset
+ */
+void safeword_arena_reset(struct safeword_arena *arena);
+/**
+ * free the memory of an arena
+ *
+ * @param arena the arena to free
+ */
+void safeword_arena_free(struct safeword_arena *arena);
+/**
+ * open a cursor over the credential specified by @c credential_id
+ *
+ * The cursor has a single row, or none if the credential does not exist. The
+ * @c SAFEWORD_FIELD_USERNAME, @c SAFEWORD_FIELD_PASSWORD and @c
+ * SAFEWORD_FIELD_DESCRIPTION fields can be read from it.
+ *
+ * @param db the database to query
+ * @param cursor the cursor to open
+ * @param credential_id the id of the credential to read
+ *
+ * @see safeword_cursor_next, safeword_cursor_text, safeword_cursor_close
+ */
+int safeword_cursor_credential(struct safeword_db *db, struct safeword_cursor *cursor, long int credential_id);
+/**
+ * open a cursor over some of the fields of the credential specified by @c
+ * credential_id
+ *
+ * Behaves like @link safeword_cursor_credential @endlink except that only
+ * the fields in @c fields are selected; reading any other field returns
+ * NULL. @c SAFEWORD_FIELD_TAGS is ignored, see @link
+ * safeword_cursor_credential_tags @endlink.
+ *
+ * @param fields a mask of the SAFEWORD_FIELD_* values to select
+ *
+ * @see safeword_cursor_next, safeword_cursor_text, safeword_cursor_close
+ */
+int safeword_cursor_credential_fields(struct safeword_db *db, struct safeword_cursor *cursor,
+	long int credential_id, int fields);
+/**
+ * open a cursor over the tags of the credential specified by @c credential_id
+ *
+ * Each row provides the @c SAFEWORD_FIELD_TAGS field.
+ *
+ * @see safeword_cursor_next, safeword_cursor_text, safeword_cursor_close
+ */
+int safeword_cursor_credential_tags(struct safeword_db *db, struct safeword_cursor *cursor, long int credential_id);
+/**
+ * open a cursor over the tags in a safeword database
+ *
+ * Selects the same tags as @link safeword_list_tags @endlink. Each row
+ * provides the @c SAFEWORD_FIELD_TAGS field.
+ *
+ * @see safeword_cursor_next, safeword_cursor_text, safeword_cursor_close
+ */
+int safeword_cursor_tags(struct safeword_db *db, struct safeword_cursor *cursor,
+	unsigned int filter_size, const char **filter);
+/**
+ * advance a cursor to its next row
+ *
+ * @return 1 if the cursor is on a row, 0 if there are no more rows, -1 on
+ * error
+ */
+int safeword_cursor_next(struct safeword_cursor *cursor);
+/**
+ * id of the credential or tag of the current row
+ */
+long int safeword_cursor_id(struct safeword_cursor *cursor);
+/**
+ * text of a field in the current row without copying it
+ *
+ * The returned text is NUL terminated and remains valid until the cursor
+ * advances or is closed.
+ *
+ * @param cursor the cursor to read
+ * @param field one of the @c SAFEWORD_FIELD_* values
+ * @param size if not @c NULL, set to the length of the text in bytes
+ *
+ * @return the text, or @c NULL if the field is NULL or not selected
+ */
+const char *safeword_cursor_text(struct safeword_cursor *cursor, int field, size_t *size);
+/**
+ * close a cursor
+ *
+ * @param cursor the cursor to close
+ */
+int safeword_cursor_close(struct safeword_cursor *cursor);
 /**
  * list credentials in a safeword database
  *
@@ -314,7 +920,8 @@ int safeword_list_tags(struct safeword_db *db, unsigned int *tags_size, char ***
  * number of credentials in the array.
  *
  * If @c tags_size is zero or @c tags is @c NULL then @c credentials will
- * contain all credentials within the database.
+ * contain all credentials within the database. A tag ending in '*' or ':'
+ * matches any tag starting with it, case-insensitively.
  *
  * @param db the safeword database to query
  * @param tags_size number of tags in @c tags
@@ -325,6 +932,291 @@ int safeword_list_tags(struct safeword_db *db, unsigned int *tags_size, char ***
  * @see safeword_credential_free, safeword_credential_read
  */
 int safeword_list_credentials(struct safeword_db *db, unsigned int tags_size, char **tags);
+/**
+ * iterate credentials in a safeword database
+ *
+ * Selects credentials the same way as @link safeword_list_credentials
+ * @endlink, but instead of printing them @c callback is invoked with the @a id
+ * and @a description of each credential.
+ *
+ * @param db the safeword database to query
+ * @param tags_size number of tags in @c tags
+ * @param tags the tags to filter credentials by
+ * @param callback called for each credential found
+ * @param arg passed through to @c callback
+ *
+ * @see safeword_list_credentials
+ */
+int safeword_list_credentials_foreach(struct safeword_db *db, unsigned int tags_size, char **tags,
+	safeword_credential_callback callback, void *arg);
+/**
+ * iterate one page of credentials in a safeword database
+ *
+ * Selects credentials the same way as @link safeword_list_credentials
+ * @endlink, ordered and bounded by @c options. Pages are found with an index
+ * seek past the previous page rather than by skipping rows, so every page
+ * costs the same however far into the list it is.
+ *
+ * @param db the safeword database to query
+ * @param tags_size number of tags in @c tags
+ * @param tags the tags to filter credentials by
+ * @param options the page to list, @c NULL for every credential by id
+ * @param callback called for each credential found
+ * @param arg passed through to @c callback
+ *
+ * @see safeword_list_credentials_foreach
+ */
+int safeword_list_credentials_page(struct safeword_db *db, unsigned int tags_size, char **tags,
+	const struct safeword_list_options *options, safeword_credential_callback callback, void *arg);
+/**
+ * iterate the most recently used credentials in a safeword database
+ *
+ * Credentials are passed to @c callback most recently used first, only the
+ * @c id and @c description are set. Accesses not yet written by @link
+ * safeword_flush_accesses @endlink are not taken into account.
+ *
+ * @param db the safeword database to query
+ * @param limit maximum number of credentials, 0 for every used credential
+ * @param callback called for each credential found
+ * @param arg passed through to @c callback
+ */
+int safeword_list_recent(struct safeword_db *db, unsigned int limit,
+	safeword_credential_callback callback, void *arg);
+/**
+ * iterate the changes made to a safeword database after @c since
+ *
+ * Every insert, update and delete of a credential, tag or tagging is logged
+ * with a sequence number that only grows. A reader keeps the last @c seq it
+ * processed and passes it back to read only what changed since; one that
+ * starts out reads the vault in full, having taken @link
+ * safeword_changes_last @endlink first. Changes are passed oldest first.
+ *
+ * @param db the safeword database to query
+ * @param since the last sequence number already processed, 0 for all
+ * @param limit maximum number of changes, 0 for every change
+ * @param callback called for each change
+ * @param arg passed through to @c callback
+ * @return 0 on success, -1 on failure; @a ESAFEWORD_COMPACTED if changes
+ *         after @c since were compacted, the reader has to start over
+ */
+int safeword_changes(struct safeword_db *db, long long since, unsigned int limit,
+	safeword_change_callback callback, void *arg);
+/**
+ * get the sequence number of the latest change, 0 if there is none
+ *
+ * @param db the safeword database to query
+ * @return the sequence number or -1 on failure
+ */
+long long safeword_changes_last(struct safeword_db *db);
+/**
+ * drop the changes up to and including @c seq from the change log
+ *
+ * Readers that have not processed them get @a ESAFEWORD_COMPACTED from
+ * @link safeword_changes @endlink rather than missing them silently.
+ *
+ * @param db the safeword database
+ * @param seq the last sequence number to drop
+ * @return the number of changes dropped or -1 on failure
+ */
+int safeword_changes_compact(struct safeword_db *db, long long seq);
+/**
+ * find credentials sharing a username or a password
+ *
+ * Usernames and passwords are stored once however many credentials use
+ * them, so credentials sharing one have the same id for it and a group is
+ * one range of an index. Usernames are audited before passwords, each
+ * group is passed in order of the shared value's id.
+ *
+ * @param db the safeword database to query
+ * @param fields @a SAFEWORD_REUSE_USERNAME, @a SAFEWORD_REUSE_PASSWORD or both
+ * @param callback called for each group of two or more credentials
+ * @param arg passed through to @c callback
+ * @return 0 on success, -1 on failure
+ */
+int safeword_audit_reuse(struct safeword_db *db, int fields,
+	safeword_reuse_callback callback, void *arg);
+
+enum safeword_request_type {
+	SAFEWORD_REQUEST_READ,             /* safeword_credential_read */
+	SAFEWORD_REQUEST_LIST_TAGS,        /* safeword_list_tags */
+	SAFEWORD_REQUEST_LIST_CREDENTIALS, /* safeword_list_credentials_foreach */
+	SAFEWORD_REQUEST_ADD,              /* safeword_credential_add */
+	SAFEWORD_REQUEST_UPDATE,           /* safeword_credential_update */
+	SAFEWORD_REQUEST_TAG,              /* safeword_credential_tag */
+	SAFEWORD_REQUEST_UNTAG,            /* safeword_credential_untag */
+};
+
+struct safeword_request;
+typedef void (*safeword_completion)(struct safeword_request *request, void *arg);
+
+/**
+ * an operation to be executed by the async worker
+ *
+ * The caller owns the request and everything it points to until the request
+ * has completed. Only the members used by @c type need to be set, the rest
+ * of the request is expected to be zeroed.
+ */
+struct safeword_request {
+	enum safeword_request_type type;
+	/* READ, ADD and UPDATE operate on this credential */
+	struct safeword_credential *credential;
+	/* TAG and UNTAG */
+	long int credential_id;
+	const char *tag;
+	/* LIST_TAGS filter, LIST_CREDENTIALS tag filter (see safeword_list_credentials) */
+	unsigned int filter_size;
+	const char **filter;
+	/* LIST_TAGS results, owned by the caller after completion */
+	unsigned int tags_size;
+	char **tags;
+	/* LIST_CREDENTIALS callback, invoked on the worker thread */
+	safeword_credential_callback each;
+	void *each_arg;
+	/* result of the operation and safeword_errno on failure */
+	int status;
+	int error;
+	/* invoked from safeword_async_dispatch or safeword_async_wait */
+	safeword_completion complete;
+	void *arg;
+	/* private to the async worker */
+	int _state;
+	unsigned long _batch;
+	struct safeword_request *_next;
+};
+
+struct safeword_async;
+
+/**
+ * start an async worker for the safeword database specified by @c path
+ *
+ * The worker opens its own connection to the database (see @link
+ * safeword_open @endlink) so @c path may be @c NULL to use the @a
+ * SAFEWORD_DB environment variable.
+ *
+ * @param path the safeword database file to be used by the worker
+ *
+ * @see safeword_async_destroy
+ */
+struct safeword_async *safeword_async_create(const char *path);
+/**
+ * stop an async worker
+ *
+ * Requests that have not started are canceled and completions that have not
+ * been dispatched are dispatched before the worker is freed.
+ *
+ * @param async the worker created by @link safeword_async_create @endlink
+ */
+int safeword_async_destroy(struct safeword_async *async);
+/**
+ * queue requests to be executed by the worker
+ *
+ * The @c requests_size requests are executed in order as one batch. Batches
+ * containing modifications run in a single transaction, each request guarded
+ * by a savepoint so a failing request does not undo the others.
+ *
+ * @param async the worker to queue the requests on
+ * @param requests an array of requests
+ * @param requests_size number of requests in @c requests
+ *
+ * @see safeword_async_cancel, safeword_async_dispatch
+ */
+int safeword_async_submit(struct safeword_async *async, struct safeword_request *requests,
+	unsigned int requests_size);
+/**
+ * cancel a queued request
+ *
+ * A request that has not started is completed with @a status -1 and @a error
+ * @c ESAFEWORD_CANCELED. Requests that already started cannot be canceled.
+ *
+ * @return 0 if @c request was canceled, otherwise -1
+ */
+int safeword_async_cancel(struct safeword_async *async, struct safeword_request *request);
+/**
+ * file descriptor that becomes readable when completions are pending
+ *
+ * Intended to be added to the caller's poll/select loop. Once readable call
+ * @link safeword_async_dispatch @endlink.
+ */
+int safeword_async_fd(struct safeword_async *async);
+/**
+ * invoke the completion callbacks of all finished requests
+ *
+ * Callbacks are invoked on the calling thread. Requests are no longer
+ * referenced by the worker once their callback is invoked.
+ *
+ * @return the number of completions dispatched
+ */
+int safeword_async_dispatch(struct safeword_async *async);
+/**
+ * block until @c request has completed
+ *
+ * The completion callback of @c request, if any, is invoked before returning.
+ * Waiting on a request that was never submitted fails with @c
+ * ESAFEWORD_INVARG.
+ *
+ * @return the @a status of @c request
+ */
+int safeword_async_wait(struct safeword_async *async, struct safeword_request *request);
+
+/* nonzero while a trace is being written, checked before taking timestamps */
+extern int safeword_trace_enabled;
+
+/**
+ * start writing a latency trace
+ *
+ * Spans are written as a Chrome trace-event JSON array, viewable in
+ * chrome://tracing or Perfetto, or one JSON object per line when @c path ends
+ * in ".jsonl". A @c path of "-" writes to stderr. SQL statements of
+ * connections opened afterwards are traced with their text normalized, so
+ * literals never reach the trace.
+ *
+ * @param path the trace file, @c NULL or empty to leave tracing disabled
+ *
+ * @see safeword_trace_close
+ */
+int safeword_trace_open(const char *path);
+/**
+ * finish the trace started by @link safeword_trace_open @endlink
+ */
+int safeword_trace_close(void);
+/**
+ * microseconds on a monotonic clock, the start of a span
+ */
+long long safeword_trace_now(void);
+/**
+ * write a span from @c start until now
+ *
+ * Does nothing unless tracing is enabled; callers avoid taking @c start with
+ * @code if (safeword_trace_enabled) @endcode.
+ *
+ * @param category groups related spans, such as "db" or "x11"
+ * @param name the name shown for the span
+ * @param start the start of the span, from @link safeword_trace_now @endlink
+ * @param detail free text stored with the span, may be @c NULL
+ * @param count a number stored with the span, omitted if negative
+ */
+void safeword_trace_span(const char *category, const char *name, long long start,
+	const char *detail, long int count);
+/**
+ * trace the SQL statements run on @c handle, if tracing or explaining is enabled
+ */
+void safeword_trace_db(sqlite3 *handle);
+/**
+ * print the query plan of every statement run on a safeword database
+ *
+ * Affects connections opened afterwards. The statements run on a connection
+ * are collected and their EXPLAIN QUERY PLAN printed to stderr when it is
+ * closed, each once, with full table scans and temporary B-trees flagged.
+ *
+ * @param enable nonzero to explain statements, 0 to stop
+ */
+void safeword_explain(int enable);
+/**
+ * print the query plans collected for @c handle and forget them
+ *
+ * Called by @link safeword_close @endlink before the connection is closed.
+ */
+void safeword_explain_db(sqlite3 *handle);
 
 #endif // SAFEWORD_H
 /** @} */
@@ -0,0 +1,486 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+#include "dbg.h"
+#include "safeword.h"
+
+/* the worker writes the accesses it read once this many are pending... */
+#define ACCESSES_FLUSH_SIZE 256
+/* ...or once this many seconds passed since it last wrote them */
+#define ACCESSES_FLUSH_SECONDS 30
+
+/* a zeroed request has not been submitted */
+enum request_state {
+	REQUEST_UNSUBMITTED = 0,
+	REQUEST_QUEUED,
+	REQUEST_RUNNING,
+	REQUEST_DONE,
+	REQUEST_DISPATCHED,
+};
+
+struct safeword_async {
+	struct safeword_db db;
+	pthread_t worker;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int stopping;
+	unsigned long batches;
+	/* requests waiting to be executed */
+	struct safeword_request *queue_head;
+	struct safeword_request *queue_tail;
+	/* requests waiting to be dispatched */
+	struct safeword_request *done_head;
+	struct safeword_request *done_tail;
+	/* fd[0] is polled by the caller, fd[1] is written by the worker */
+	int fd[2];
+	/* when the worker last wrote its pending accesses */
+	time_t flushed;
+};
+
+/* #region safeword async notification */
+
+static int notify_open(struct safeword_async *async)
+{
+#if defined(__linux__)
+	async->fd[0] = async->fd[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	return async->fd[0] == -1 ? -1 : 0;
+#elif defined(WIN32)
+	async->fd[0] = async->fd[1] = -1;
+	return 0;
+#else
+	int i;
+
+	if (pipe(async->fd))
+		return -1;
+	for (i = 0; i < 2; i++) {
+		fcntl(async->fd[i], F_SETFL, fcntl(async->fd[i], F_GETFL) | O_NONBLOCK);
+		fcntl(async->fd[i], F_SETFD, FD_CLOEXEC);
+	}
+	return 0;
+#endif
+}
+
+static void notify_close(struct safeword_async *async)
+{
+#ifndef WIN32
+	close(async->fd[0]);
+	if (async->fd[1] != async->fd[0])
+		close(async->fd[1]);
+#endif
+}
+
+/* must be called with the lock held */
+static void notify(struct safeword_async *async)
+{
+#if defined(__linux__)
+	eventfd_write(async->fd[1], 1);
+#elif !defined(WIN32)
+	char c = 0;
+	if (write(async->fd[1], &c, 1) < 0)
+		debug("failed to signal async completion");
+#endif
+	pthread_cond_broadcast(&async->cond);
+}
+
+/* must be called with the lock held */
+static void notify_drain(struct safeword_async *async)
+{
+#if defined(__linux__)
+	eventfd_t value;
+	eventfd_read(async->fd[0], &value);
+#elif !defined(WIN32)
+	char buffer[64];
+	while (read(async->fd[0], buffer, sizeof(buffer)) > 0);
+#endif
+}
+
+/* #endregion safeword async notification */
+
+/* #region safeword async queues */
+
+/* must be called with the lock held */
+static void push_done(struct safeword_async *async, struct safeword_request *request)
+{
+	request->_state = REQUEST_DONE;
+	request->_next = NULL;
+	if (async->done_tail)
+		async->done_tail->_next = request;
+	else
+		async->done_head = request;
+	async->done_tail = request;
+	notify(async);
+}
+
+/* must be called with the lock held */
+static int unlink_request(struct safeword_request **head, struct safeword_request **tail,
+	struct safeword_request *request)
+{
+	struct safeword_request *prev = NULL, *cur;
+
+	for (cur = *head; cur; prev = cur, cur = cur->_next) {
+		if (cur != request)
+			continue;
+		if (prev)
+			prev->_next = cur->_next;
+		else
+			*head = cur->_next;
+		if (*tail == cur)
+			*tail = prev;
+		cur->_next = NULL;
+		return 0;
+	}
+	return -1;
+}
+
+/* must be called with the lock held */
+static void cancel_request(struct safeword_async *async, struct safeword_request *request)
+{
+	request->status = -1;
+	request->error = ESAFEWORD_CANCELED;
+	push_done(async, request);
+}
+
+/* #endregion safeword async queues */
+
+/* #region safeword async worker */
+
+static int is_modification(struct safeword_request *request)
+{
+	switch (request->type) {
+	case SAFEWORD_REQUEST_ADD:
+	case SAFEWORD_REQUEST_UPDATE:
+	case SAFEWORD_REQUEST_TAG:
+	case SAFEWORD_REQUEST_UNTAG:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static void execute_request(struct safeword_db *db, struct safeword_request *request)
+{
+	int ret;
+
+	safeword_errno = 0;
+
+	switch (request->type) {
+	case SAFEWORD_REQUEST_READ:
+		ret = safeword_credential_read(db, request->credential);
+		break;
+	case SAFEWORD_REQUEST_LIST_TAGS:
+		request->tags_size = 0;
+		request->tags = NULL;
+		ret = safeword_list_tags(db, &request->tags_size, &request->tags,
+			request->filter_size, request->filter);
+		break;
+	case SAFEWORD_REQUEST_LIST_CREDENTIALS:
+		ret = safeword_list_credentials_foreach(db, request->filter_size, (char**) request->filter,
+			request->each, request->each_arg);
+		break;
+	case SAFEWORD_REQUEST_ADD:
+		ret = safeword_credential_add(db, request->credential);
+		break;
+	case SAFEWORD_REQUEST_UPDATE:
+		ret = safeword_credential_update(db, request->credential);
+		break;
+	case SAFEWORD_REQUEST_TAG:
+		ret = safeword_credential_tag(db, request->credential_id, request->tag);
+		break;
+	case SAFEWORD_REQUEST_UNTAG:
+		ret = safeword_credential_untag(db, request->credential_id, request->tag);
+		break;
+	default:
+		safeword_errno = ESAFEWORD_INVARG;
+		ret = -1;
+		break;
+	}
+
+	request->status = ret ? -1 : 0;
+	request->error = ret ? (safeword_errno ? safeword_errno : ESAFEWORD_BACKENDSTORAGE) : 0;
+}
+
+static void execute_batch(struct safeword_async *async)
+{
+	int transaction = 0;
+	unsigned long batch = async->queue_head->_batch;
+	struct safeword_request *request, *completed = NULL, *completed_tail = NULL;
+
+	for (request = async->queue_head; request && request->_batch == batch; request = request->_next)
+		transaction |= is_modification(request);
+
+	pthread_mutex_unlock(&async->lock);
+	if (transaction && sqlite3_exec(async->db.handle, "BEGIN;", 0, 0, 0) != SQLITE_OK)
+		transaction = 0;
+	pthread_mutex_lock(&async->lock);
+
+	/* requests of this batch may be canceled while earlier ones execute */
+	while (async->queue_head && async->queue_head->_batch == batch) {
+		request = async->queue_head;
+		unlink_request(&async->queue_head, &async->queue_tail, request);
+		request->_state = REQUEST_RUNNING;
+		pthread_mutex_unlock(&async->lock);
+
+		if (transaction && is_modification(request)) {
+			sqlite3_exec(async->db.handle, "SAVEPOINT request;", 0, 0, 0);
+			execute_request(&async->db, request);
+			if (request->status)
+				sqlite3_exec(async->db.handle, "ROLLBACK TO request;", 0, 0, 0);
+			sqlite3_exec(async->db.handle, "RELEASE request;", 0, 0, 0);
+		} else {
+			execute_request(&async->db, request);
+		}
+
+		if (completed_tail)
+			completed_tail->_next = request;
+		else
+			completed = request;
+		completed_tail = request;
+
+		pthread_mutex_lock(&async->lock);
+	}
+	pthread_mutex_unlock(&async->lock);
+
+	/* nothing is reported as done before it has been committed */
+	if (transaction && sqlite3_exec(async->db.handle, "COMMIT;", 0, 0, 0) != SQLITE_OK) {
+		sqlite3_exec(async->db.handle, "ROLLBACK;", 0, 0, 0);
+		for (request = completed; request; request = request->_next) {
+			if (!is_modification(request) || request->status)
+				continue;
+			request->status = -1;
+			request->error = ESAFEWORD_BACKENDSTORAGE;
+		}
+	}
+
+	/* the worker's connection lives long, write its accesses as it goes */
+	if (async->db.accesses_size >= ACCESSES_FLUSH_SIZE ||
+			(async->db.accesses_size && time(NULL) - async->flushed >= ACCESSES_FLUSH_SECONDS)) {
+		safeword_flush_accesses(&async->db);
+		async->flushed = time(NULL);
+	}
+
+	pthread_mutex_lock(&async->lock);
+	while (completed) {
+		request = completed;
+		completed = request->_next;
+		push_done(async, request);
+	}
+}
+
+static void *worker(void *data)
+{
+	struct safeword_async *async = (struct safeword_async*) data;
+
+	pthread_mutex_lock(&async->lock);
+	while (1) {
+		while (!async->queue_head && !async->stopping)
+			pthread_cond_wait(&async->cond, &async->lock);
+		if (async->stopping)
+			break;
+		execute_batch(async);
+	}
+	pthread_mutex_unlock(&async->lock);
+
+	return NULL;
+}
+
+/* #endregion safeword async worker */
+
+/* #region safeword async functions */
+
+struct safeword_async *safeword_async_create(const char *path)
+{
+	int ret;
+	struct safeword_async *async = calloc(1, sizeof(*async));
+	safeword_check(async != NULL, ESAFEWORD_NOMEM, fail);
+
+	ret = safeword_open(&async->db, path);
+	safeword_check(ret == 0, safeword_errno, fail_open);
+
+	ret = notify_open(async);
+	safeword_check(ret == 0, errno, fail_notify);
+
+	pthread_mutex_init(&async->lock, NULL);
+	pthread_cond_init(&async->cond, NULL);
+	async->flushed = time(NULL);
+
+	ret = pthread_create(&async->worker, NULL, &worker, async);
+	safeword_check(ret == 0, ret, fail_thread);
+
+	return async;
+fail_thread:
+	pthread_cond_destroy(&async->cond);
+	pthread_mutex_destroy(&async->lock);
+	notify_close(async);
+fail_notify:
+	safeword_close(&async->db);
+fail_open:
+	free(async);
+fail:
+	return NULL;
+}
+
+int safeword_async_destroy(struct safeword_async *async)
+{
+	struct safeword_request *request;
+
+	safeword_check(async != NULL, ESAFEWORD_INVARG, fail);
+
+	pthread_mutex_lock(&async->lock);
+	async->stopping = 1;
+	while ((request = async->queue_head)) {
+		unlink_request(&async->queue_head, &async->queue_tail, request);
+		cancel_request(async, request);
+	}
+	pthread_cond_broadcast(&async->cond);
+	pthread_mutex_unlock(&async->lock);
+
+	pthread_join(async->worker, NULL);
+	safeword_async_dispatch(async);
+
+	pthread_cond_destroy(&async->cond);
+	pthread_mutex_destroy(&async->lock);
+	notify_close(async);
+	safeword_close(&async->db);
+	free(async);
+
+	return 0;
+fail:
+	return -1;
+}
+
+int safeword_async_submit(struct safeword_async *async, struct safeword_request *requests,
+	unsigned int requests_size)
+{
+	int i;
+
+	safeword_check(async != NULL, ESAFEWORD_INVARG, fail);
+	safeword_check(requests != NULL, ESAFEWORD_INVARG, fail);
+
+	pthread_mutex_lock(&async->lock);
+	if (async->stopping) {
+		pthread_mutex_unlock(&async->lock);
+		safeword_errno = ESAFEWORD_CANCELED;
+		goto fail;
+	}
+
+	async->batches++;
+	for (i = 0; i < requests_size; i++) {
+		requests[i].status = 0;
+		requests[i].error = 0;
+		requests[i]._state = REQUEST_QUEUED;
+		requests[i]._batch = async->batches;
+		requests[i]._next = NULL;
+		if (async->queue_tail)
+			async->queue_tail->_next = &requests[i];
+		else
+			async->queue_head = &requests[i];
+		async->queue_tail = &requests[i];
+	}
+	pthread_cond_broadcast(&async->cond);
+	pthread_mutex_unlock(&async->lock);
+
+	return 0;
+fail:
+	return -1;
+}
+
+int safeword_async_cancel(struct safeword_async *async, struct safeword_request *request)
+{
+	int ret;
+
+	safeword_check(async != NULL, ESAFEWORD_INVARG, fail);
+	safeword_check(request != NULL, ESAFEWORD_INVARG, fail);
+
+	pthread_mutex_lock(&async->lock);
+	ret = request->_state == REQUEST_QUEUED ?
+		unlink_request(&async->queue_head, &async->queue_tail, request) : -1;
+	if (!ret)
+		cancel_request(async, request);
+	pthread_mutex_unlock(&async->lock);
+
+	return ret;
+fail:
+	return -1;
+}
+
+int safeword_async_fd(struct safeword_async *async)
+{
+	safeword_check(async != NULL, ESAFEWORD_INVARG, fail);
+
+	return async->fd[0];
+fail:
+	return -1;
+}
+
+int safeword_async_dispatch(struct safeword_async *async)
+{
+	int count = 0;
+	struct safeword_request *request, *next;
+
+	safeword_check(async != NULL, ESAFEWORD_INVARG, fail);
+
+	pthread_mutex_lock(&async->lock);
+	notify_drain(async);
+	request = async->done_head;
+	async->done_head = async->done_tail = NULL;
+	for (next = request; next; next = next->_next)
+		next->_state = REQUEST_DISPATCHED;
+	pthread_mutex_unlock(&async->lock);
+
+	for (; request; request = next) {
+		/* the callback may free the request */
+		next = request->_next;
+		request->_next = NULL;
+		if (request->complete)
+			request->complete(request, request->arg);
+		count++;
+	}
+
+	return count;
+fail:
+	return -1;
+}
+
+int safeword_async_wait(struct safeword_async *async, struct safeword_request *request)
+{
+	int dispatch, status;
+
+	safeword_check(async != NULL, ESAFEWORD_INVARG, fail);
+	safeword_check(request != NULL, ESAFEWORD_INVARG, fail);
+
+	pthread_mutex_lock(&async->lock);
+	if (request->_state == REQUEST_UNSUBMITTED) {
+		/* nothing would ever complete it */
+		pthread_mutex_unlock(&async->lock);
+		safeword_errno = ESAFEWORD_INVARG;
+		goto fail;
+	}
+	while (request->_state == REQUEST_QUEUED || request->_state == REQUEST_RUNNING)
+		pthread_cond_wait(&async->cond, &async->lock);
+	dispatch = request->_state == REQUEST_DONE;
+	if (dispatch) {
+		unlink_request(&async->done_head, &async->done_tail, request);
+		request->_state = REQUEST_DISPATCHED;
+	}
+	status = request->status;
+	pthread_mutex_unlock(&async->lock);
+
+	/* the callback may free the request */
+	if (dispatch && request->complete)
+		request->complete(request, request->arg);
+
+	return status;
+fail:
+	return -1;
+}
+
+/* #endregion safeword async functions */
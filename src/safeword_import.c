@@ -0,0 +1,431 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "dbg.h"
+#include "safeword.h"
+
+/*
+ * Imports are read a record at a time by a streaming RFC 4180 parser, so an
+ * export of any size is read once and never held in memory. The fields of a
+ * record are kept in one buffer, each terminated, which grows to the largest
+ * record read. Records are added in transactions of SAFEWORD_IMPORT_BATCH so
+ * the vault is not synced to disk once per credential.
+ */
+
+/* #region csv parser */
+
+struct csv_reader {
+	FILE *in;
+	/* the fields of the current record, each terminated */
+	char *buf;
+	size_t buf_size;
+	size_t buf_used;
+	/* offsets of the fields in buf */
+	size_t *fields;
+	unsigned int fields_size;
+	unsigned int fields_used;
+	/* the line read last and the line the current record starts on */
+	unsigned int line;
+	unsigned int record_line;
+	/* bytes put back, read again last first; getc only takes one back */
+	int pending[3];
+	unsigned int pending_size;
+};
+
+static int csv_getc(struct csv_reader *csv)
+{
+	if (csv->pending_size)
+		return csv->pending[--csv->pending_size];
+	return getc(csv->in);
+}
+
+static void csv_ungetc(struct csv_reader *csv, int c)
+{
+	if (c != EOF && csv->pending_size < sizeof(csv->pending) / sizeof(csv->pending[0]))
+		csv->pending[csv->pending_size++] = c;
+}
+
+static int csv_putc(struct csv_reader *csv, char c)
+{
+	char *buf;
+
+	if (csv->buf_used == csv->buf_size) {
+		buf = realloc(csv->buf, csv->buf_size ? csv->buf_size * 2 : 256);
+		safeword_check(buf != NULL, ESAFEWORD_NOMEM, fail);
+		csv->buf = buf;
+		csv->buf_size = csv->buf_size ? csv->buf_size * 2 : 256;
+	}
+	csv->buf[csv->buf_used++] = c;
+
+	return 0;
+fail:
+	return -1;
+}
+
+static int csv_start_field(struct csv_reader *csv)
+{
+	size_t *fields;
+
+	if (csv->fields_used == csv->fields_size) {
+		fields = realloc(csv->fields, (csv->fields_size ? csv->fields_size * 2 : 16) * sizeof(*fields));
+		safeword_check(fields != NULL, ESAFEWORD_NOMEM, fail);
+		csv->fields = fields;
+		csv->fields_size = csv->fields_size ? csv->fields_size * 2 : 16;
+	}
+	csv->fields[csv->fields_used++] = csv->buf_used;
+
+	return 0;
+fail:
+	return -1;
+}
+
+static const char *csv_field(const struct csv_reader *csv, int i)
+{
+	if (i < 0 || (unsigned int) i >= csv->fields_used)
+		return "";
+	return csv->buf + csv->fields[i];
+}
+
+/*
+ * Read the next record, skipping blank lines. Returns 1 if a record was
+ * read, 0 at the end of the input and -1 on failure. A quoted field may
+ * hold commas, line breaks and quotes written twice; a quote inside an
+ * unquoted field is taken as is.
+ */
+static int csv_read(struct csv_reader *csv)
+{
+	int c, quoted = 0;
+
+	do {
+		csv->buf_used = 0;
+		csv->fields_used = 0;
+
+		c = csv_getc(csv);
+		if (c == EOF) {
+			safeword_check(!ferror(csv->in), ESAFEWORD_FORMAT, fail);
+			return 0;
+		}
+		csv->line++;
+		if (c == '\r')
+			c = csv_getc(csv);
+	} while (c == '\n');
+	csv->record_line = csv->line;
+
+	if (csv_start_field(csv))
+		return -1;
+	for (;; c = csv_getc(csv)) {
+		if (quoted) {
+			if (c == EOF) {
+				safeword_check(0, ESAFEWORD_FORMAT, fail);
+			} else if (c == '"') {
+				c = csv_getc(csv);
+				if (c != '"') {
+					quoted = 0;
+					csv_ungetc(csv, c);
+					continue;
+				}
+			} else if (c == '\n') {
+				csv->line++;
+			}
+			if (csv_putc(csv, c))
+				return -1;
+			continue;
+		}
+
+		if (c == '"' && csv->buf_used == csv->fields[csv->fields_used - 1]) {
+			quoted = 1;
+		} else if (c == ',') {
+			if (csv_putc(csv, '\0') || csv_start_field(csv))
+				return -1;
+		} else if (c == '\n' || c == EOF) {
+			break;
+		} else if (c == '\r') {
+			/* a lone carriage return is part of the field */
+			c = csv_getc(csv);
+			csv_ungetc(csv, c);
+			if (c != '\n' && csv_putc(csv, '\r'))
+				return -1;
+		} else if (csv_putc(csv, c)) {
+			return -1;
+		}
+	}
+	safeword_check(!ferror(csv->in), ESAFEWORD_FORMAT, fail);
+
+	return csv_putc(csv, '\0') ? -1 : 1;
+fail:
+	return -1;
+}
+
+/* #endregion csv parser */
+
+/* #region keepass csv */
+
+enum keepass_column {
+	KEEPASS_TITLE = 0,
+	KEEPASS_USERNAME,
+	KEEPASS_PASSWORD,
+	KEEPASS_GROUP,
+	KEEPASS_COLUMNS,
+};
+
+/* header names of each column, KeePass 1.x and 2.x first, then KeePassX */
+static const char *keepass_headers[KEEPASS_COLUMNS][3] = {
+	[KEEPASS_TITLE] = { "Account", "Title", NULL },
+	[KEEPASS_USERNAME] = { "Login Name", "Username", "User Name" },
+	[KEEPASS_PASSWORD] = { "Password", NULL, NULL },
+	[KEEPASS_GROUP] = { "Group", "Group Tree", NULL },
+};
+
+static int keepass_columns(const struct csv_reader *csv, int *columns)
+{
+	unsigned int i, j, k;
+
+	for (i = 0; i < KEEPASS_COLUMNS; i++)
+		columns[i] = -1;
+	for (i = 0; i < csv->fields_used; i++) {
+		for (j = 0; j < KEEPASS_COLUMNS; j++) {
+			for (k = 0; k < 3 && keepass_headers[j][k]; k++) {
+				if (columns[j] == -1 && !strcasecmp(csv_field(csv, i), keepass_headers[j][k]))
+					columns[j] = i;
+			}
+		}
+	}
+	/* without a title nor username there is nothing to tell records apart by */
+	safeword_check(columns[KEEPASS_TITLE] != -1 || columns[KEEPASS_USERNAME] != -1,
+		ESAFEWORD_FORMAT, fail);
+
+	return 0;
+fail:
+	return -1;
+}
+
+/* #endregion keepass csv */
+
+/* #region import statements */
+
+/*
+ * The library functions prepare their statements per call, which also
+ * compiles the triggers on the table written; an import prepares them once.
+ */
+
+enum import_stmt {
+	IMPORT_USERNAME_ADD = 0,
+	IMPORT_USERNAME_ID,
+	IMPORT_PASSWORD_ADD,
+	IMPORT_PASSWORD_ID,
+	IMPORT_CREDENTIAL_ADD,
+	IMPORT_TAG_ADD,
+	IMPORT_TAG_ID,
+	IMPORT_TAG_MAP,
+	IMPORT_STMTS,
+};
+
+static const char *import_sql[IMPORT_STMTS] = {
+	[IMPORT_USERNAME_ADD] = "INSERT OR IGNORE INTO usernames (username) VALUES (?);",
+	[IMPORT_USERNAME_ID] = "SELECT id FROM usernames WHERE username = ?;",
+	[IMPORT_PASSWORD_ADD] = "INSERT OR IGNORE INTO passwords (password) VALUES (?);",
+	[IMPORT_PASSWORD_ID] = "SELECT id FROM passwords WHERE password = ?;",
+	[IMPORT_CREDENTIAL_ADD] = "INSERT INTO credentials (usernameid, passwordid, description) "
+		"VALUES (?, ?, ?);",
+	[IMPORT_TAG_ADD] = "INSERT OR IGNORE INTO tags (tag) VALUES (?);",
+	[IMPORT_TAG_ID] = "SELECT id FROM tags WHERE tag = ?;",
+	/* REPLACE would count an existing mapping again in tag_stats */
+	[IMPORT_TAG_MAP] = "INSERT OR IGNORE INTO tagged_credentials (credentialid, tagid) VALUES (?, ?);",
+};
+
+/* step @c stmt, which writes or selects at most one row, and reset it */
+static int import_step(sqlite3_stmt *stmt, sqlite3_int64 *id)
+{
+	int ret;
+
+	ret = sqlite3_step(stmt);
+	if (ret == SQLITE_ROW && id)
+		*id = sqlite3_column_int64(stmt, 0);
+	sqlite3_reset(stmt);
+	safeword_check(ret == SQLITE_DONE || (ret == SQLITE_ROW && id), ESAFEWORD_BACKENDSTORAGE, fail);
+
+	return 0;
+fail:
+	return -1;
+}
+
+/* get the id of @c value, adding it through @c add if it is new */
+static int import_value(sqlite3_stmt *add, sqlite3_stmt *select, const char *value, sqlite3_int64 *id)
+{
+	int ret;
+
+	ret = sqlite3_bind_text(add, 1, value, -1, SQLITE_STATIC);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+	if (import_step(add, NULL))
+		goto fail;
+	ret = sqlite3_bind_text(select, 1, value, -1, SQLITE_STATIC);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+
+	return import_step(select, id);
+fail:
+	return -1;
+}
+
+/* add a credential, an empty field is left out rather than stored */
+static int import_credential(sqlite3_stmt **stmts, const char *username, const char *password,
+	const char *description, sqlite3_int64 *id)
+{
+	int ret;
+	sqlite3_int64 value_id;
+	sqlite3_stmt *add = stmts[IMPORT_CREDENTIAL_ADD];
+
+	sqlite3_clear_bindings(add);
+	if (*username) {
+		if (import_value(stmts[IMPORT_USERNAME_ADD], stmts[IMPORT_USERNAME_ID], username, &value_id))
+			goto fail;
+		ret = sqlite3_bind_int64(add, 1, value_id);
+		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+	}
+	if (*password) {
+		if (import_value(stmts[IMPORT_PASSWORD_ADD], stmts[IMPORT_PASSWORD_ID], password, &value_id))
+			goto fail;
+		ret = sqlite3_bind_int64(add, 2, value_id);
+		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+	}
+	if (*description) {
+		ret = sqlite3_bind_text(add, 3, description, -1, SQLITE_STATIC);
+		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+	}
+	if (import_step(add, NULL))
+		goto fail;
+	*id = sqlite3_last_insert_rowid(sqlite3_db_handle(add));
+
+	return 0;
+fail:
+	return -1;
+}
+
+/* tag @c id with every group on the path @c group, such as "Internet/Email" */
+static int import_tags(sqlite3_stmt **stmts, sqlite3_int64 id, char *group)
+{
+	int ret;
+	char *tag, *save = NULL;
+	sqlite3_int64 tag_id;
+	sqlite3_stmt *map = stmts[IMPORT_TAG_MAP];
+
+	for (tag = strtok_r(group, "/", &save); tag; tag = strtok_r(NULL, "/", &save)) {
+		if (import_value(stmts[IMPORT_TAG_ADD], stmts[IMPORT_TAG_ID], tag, &tag_id))
+			goto fail;
+		ret = sqlite3_bind_int64(map, 1, id);
+		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+		ret = sqlite3_bind_int64(map, 2, tag_id);
+		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+		if (import_step(map, NULL))
+			goto fail;
+	}
+
+	return 0;
+fail:
+	return -1;
+}
+
+/* #endregion import statements */
+
+/* #region keepass csv import */
+
+static int keepass_import(struct safeword_db *db, struct csv_reader *csv,
+	struct safeword_import_stats *stats)
+{
+	int i, ret, columns[KEEPASS_COLUMNS];
+	unsigned int batch = 0;
+	sqlite3_int64 id;
+	sqlite3_stmt *stmts[IMPORT_STMTS] = { NULL };
+
+	ret = csv_read(csv);
+	safeword_check(ret != 0, ESAFEWORD_FORMAT, fail);
+	if (ret < 0 || keepass_columns(csv, columns))
+		goto fail;
+
+	for (i = 0; i < IMPORT_STMTS; i++) {
+		ret = sqlite3_prepare_v2(db->handle, import_sql[i], -1, &stmts[i], NULL);
+		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+	}
+
+	while ((ret = csv_read(csv)) > 0) {
+		if (!batch) {
+			ret = sqlite3_exec(db->handle, "BEGIN;", 0, 0, 0);
+			safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+		}
+
+		if (import_credential(stmts, csv_field(csv, columns[KEEPASS_USERNAME]),
+			csv_field(csv, columns[KEEPASS_PASSWORD]),
+			csv_field(csv, columns[KEEPASS_TITLE]), &id))
+			goto fail_batch;
+		/* the group is split in place, it is the last use of the record */
+		if (columns[KEEPASS_GROUP] != -1 && (unsigned int) columns[KEEPASS_GROUP] < csv->fields_used &&
+			import_tags(stmts, id, csv->buf + csv->fields[columns[KEEPASS_GROUP]]))
+			goto fail_batch;
+
+		if (++batch == SAFEWORD_IMPORT_BATCH) {
+			ret = sqlite3_exec(db->handle, "COMMIT;", 0, 0, 0);
+			safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_batch);
+			stats->imported += batch;
+			batch = 0;
+		}
+	}
+	if (ret < 0)
+		goto fail_batch;
+	if (batch) {
+		ret = sqlite3_exec(db->handle, "COMMIT;", 0, 0, 0);
+		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail_batch);
+		stats->imported += batch;
+	}
+
+	for (i = 0; i < IMPORT_STMTS; i++)
+		sqlite3_finalize(stmts[i]);
+	return 0;
+fail_batch:
+	if (!sqlite3_get_autocommit(db->handle))
+		sqlite3_exec(db->handle, "ROLLBACK;", 0, 0, 0);
+fail:
+	for (i = 0; i < IMPORT_STMTS; i++)
+		sqlite3_finalize(stmts[i]);
+	return -1;
+}
+
+/* #endregion keepass csv import */
+
+int safeword_import(struct safeword_db *db, FILE *in, int format,
+	struct safeword_import_stats *stats)
+{
+	static const int bom_bytes[3] = { 0xEF, 0xBB, 0xBF };
+	int ret, i, bom[3];
+	struct csv_reader csv;
+	struct safeword_import_stats ignored;
+
+	safeword_check(db != NULL, ESAFEWORD_INVARG, fail);
+	safeword_check(in != NULL, ESAFEWORD_INVARG, fail);
+	safeword_check(format == SAFEWORD_IMPORT_KEEPASS_CSV, ESAFEWORD_INVARG, fail);
+
+	if (!stats)
+		stats = &ignored;
+	memset(stats, 0, sizeof(*stats));
+	memset(&csv, 0, sizeof(csv));
+	csv.in = in;
+
+	/* the UTF-8 byte order mark some exporters start with, anything else is kept */
+	for (i = 0; i < 3; i++) {
+		bom[i] = csv_getc(&csv);
+		if (bom[i] != bom_bytes[i])
+			break;
+	}
+	if (i < 3)
+		for (; i >= 0; i--)
+			csv_ungetc(&csv, bom[i]);
+
+	ret = keepass_import(db, &csv, stats);
+	stats->line = csv.record_line;
+
+	free(csv.buf);
+	free(csv.fields);
+	return ret;
+fail:
+	return -1;
+}
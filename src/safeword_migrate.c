@@ -0,0 +1,870 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dbg.h"
+#include "safeword.h"
+
+/*
+ * A migration is an ordered list of steps. A step either runs its statements
+ * once or, when it names a table, runs them once per chunk of that table's
+ * rowids with ?1 and ?2 bound to the (exclusive, inclusive] bounds of the
+ * chunk. Every chunk is committed on its own together with the position
+ * reached, so an interrupted migration resumes where it stopped and other
+ * connections can use the vault in between chunks.
+ *
+ * A SELECT guards the statement after it, which only runs if the SELECT
+ * returns a row. This keeps statements that have to scan a whole table from
+ * doing so for every chunk when there is nothing to do.
+ *
+ * An index cannot be built a chunk at a time, so each index over a table
+ * that may already be large is a step of its own that covers the whole
+ * table. It is committed, and counted in the progress, as one chunk of all
+ * the table's rowids. An interrupted migration resumes with the first index
+ * not yet built, but the build of a single index cannot be interrupted.
+ */
+struct migration_step {
+	const char *table;
+	const char **sql;
+	/* run once over all of table rather than per chunk */
+	int whole;
+};
+
+struct migration {
+	const char *description;
+	const struct migration_step *steps;
+	unsigned int steps_size;
+};
+
+/* #region migration 1: strip stored NUL terminators */
+
+/*
+ * Text used to be bound including its NUL terminator, which made stored
+ * values differ from the same text bound by length.
+ */
+#define NUL_TERMINATED(c) "substr(CAST(" c " AS BLOB), -1) = x'00'"
+#define TRIMMED(c) "CAST(substr(CAST(" c " AS BLOB), 1, length(CAST(" c " AS BLOB)) - 1) AS TEXT)"
+#define IN_CHUNK(c) c " > ?1 AND " c " <= ?2"
+
+/*
+ * Values of a deduplicated table whose trimmed form already exists are
+ * merged into the existing row before the rest are trimmed in place.
+ */
+#define MERGE_VALUES(table, column, ref)                                        \
+	"SELECT 1 FROM " table " AS o WHERE " IN_CHUNK("o.id") " AND "          \
+	NUL_TERMINATED("o." column) " AND EXISTS (SELECT 1 FROM " table " AS k " \
+	"WHERE k." column " = " TRIMMED("o." column) ") LIMIT 1;",              \
+	"UPDATE credentials SET " ref " = (SELECT k.id FROM " table " AS k "     \
+	"WHERE k." column " = (SELECT " TRIMMED("o." column) " FROM " table " AS o " \
+	"WHERE o.id = credentials." ref ")) "                                  \
+	"WHERE " ref " IN (SELECT o.id FROM " table " AS o WHERE " IN_CHUNK("o.id") \
+	" AND " NUL_TERMINATED("o." column) " AND EXISTS (SELECT 1 FROM " table \
+	" AS k WHERE k." column " = " TRIMMED("o." column) "));",               \
+	"DELETE FROM " table " WHERE " IN_CHUNK("id") " AND " NUL_TERMINATED(column) \
+	" AND EXISTS (SELECT 1 FROM " table " AS k WHERE k." column " = "       \
+	TRIMMED(table "." column) ");",                                         \
+	"UPDATE " table " SET " column " = " TRIMMED(column) " WHERE "          \
+	IN_CHUNK("id") " AND " NUL_TERMINATED(column) ";"
+
+static const char *m1_once[] = {
+	"CREATE TABLE IF NOT EXISTS properties (key TEXT PRIMARY KEY NOT NULL, value TEXT);",
+	NULL,
+};
+
+/* lookups by tag and the ON DELETE CASCADE from tags both need this */
+static const char *m1_tagid_index[] = {
+	"CREATE INDEX IF NOT EXISTS tagged_credentials_tagid ON tagged_credentials (tagid);",
+	NULL,
+};
+
+static const char *m1_usernames[] = {
+	MERGE_VALUES("usernames", "username", "usernameid"),
+	NULL,
+};
+
+static const char *m1_passwords[] = {
+	MERGE_VALUES("passwords", "password", "passwordid"),
+	NULL,
+};
+
+static const char *m1_tags[] = {
+	"INSERT OR IGNORE INTO tagged_credentials (credentialid, tagid) "
+		"SELECT tc.credentialid, k.id FROM tags AS o "
+		"INNER JOIN tags AS k ON (k.tag = " TRIMMED("o.tag") ") "
+		"INNER JOIN tagged_credentials AS tc ON (tc.tagid = o.id) "
+		"WHERE " IN_CHUNK("o.id") " AND " NUL_TERMINATED("o.tag") ";",
+	"UPDATE tags SET wiki = (SELECT o.wiki FROM tags AS o WHERE " IN_CHUNK("o.id")
+		" AND " NUL_TERMINATED("o.tag") " AND " TRIMMED("o.tag") " = tags.tag) "
+		"WHERE wiki IS NULL AND tag IN (SELECT " TRIMMED("o.tag") " FROM tags AS o "
+		"WHERE " IN_CHUNK("o.id") " AND " NUL_TERMINATED("o.tag") " AND o.wiki IS NOT NULL);",
+	"DELETE FROM tags WHERE " IN_CHUNK("id") " AND " NUL_TERMINATED("tag")
+		" AND EXISTS (SELECT 1 FROM tags AS k WHERE k.tag = " TRIMMED("tags.tag") ");",
+	"UPDATE tags SET tag = " TRIMMED("tag") " WHERE " IN_CHUNK("id")
+		" AND " NUL_TERMINATED("tag") ";",
+	"UPDATE tags SET wiki = " TRIMMED("wiki") " WHERE " IN_CHUNK("id")
+		" AND " NUL_TERMINATED("wiki") ";",
+	NULL,
+};
+
+static const char *m1_credentials[] = {
+	"UPDATE credentials SET description = " TRIMMED("description") " WHERE "
+		IN_CHUNK("id") " AND " NUL_TERMINATED("description") ";",
+	NULL,
+};
+
+static const struct migration_step m1_steps[] = {
+	{ NULL, m1_once },
+	{ "tagged_credentials", m1_tagid_index, 1 },
+	{ "usernames", m1_usernames },
+	{ "passwords", m1_passwords },
+	{ "tags", m1_tags },
+	{ "credentials", m1_credentials },
+};
+
+/* #endregion migration 1: strip stored NUL terminators */
+
+/* #region migration 2: case-folded tags */
+
+/*
+ * LIKE is case-insensitive and cannot use the index on tags(tag), so tags
+ * are matched against a lower() copy that has an index of its own.
+ */
+static const char *m2_once[] = {
+	"ALTER TABLE tags ADD COLUMN tag_folded TEXT;",
+	"CREATE TRIGGER IF NOT EXISTS tags_fold_insert AFTER INSERT ON tags BEGIN "
+		"UPDATE tags SET tag_folded = lower(NEW.tag) WHERE id = NEW.id; END;",
+	"CREATE TRIGGER IF NOT EXISTS tags_fold_update AFTER UPDATE OF tag ON tags BEGIN "
+		"UPDATE tags SET tag_folded = lower(NEW.tag) WHERE id = NEW.id; END;",
+	NULL,
+};
+
+static const char *m2_tags[] = {
+	"UPDATE tags SET tag_folded = lower(tag) WHERE " IN_CHUNK("id") " AND tag_folded IS NULL;",
+	NULL,
+};
+
+/* built once the copies exist rather than updated with every chunk */
+static const char *m2_index[] = {
+	"CREATE INDEX IF NOT EXISTS tags_tag_folded ON tags (tag_folded);",
+	NULL,
+};
+
+static const struct migration_step m2_steps[] = {
+	{ NULL, m2_once },
+	{ "tags", m2_tags },
+	{ "tags", m2_index, 1 },
+};
+
+/* #endregion migration 2: case-folded tags */
+
+/* #region migration 3: tag statistics */
+
+#define NOW "CAST(strftime('%s', 'now') AS INTEGER)"
+
+/*
+ * Per-tag credential counts, kept exact by triggers so they are read without
+ * joining tagged_credentials. The tag is copied for the same reason.
+ */
+static const char *m3_once[] = {
+	"CREATE TABLE IF NOT EXISTS tag_stats ("
+		"tagid INTEGER PRIMARY KEY, "
+		"tag TEXT NOT NULL, "
+		"count INTEGER NOT NULL DEFAULT 0, "
+		"modified INTEGER"
+		");",
+	"CREATE INDEX IF NOT EXISTS tag_stats_count ON tag_stats (count);",
+	"CREATE TRIGGER IF NOT EXISTS tag_stats_tag_insert AFTER INSERT ON tags BEGIN "
+		"INSERT OR REPLACE INTO tag_stats (tagid, tag, count, modified) "
+		"VALUES (NEW.id, NEW.tag, 0, " NOW "); END;",
+	"CREATE TRIGGER IF NOT EXISTS tag_stats_tag_rename AFTER UPDATE OF tag ON tags BEGIN "
+		"UPDATE tag_stats SET tag = NEW.tag WHERE tagid = NEW.id; END;",
+	"CREATE TRIGGER IF NOT EXISTS tag_stats_tag_delete AFTER DELETE ON tags BEGIN "
+		"DELETE FROM tag_stats WHERE tagid = OLD.id; END;",
+	"CREATE TRIGGER IF NOT EXISTS tag_stats_map AFTER INSERT ON tagged_credentials BEGIN "
+		"UPDATE tag_stats SET count = count + 1, modified = " NOW " WHERE tagid = NEW.tagid; END;",
+	/* also fires for the cascades from deleting a credential or a tag */
+	"CREATE TRIGGER IF NOT EXISTS tag_stats_unmap AFTER DELETE ON tagged_credentials BEGIN "
+		"UPDATE tag_stats SET count = count - 1, modified = " NOW " WHERE tagid = OLD.tagid; END;",
+	"CREATE TRIGGER IF NOT EXISTS tag_stats_remap AFTER UPDATE OF tagid ON tagged_credentials BEGIN "
+		"UPDATE tag_stats SET count = count - 1, modified = " NOW " WHERE tagid = OLD.tagid; "
+		"UPDATE tag_stats SET count = count + 1, modified = " NOW " WHERE tagid = NEW.tagid; END;",
+	NULL,
+};
+
+/* the triggers keep a row exact once it has been counted here */
+static const char *m3_tags[] = {
+	"INSERT OR REPLACE INTO tag_stats (tagid, tag, count, modified) "
+		"SELECT t.id, t.tag, (SELECT count(*) FROM tagged_credentials WHERE tagid = t.id), "
+		"(SELECT modified FROM tag_stats WHERE tagid = t.id) "
+		"FROM tags AS t WHERE " IN_CHUNK("t.id") ";",
+	NULL,
+};
+
+static const struct migration_step m3_steps[] = {
+	{ NULL, m3_once },
+	{ "tags", m3_tags },
+};
+
+/* #endregion migration 3: tag statistics */
+
+/* #region migration 4: credential tag counts */
+
+/*
+ * Untagged credentials are found through an index on their tag count rather
+ * than an anti-join over every mapping. A plain index keeps this working on
+ * SQLite releases without partial indexes.
+ */
+static const char *m4_once[] = {
+	"ALTER TABLE credentials ADD COLUMN tag_count INTEGER NOT NULL DEFAULT 0;",
+	"CREATE TRIGGER IF NOT EXISTS credentials_tag_count_map AFTER INSERT ON tagged_credentials BEGIN "
+		"UPDATE credentials SET tag_count = tag_count + 1 WHERE id = NEW.credentialid; END;",
+	"CREATE TRIGGER IF NOT EXISTS credentials_tag_count_unmap AFTER DELETE ON tagged_credentials BEGIN "
+		"UPDATE credentials SET tag_count = tag_count - 1 WHERE id = OLD.credentialid; END;",
+	"CREATE TRIGGER IF NOT EXISTS credentials_tag_count_remap "
+		"AFTER UPDATE OF credentialid ON tagged_credentials BEGIN "
+		"UPDATE credentials SET tag_count = tag_count - 1 WHERE id = OLD.credentialid; "
+		"UPDATE credentials SET tag_count = tag_count + 1 WHERE id = NEW.credentialid; END;",
+	NULL,
+};
+
+static const char *m4_credentials[] = {
+	"UPDATE credentials SET tag_count = "
+		"(SELECT count(*) FROM tagged_credentials WHERE credentialid = credentials.id) "
+		"WHERE " IN_CHUNK("id") ";",
+	NULL,
+};
+
+/* built once the counts exist rather than updated with every chunk */
+static const char *m4_index[] = {
+	"CREATE INDEX IF NOT EXISTS credentials_tag_count ON credentials (tag_count);",
+	NULL,
+};
+
+static const struct migration_step m4_steps[] = {
+	{ NULL, m4_once },
+	{ "credentials", m4_credentials },
+	{ "credentials", m4_index, 1 },
+};
+
+/* #endregion migration 4: credential tag counts */
+
+/* #region migration 5: description order */
+
+/* the rowid ends every index, so this also orders by (description, id) */
+static const char *m5_index[] = {
+	"CREATE INDEX IF NOT EXISTS credentials_description ON credentials (description);",
+	NULL,
+};
+
+static const struct migration_step m5_steps[] = {
+	{ "credentials", m5_index, 1 },
+};
+
+/* #endregion migration 5: description order */
+
+/* #region migration 6: credential accesses */
+
+static const char *m6_once[] = {
+	"CREATE TABLE IF NOT EXISTS credential_access ("
+		"credentialid INTEGER PRIMARY KEY REFERENCES credentials(id) ON DELETE CASCADE, "
+		"used INTEGER NOT NULL, "
+		"count INTEGER NOT NULL DEFAULT 0"
+		");",
+	/* ordered by (used, credentialid), the most recent are at its end */
+	"CREATE INDEX IF NOT EXISTS credential_access_used ON credential_access (used);",
+	NULL,
+};
+
+static const struct migration_step m6_steps[] = {
+	{ NULL, m6_once },
+};
+
+/* #endregion migration 6: credential accesses */
+
+/* #region migration 7: sync revisions */
+
+#define NOW_MS "CAST((julianday('now') - 2440587.5) * 86400000 AS INTEGER)"
+#define NEW_UUID "lower(hex(randomblob(16)))"
+/* links are identified by their credential's uuid and their tag */
+#define LINK_UUID(credentialid, tagid)                                          \
+	"(SELECT uuid FROM credentials WHERE id = " credentialid ") || ':' || "  \
+	"(SELECT tag FROM tags WHERE id = " tagid ")"
+#define TOMBSTONE(kind, uuid)                                                   \
+	"UPDATE sync_clock SET rev = rev + 1; "                                  \
+	"INSERT OR REPLACE INTO sync_tombstones (kind, uuid, rev, modified) "    \
+	"SELECT '" kind "', u, rev, " NOW_MS " FROM sync_clock, (SELECT " uuid " AS u) " \
+	"WHERE u IS NOT NULL; "
+
+/*
+ * Every synced row carries a uuid, the vault's clock when it last changed
+ * and when it was last modified anywhere. A sync only exchanges the rows
+ * and tombstones whose revision is newer than what the other vault has seen.
+ */
+static const char *m7_once[] = {
+	/* the vault's identity and its clock, a single row */
+	"CREATE TABLE IF NOT EXISTS sync_clock (uuid TEXT NOT NULL, rev INTEGER NOT NULL);",
+	"INSERT INTO sync_clock SELECT " NEW_UUID ", 1 WHERE NOT EXISTS (SELECT 1 FROM sync_clock);",
+	"CREATE TABLE IF NOT EXISTS sync_tombstones ("
+		"kind TEXT NOT NULL, "
+		"uuid TEXT NOT NULL, "
+		"rev INTEGER NOT NULL, "
+		"modified INTEGER NOT NULL, "
+		"PRIMARY KEY (kind, uuid)"
+		");",
+	"CREATE INDEX IF NOT EXISTS sync_tombstones_rev ON sync_tombstones (rev);",
+	/* the clock of each vault synced with when this one last saw it */
+	"CREATE TABLE IF NOT EXISTS sync_peers (uuid TEXT PRIMARY KEY NOT NULL, rev INTEGER NOT NULL);",
+	"ALTER TABLE credentials ADD COLUMN uuid TEXT;",
+	"ALTER TABLE credentials ADD COLUMN rev INTEGER NOT NULL DEFAULT 0;",
+	"ALTER TABLE credentials ADD COLUMN modified INTEGER;",
+	"ALTER TABLE tags ADD COLUMN uuid TEXT;",
+	"ALTER TABLE tags ADD COLUMN rev INTEGER NOT NULL DEFAULT 0;",
+	"ALTER TABLE tags ADD COLUMN modified INTEGER;",
+	"ALTER TABLE tagged_credentials ADD COLUMN rev INTEGER NOT NULL DEFAULT 0;",
+	"ALTER TABLE tagged_credentials ADD COLUMN modified INTEGER;",
+	NULL,
+};
+
+static const char *m7_credentials[] = {
+	"UPDATE credentials SET uuid = " NEW_UUID ", rev = 1, modified = " NOW_MS
+		" WHERE " IN_CHUNK("id") " AND uuid IS NULL;",
+	NULL,
+};
+
+static const char *m7_tags[] = {
+	"UPDATE tags SET uuid = " NEW_UUID ", rev = 1, modified = " NOW_MS
+		" WHERE " IN_CHUNK("id") " AND uuid IS NULL;",
+	NULL,
+};
+
+static const char *m7_tagged_credentials[] = {
+	"UPDATE tagged_credentials SET rev = 1, modified = " NOW_MS
+		" WHERE " IN_CHUNK("rowid") " AND rev = 0;",
+	NULL,
+};
+
+/* built once the chunks above have filled the columns */
+static const char *m7_credentials_index[] = {
+	"CREATE UNIQUE INDEX IF NOT EXISTS credentials_uuid ON credentials (uuid);",
+	"CREATE INDEX IF NOT EXISTS credentials_rev ON credentials (rev);",
+	NULL,
+};
+
+static const char *m7_tags_index[] = {
+	"CREATE UNIQUE INDEX IF NOT EXISTS tags_uuid ON tags (uuid);",
+	"CREATE INDEX IF NOT EXISTS tags_rev ON tags (rev);",
+	NULL,
+};
+
+static const char *m7_tagged_credentials_index[] = {
+	"CREATE INDEX IF NOT EXISTS tagged_credentials_rev ON tagged_credentials (rev);",
+	NULL,
+};
+
+/*
+ * Created last so the chunks above do not bump the clock. A change applied
+ * by a sync sets modified itself, which the triggers keep. The rev of a row
+ * only changes here, so WHEN NEW.rev IS OLD.rev tells a trigger's own update
+ * apart from the change that fired it.
+ */
+static const char *m7_triggers[] = {
+	/* rows added between the chunks and now */
+	"UPDATE credentials SET uuid = " NEW_UUID ", rev = 1, modified = " NOW_MS " WHERE uuid IS NULL;",
+	"UPDATE tags SET uuid = " NEW_UUID ", rev = 1, modified = " NOW_MS " WHERE uuid IS NULL;",
+	"UPDATE tagged_credentials SET rev = 1, modified = " NOW_MS " WHERE rev = 0;",
+	"CREATE TRIGGER IF NOT EXISTS credentials_sync_insert AFTER INSERT ON credentials BEGIN "
+		"UPDATE sync_clock SET rev = rev + 1; "
+		"UPDATE credentials SET uuid = coalesce(NEW.uuid, " NEW_UUID "), "
+		"rev = (SELECT rev FROM sync_clock), modified = coalesce(NEW.modified, " NOW_MS ") "
+		"WHERE id = NEW.id; END;",
+	"CREATE TRIGGER IF NOT EXISTS credentials_sync_update "
+		"AFTER UPDATE OF usernameid, passwordid, description, modified ON credentials "
+		"WHEN NEW.rev IS OLD.rev BEGIN "
+		"UPDATE sync_clock SET rev = rev + 1; "
+		"UPDATE credentials SET rev = (SELECT rev FROM sync_clock), modified = "
+		"CASE WHEN NEW.modified IS OLD.modified THEN " NOW_MS " ELSE NEW.modified END "
+		"WHERE id = NEW.id; END;",
+	"CREATE TRIGGER IF NOT EXISTS credentials_sync_delete AFTER DELETE ON credentials BEGIN "
+		TOMBSTONE("credential", "OLD.uuid") "END;",
+	"CREATE TRIGGER IF NOT EXISTS tags_sync_insert AFTER INSERT ON tags BEGIN "
+		"UPDATE sync_clock SET rev = rev + 1; "
+		"UPDATE tags SET uuid = coalesce(NEW.uuid, " NEW_UUID "), "
+		"rev = (SELECT rev FROM sync_clock), modified = coalesce(NEW.modified, " NOW_MS ") "
+		"WHERE id = NEW.id; END;",
+	"CREATE TRIGGER IF NOT EXISTS tags_sync_update AFTER UPDATE OF tag, wiki, modified ON tags "
+		"WHEN NEW.rev IS OLD.rev BEGIN "
+		"UPDATE sync_clock SET rev = rev + 1; "
+		"UPDATE tags SET rev = (SELECT rev FROM sync_clock), modified = "
+		"CASE WHEN NEW.modified IS OLD.modified THEN " NOW_MS " ELSE NEW.modified END "
+		"WHERE id = NEW.id; END;",
+	"CREATE TRIGGER IF NOT EXISTS tags_sync_delete AFTER DELETE ON tags BEGIN "
+		TOMBSTONE("tag", "OLD.uuid") "END;",
+	/* a link added again must not be deleted by its own tombstone */
+	"CREATE TRIGGER IF NOT EXISTS tagged_credentials_sync_insert "
+		"AFTER INSERT ON tagged_credentials BEGIN "
+		"UPDATE sync_clock SET rev = rev + 1; "
+		"UPDATE tagged_credentials SET rev = (SELECT rev FROM sync_clock), "
+		"modified = coalesce(NEW.modified, " NOW_MS ") "
+		"WHERE credentialid = NEW.credentialid AND tagid = NEW.tagid; "
+		"DELETE FROM sync_tombstones WHERE kind = 'link' AND uuid = "
+		LINK_UUID("NEW.credentialid", "NEW.tagid") "; END;",
+	/* the cascades from a deleted credential or tag leave no tombstone */
+	"CREATE TRIGGER IF NOT EXISTS tagged_credentials_sync_delete "
+		"AFTER DELETE ON tagged_credentials BEGIN "
+		TOMBSTONE("link", LINK_UUID("OLD.credentialid", "OLD.tagid")) "END;",
+	"CREATE TRIGGER IF NOT EXISTS tagged_credentials_sync_update "
+		"AFTER UPDATE OF credentialid, tagid ON tagged_credentials BEGIN "
+		TOMBSTONE("link", LINK_UUID("OLD.credentialid", "OLD.tagid"))
+		"UPDATE tagged_credentials SET rev = (SELECT rev FROM sync_clock), modified = " NOW_MS " "
+		"WHERE credentialid = NEW.credentialid AND tagid = NEW.tagid; END;",
+	NULL,
+};
+
+static const struct migration_step m7_steps[] = {
+	{ NULL, m7_once },
+	{ "credentials", m7_credentials },
+	{ "tags", m7_tags },
+	{ "tagged_credentials", m7_tagged_credentials },
+	{ "credentials", m7_credentials_index, 1 },
+	{ "tags", m7_tags_index, 1 },
+	{ "tagged_credentials", m7_tagged_credentials_index, 1 },
+	{ NULL, m7_triggers },
+};
+
+/* #endregion migration 7: sync revisions */
+
+/* #region migration 8: change log */
+
+#define CHANGE(kind, op, id, tagid)                                             \
+	"INSERT INTO changes (kind, op, id, tagid, at) VALUES (" kind ", " op ", " \
+	id ", " tagid ", " NOW "); "
+#define CREDENTIAL_CHANGE(op, id) CHANGE("0", op, id, "NULL")
+#define TAG_CHANGE(op, id) CHANGE("1", op, id, "NULL")
+#define LINK_CHANGE(op, credentialid, tagid) CHANGE("2", op, credentialid, tagid)
+
+/*
+ * One row per change to a credential, tag or tagging, for readers to catch
+ * up on without reading the whole vault. AUTOINCREMENT keeps the sequence
+ * growing when the log is compacted down to nothing. The kinds and ops are
+ * the SAFEWORD_CHANGE_ values; only updates to columns the user sees are
+ * logged, not rewrites of the same values or the bookkeeping other triggers
+ * update.
+ */
+static const char *m8_once[] = {
+	"CREATE TABLE IF NOT EXISTS changes ("
+		"seq INTEGER PRIMARY KEY AUTOINCREMENT, "
+		"kind INTEGER NOT NULL, "
+		"op INTEGER NOT NULL, "
+		"id INTEGER NOT NULL, "
+		"tagid INTEGER, "
+		"at INTEGER NOT NULL"
+		");",
+	"CREATE TRIGGER IF NOT EXISTS credentials_change_insert AFTER INSERT ON credentials BEGIN "
+		CREDENTIAL_CHANGE("0", "NEW.id") "END;",
+	"CREATE TRIGGER IF NOT EXISTS credentials_change_update "
+		"AFTER UPDATE OF usernameid, passwordid, description ON credentials "
+		"WHEN NEW.usernameid IS NOT OLD.usernameid OR NEW.passwordid IS NOT OLD.passwordid "
+		"OR NEW.description IS NOT OLD.description BEGIN "
+		CREDENTIAL_CHANGE("1", "NEW.id") "END;",
+	"CREATE TRIGGER IF NOT EXISTS credentials_change_delete AFTER DELETE ON credentials BEGIN "
+		CREDENTIAL_CHANGE("2", "OLD.id") "END;",
+	"CREATE TRIGGER IF NOT EXISTS tags_change_insert AFTER INSERT ON tags BEGIN "
+		TAG_CHANGE("0", "NEW.id") "END;",
+	"CREATE TRIGGER IF NOT EXISTS tags_change_update AFTER UPDATE OF tag, wiki ON tags "
+		"WHEN NEW.tag IS NOT OLD.tag OR NEW.wiki IS NOT OLD.wiki BEGIN "
+		TAG_CHANGE("1", "NEW.id") "END;",
+	"CREATE TRIGGER IF NOT EXISTS tags_change_delete AFTER DELETE ON tags BEGIN "
+		TAG_CHANGE("2", "OLD.id") "END;",
+	"CREATE TRIGGER IF NOT EXISTS tagged_credentials_change_insert "
+		"AFTER INSERT ON tagged_credentials BEGIN "
+		LINK_CHANGE("0", "NEW.credentialid", "NEW.tagid") "END;",
+	/* a moved tagging is logged as the removal and addition it amounts to */
+	"CREATE TRIGGER IF NOT EXISTS tagged_credentials_change_update "
+		"AFTER UPDATE OF credentialid, tagid ON tagged_credentials "
+		"WHEN NEW.credentialid IS NOT OLD.credentialid OR NEW.tagid IS NOT OLD.tagid BEGIN "
+		LINK_CHANGE("2", "OLD.credentialid", "OLD.tagid")
+		LINK_CHANGE("0", "NEW.credentialid", "NEW.tagid") "END;",
+	"CREATE TRIGGER IF NOT EXISTS tagged_credentials_change_delete "
+		"AFTER DELETE ON tagged_credentials BEGIN "
+		LINK_CHANGE("2", "OLD.credentialid", "OLD.tagid") "END;",
+	NULL,
+};
+
+static const struct migration_step m8_steps[] = {
+	{ NULL, m8_once },
+};
+
+/* #endregion migration 8: change log */
+
+/* #region migration 9: tag wikis */
+
+/* a wiki changing is a change of its tag, for sync and the change log */
+#define WIKI_CHANGE(id)                                                         \
+	"UPDATE tags SET modified = " NOW_MS " WHERE id = " id "; "             \
+	TAG_CHANGE("1", id)
+
+/*
+ * Wikis move to a table of their own with the wiki as its last column: only
+ * there does the zeroblob a wiki is streamed into stay unwritten until it is
+ * filled, anywhere else in a row it is allocated in full. The tags triggers
+ * no longer watch the wiki column, which keeps the move from looking like a
+ * change of every tag with a wiki.
+ */
+static const char *m9_once[] = {
+	"CREATE TABLE IF NOT EXISTS tag_wikis ("
+		"tagid INTEGER PRIMARY KEY REFERENCES tags(id) ON DELETE CASCADE, "
+		"wiki BLOB NOT NULL"
+		");",
+	"DROP TRIGGER IF EXISTS tags_sync_update;",
+	"CREATE TRIGGER tags_sync_update AFTER UPDATE OF tag, modified ON tags "
+		"WHEN NEW.rev IS OLD.rev BEGIN "
+		"UPDATE sync_clock SET rev = rev + 1; "
+		"UPDATE tags SET rev = (SELECT rev FROM sync_clock), modified = "
+		"CASE WHEN NEW.modified IS OLD.modified THEN " NOW_MS " ELSE NEW.modified END "
+		"WHERE id = NEW.id; END;",
+	"DROP TRIGGER IF EXISTS tags_change_update;",
+	"CREATE TRIGGER tags_change_update AFTER UPDATE OF tag ON tags "
+		"WHEN NEW.tag IS NOT OLD.tag BEGIN "
+		TAG_CHANGE("1", "NEW.id") "END;",
+	NULL,
+};
+
+static const char *m9_tags[] = {
+	"INSERT OR REPLACE INTO tag_wikis (tagid, wiki) SELECT id, wiki FROM tags "
+		"WHERE " IN_CHUNK("id") " AND wiki IS NOT NULL;",
+	"UPDATE tags SET wiki = NULL WHERE " IN_CHUNK("id") " AND wiki IS NOT NULL;",
+	NULL,
+};
+
+/* created last so the chunks above do not count as changes */
+static const char *m9_triggers[] = {
+	/* wikis written between the chunks and now */
+	"INSERT OR REPLACE INTO tag_wikis (tagid, wiki) SELECT id, wiki FROM tags WHERE wiki IS NOT NULL;",
+	"UPDATE tags SET wiki = NULL WHERE wiki IS NOT NULL;",
+	"CREATE TRIGGER IF NOT EXISTS tag_wikis_insert AFTER INSERT ON tag_wikis BEGIN "
+		WIKI_CHANGE("NEW.tagid") "END;",
+	"CREATE TRIGGER IF NOT EXISTS tag_wikis_update AFTER UPDATE OF wiki ON tag_wikis BEGIN "
+		WIKI_CHANGE("NEW.tagid") "END;",
+	/* the cascade from a deleted tag is not a change of the wiki */
+	"CREATE TRIGGER IF NOT EXISTS tag_wikis_delete AFTER DELETE ON tag_wikis "
+		"WHEN EXISTS (SELECT 1 FROM tags WHERE id = OLD.tagid) BEGIN "
+		WIKI_CHANGE("OLD.tagid") "END;",
+	NULL,
+};
+
+static const struct migration_step m9_steps[] = {
+	{ NULL, m9_once },
+	{ "tags", m9_tags },
+	{ NULL, m9_triggers },
+};
+
+/* #endregion migration 9: tag wikis */
+
+/* #region migration 10: reuse indexes */
+
+/* credentials sharing a username or a password are one index range apart */
+static const char *m10_usernameid_index[] = {
+	"CREATE INDEX IF NOT EXISTS credentials_usernameid ON credentials (usernameid);",
+	NULL,
+};
+
+static const char *m10_passwordid_index[] = {
+	"CREATE INDEX IF NOT EXISTS credentials_passwordid ON credentials (passwordid);",
+	NULL,
+};
+
+static const struct migration_step m10_steps[] = {
+	{ "credentials", m10_usernameid_index, 1 },
+	{ "credentials", m10_passwordid_index, 1 },
+};
+
+/* #endregion migration 10: reuse indexes */
+
+/* migrations[i] upgrades a vault from schema version i to i + 1 */
+static const struct migration migrations[SAFEWORD_SCHEMA_VERSION] = {
+	{ "strip stored NUL terminators", m1_steps, sizeof(m1_steps) / sizeof(m1_steps[0]) },
+	{ "case-folded tags", m2_steps, sizeof(m2_steps) / sizeof(m2_steps[0]) },
+	{ "tag statistics", m3_steps, sizeof(m3_steps) / sizeof(m3_steps[0]) },
+	{ "credential tag counts", m4_steps, sizeof(m4_steps) / sizeof(m4_steps[0]) },
+	{ "description order", m5_steps, sizeof(m5_steps) / sizeof(m5_steps[0]) },
+	{ "credential accesses", m6_steps, sizeof(m6_steps) / sizeof(m6_steps[0]) },
+	{ "sync revisions", m7_steps, sizeof(m7_steps) / sizeof(m7_steps[0]) },
+	{ "change log", m8_steps, sizeof(m8_steps) / sizeof(m8_steps[0]) },
+	{ "tag wikis", m9_steps, sizeof(m9_steps) / sizeof(m9_steps[0]) },
+	{ "reuse indexes", m10_steps, sizeof(m10_steps) / sizeof(m10_steps[0]) },
+};
+
+#define MIGRATIONS_SIZE SAFEWORD_SCHEMA_VERSION
+#define MIGRATE_CHUNK_DEFAULT 5000
+/* statements a step may have */
+#define MIGRATION_STEP_SQL_MAX 32
+
+/* #region safeword migrate helpers */
+
+/*
+ * Older vaults stored the key with its NUL terminator and the application
+ * version ("0.1.0") as the value; both read as schema version 0.
+ */
+static int read_version(sqlite3 *handle, int *version)
+{
+	int ret, i;
+	const unsigned char *value;
+	sqlite3_stmt *stmt = NULL;
+
+	*version = 0;
+	ret = sqlite3_prepare_v2(handle, "SELECT value FROM properties "
+		"WHERE key = 'version' OR key = 'version' || char(0) "
+		"ORDER BY length(CAST(key AS BLOB)) LIMIT 1;", -1, &stmt, NULL);
+	/* a vault created before the properties table is version 0 */
+	if (ret != SQLITE_OK)
+		return 0;
+
+	ret = sqlite3_step(stmt);
+	safeword_check(ret == SQLITE_ROW || ret == SQLITE_DONE, ESAFEWORD_BACKENDSTORAGE, fail);
+	if (ret == SQLITE_ROW && (value = sqlite3_column_text(stmt, 0)) != NULL) {
+		for (i = 0; value[i] >= '0' && value[i] <= '9'; i++);
+		if (i && value[i] == '\0')
+			*version = atoi((const char *) value);
+	}
+	sqlite3_finalize(stmt);
+
+	return 0;
+fail:
+	sqlite3_finalize(stmt);
+	return -1;
+}
+
+/* position reached by an interrupted migration to @c version */
+static void read_position(sqlite3 *handle, int version, unsigned int *step, sqlite3_int64 *rowid)
+{
+	int v = 0;
+	unsigned int s;
+	long long r;
+	sqlite3_stmt *stmt = NULL;
+
+	*step = 0;
+	*rowid = 0;
+	if (sqlite3_prepare_v2(handle, "SELECT value FROM properties WHERE key = 'migration';",
+			-1, &stmt, NULL) != SQLITE_OK)
+		return;
+	if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_text(stmt, 0) &&
+			sscanf((const char *) sqlite3_column_text(stmt, 0), "%d %u %lld", &v, &s, &r) == 3 &&
+			v == version) {
+		*step = s;
+		*rowid = r;
+	}
+	sqlite3_finalize(stmt);
+}
+
+static int write_property(sqlite3 *handle, const char *key, const char *value)
+{
+	int ret;
+	sqlite3_stmt *stmt = NULL;
+
+	if (value)
+		ret = sqlite3_prepare_v2(handle, "INSERT OR REPLACE INTO properties VALUES (?, ?);",
+			-1, &stmt, NULL);
+	else
+		ret = sqlite3_prepare_v2(handle, "DELETE FROM properties WHERE key = ?;", -1, &stmt, NULL);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+	ret = sqlite3_bind_text(stmt, 1, key, strlen(key), SQLITE_STATIC);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+	if (value) {
+		ret = sqlite3_bind_text(stmt, 2, value, strlen(value), SQLITE_STATIC);
+		safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+	}
+	ret = sqlite3_step(stmt);
+	safeword_check(ret == SQLITE_DONE, ESAFEWORD_BACKENDSTORAGE, fail);
+	sqlite3_finalize(stmt);
+
+	return 0;
+fail:
+	sqlite3_finalize(stmt);
+	return -1;
+}
+
+static sqlite3_int64 max_rowid(sqlite3 *handle, const char *table)
+{
+	char sql[64];
+	sqlite3_int64 max = 0;
+	sqlite3_stmt *stmt = NULL;
+
+	snprintf(sql, sizeof(sql), "SELECT max(rowid) FROM %s;", table);
+	if (sqlite3_prepare_v2(handle, sql, -1, &stmt, NULL) == SQLITE_OK &&
+			sqlite3_step(stmt) == SQLITE_ROW)
+		max = sqlite3_column_int64(stmt, 0);
+	sqlite3_finalize(stmt);
+
+	return max;
+}
+
+/* run the statements of a step, binding the chunk bounds if it has any */
+static int run_step(sqlite3 *handle, sqlite3_stmt **stmts, const struct migration_step *step,
+	sqlite3_int64 lo, sqlite3_int64 hi)
+{
+	int i, ret;
+
+	for (i = 0; step->sql[i]; i++) {
+		if (!stmts[i]) {
+			ret = sqlite3_prepare_v2(handle, step->sql[i], -1, &stmts[i], NULL);
+			if (ret != SQLITE_OK)
+				debug("migration: %s", sqlite3_errmsg(handle));
+			safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+		}
+		if (step->table && !step->whole) {
+			sqlite3_bind_int64(stmts[i], 1, lo);
+			sqlite3_bind_int64(stmts[i], 2, hi);
+		}
+		ret = sqlite3_step(stmts[i]);
+		sqlite3_reset(stmts[i]);
+		if (ret == SQLITE_ROW && sqlite3_stmt_readonly(stmts[i]))
+			continue;
+		if (ret == SQLITE_DONE && sqlite3_stmt_readonly(stmts[i])) {
+			/* the guard found nothing, skip the statement it guards */
+			if (step->sql[i + 1])
+				i++;
+			continue;
+		}
+		if (ret != SQLITE_DONE)
+			debug("migration: %s", sqlite3_errmsg(handle));
+		safeword_check(ret == SQLITE_DONE, ESAFEWORD_BACKENDSTORAGE, fail);
+	}
+
+	return 0;
+fail:
+	return -1;
+}
+
+static void finalize_step(sqlite3_stmt **stmts, const struct migration_step *step)
+{
+	int i;
+
+	for (i = 0; step->sql[i]; i++) {
+		sqlite3_finalize(stmts[i]);
+		stmts[i] = NULL;
+	}
+}
+
+/* #endregion safeword migrate helpers */
+
+/* #region safeword migrate */
+
+int safeword_schema_version(struct safeword_db *db)
+{
+	int version;
+
+	safeword_check(db != NULL && db->handle != NULL, ESAFEWORD_INVARG, fail);
+	safeword_check(!read_version(db->handle, &version), safeword_errno, fail);
+
+	return version;
+fail:
+	return -1;
+}
+
+static int migrate(sqlite3 *handle, int version, unsigned int chunk,
+	safeword_progress_callback progress, void *arg)
+{
+	int ret, in_transaction = 0;
+	unsigned int i, s;
+	char position[64];
+	sqlite3_int64 lo, hi, max, done = 0, total = 0;
+	sqlite3_stmt *stmts[MIGRATION_STEP_SQL_MAX] = { NULL };
+	const struct migration *m = &migrations[version];
+
+	read_position(handle, version + 1, &s, &lo);
+	if (s >= m->steps_size)
+		s = lo = 0;
+
+	/* progress is measured in rowids so it is cheap to compute up front */
+	for (i = 0; i < m->steps_size; i++) {
+		if (!m->steps[i].table)
+			continue;
+		max = max_rowid(handle, m->steps[i].table);
+		total += max;
+		if (i < s)
+			done += max;
+		else if (i == s)
+			done += lo;
+	}
+
+	for (; s < m->steps_size; s++, lo = 0) {
+		const struct migration_step *step = &m->steps[s];
+
+		do {
+			max = step->table ? max_rowid(handle, step->table) : 0;
+			hi = lo + chunk < max && !step->whole ? lo + chunk : max;
+
+			ret = sqlite3_exec(handle, "BEGIN IMMEDIATE;", 0, 0, 0);
+			safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+			in_transaction = 1;
+			safeword_check(!run_step(handle, stmts, step, lo, hi), safeword_errno, fail);
+
+			if (hi < max)
+				snprintf(position, sizeof(position), "%d %u %lld", version + 1, s, (long long) hi);
+			else
+				snprintf(position, sizeof(position), "%d %u 0", version + 1, s + 1);
+			if (s + 1 == m->steps_size && hi >= max) {
+				/* the last chunk also records the new version */
+				snprintf(position, sizeof(position), "%d", version + 1);
+				safeword_check(!write_property(handle, "version", position), safeword_errno, fail);
+				safeword_check(!write_property(handle, "migration", NULL), safeword_errno, fail);
+				ret = sqlite3_exec(handle, "DELETE FROM properties "
+					"WHERE key = 'version' || char(0);", 0, 0, 0);
+				safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+			} else
+				safeword_check(!write_property(handle, "migration", position), safeword_errno, fail);
+
+			ret = sqlite3_exec(handle, "COMMIT;", 0, 0, 0);
+			safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+			in_transaction = 0;
+
+			if (step->table)
+				done += hi - lo;
+			lo = hi;
+			if (progress && progress(version + 1, (long int) done, (long int) total, arg)) {
+				finalize_step(stmts, step);
+				safeword_check(0, ESAFEWORD_CANCELED, fail);
+			}
+		} while (lo < max);
+
+		finalize_step(stmts, step);
+	}
+
+	return 0;
+fail:
+	if (in_transaction)
+		sqlite3_exec(handle, "ROLLBACK;", 0, 0, 0);
+	for (i = 0; i < sizeof(stmts) / sizeof(stmts[0]); i++)
+		sqlite3_finalize(stmts[i]);
+	return -1;
+}
+
+int safeword_migrate(struct safeword_db *db, unsigned int chunk,
+	safeword_progress_callback progress, void *arg)
+{
+	int version;
+
+	safeword_check(db != NULL && db->handle != NULL, ESAFEWORD_INVARG, fail);
+
+	version = safeword_schema_version(db);
+	safeword_check(version >= 0, safeword_errno, fail);
+	if (version > (int) MIGRATIONS_SIZE)
+		debug("schema version %d is newer than %d", version, (int) MIGRATIONS_SIZE);
+	safeword_check(version <= (int) MIGRATIONS_SIZE, ESAFEWORD_SCHEMA, fail);
+
+	if (version < (int) MIGRATIONS_SIZE)
+		/* let other connections finish rather than failing a chunk */
+		sqlite3_busy_timeout(db->handle, 5000);
+
+	for (; version < (int) MIGRATIONS_SIZE; version++) {
+		debug("migrating schema to version %d: %s", version + 1, migrations[version].description);
+		safeword_check(!migrate(db->handle, version, chunk ? chunk : MIGRATE_CHUNK_DEFAULT,
+			progress, arg), safeword_errno, fail);
+	}
+
+	return 0;
+fail:
+	return -1;
+}
+
+/* #endregion safeword migrate */
@@ -0,0 +1,429 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "dbg.h"
+#include "safeword.h"
+
+/*
+ * Two vaults are synced over a single connection with the peer attached, so
+ * both change in one transaction and the merge is plain SQL between them.
+ * Each vault has a clock (see migration 7) that every change to a synced row
+ * advances, and remembers the other vault's clock as of their last sync. Only
+ * rows and tombstones newer than that are collected, so the work is in
+ * proportion to what changed rather than to the size of the vaults.
+ *
+ * The statements below are written once, from "src" to "dst", and prepared
+ * for both directions. ?1 is the uuid of the row and ?2 the modification time
+ * of the change being applied.
+ */
+
+enum sync_list {
+	SYNC_COLLECT = 0,
+	SYNC_CREDENTIAL,
+	SYNC_TAG,
+	SYNC_LINK,
+	SYNC_DELETE_CREDENTIAL,
+	SYNC_DELETE_TAG,
+	SYNC_DELETE_LINK,
+	SYNC_LISTS,
+};
+
+/* statements a list may have */
+#define SYNC_SQL_MAX 8
+#define SYNC_PEER "safeword_peer"
+
+static const char *schemas[] = { "main", SYNC_PEER };
+
+/* #region sync statements */
+
+/* ?1 is the side collected from, ?2 the clock the other side has seen */
+static const char *sync_collect[] = {
+	"INSERT OR REPLACE INTO temp.sync_delta (kind, uuid, side, modified, deleted) "
+		"SELECT 'credential', uuid, ?1, modified, 0 FROM src.credentials WHERE rev > ?2;",
+	"INSERT OR REPLACE INTO temp.sync_delta (kind, uuid, side, modified, deleted) "
+		"SELECT 'tag', uuid, ?1, modified, 0 FROM src.tags WHERE rev > ?2;",
+	"INSERT OR REPLACE INTO temp.sync_delta (kind, uuid, side, modified, deleted) "
+		"SELECT 'link', c.uuid || ':' || t.tag, ?1, l.modified, 0 "
+		"FROM src.tagged_credentials AS l "
+		"INNER JOIN src.credentials AS c ON (c.id = l.credentialid) "
+		"INNER JOIN src.tags AS t ON (t.id = l.tagid) WHERE l.rev > ?2;",
+	"INSERT OR REPLACE INTO temp.sync_delta (kind, uuid, side, modified, deleted) "
+		"SELECT kind, uuid, ?1, modified, 1 FROM src.sync_tombstones WHERE rev > ?2;",
+	NULL,
+};
+
+#define DST_ID(table, column, ref)                                              \
+	"(SELECT k.id FROM src.credentials AS c "                                \
+	"INNER JOIN src." table " AS v ON (v.id = c." ref ") "                  \
+	"INNER JOIN dst." table " AS k ON (k." column " = v." column ") WHERE c.uuid = ?1)"
+#define DST_USERNAMEID DST_ID("usernames", "username", "usernameid")
+#define DST_PASSWORDID DST_ID("passwords", "password", "passwordid")
+
+static const char *sync_credential[] = {
+	"INSERT OR IGNORE INTO dst.usernames (username) SELECT v.username "
+		"FROM src.credentials AS c INNER JOIN src.usernames AS v ON (v.id = c.usernameid) "
+		"WHERE c.uuid = ?1;",
+	"INSERT OR IGNORE INTO dst.passwords (password) SELECT v.password "
+		"FROM src.credentials AS c INNER JOIN src.passwords AS v ON (v.id = c.passwordid) "
+		"WHERE c.uuid = ?1;",
+	"UPDATE dst.credentials SET usernameid = " DST_USERNAMEID ", "
+		"passwordid = " DST_PASSWORDID ", "
+		"description = (SELECT description FROM src.credentials WHERE uuid = ?1), "
+		"modified = ?2 WHERE uuid = ?1 AND modified IS NOT ?2;",
+	"INSERT INTO dst.credentials (uuid, usernameid, passwordid, description, modified) "
+		"SELECT ?1, " DST_USERNAMEID ", " DST_PASSWORDID ", description, ?2 "
+		"FROM src.credentials WHERE uuid = ?1 "
+		"AND NOT EXISTS (SELECT 1 FROM dst.credentials WHERE uuid = ?1);",
+	"DELETE FROM dst.sync_tombstones WHERE kind = 'credential' AND uuid = ?1;",
+	NULL,
+};
+
+#define SRC_TAG "(SELECT tag FROM src.tags WHERE uuid = ?1)"
+
+/*
+ * Tags are unique by name, so a tag created in both vaults is merged into
+ * one: it keeps the smaller uuid and the contents of the tag that had it.
+ */
+static const char *sync_tag[] = {
+	"UPDATE dst.tags SET uuid = min(uuid, ?1) WHERE tag = " SRC_TAG " AND uuid != ?1 "
+		"AND NOT EXISTS (SELECT 1 FROM dst.tags WHERE uuid = ?1);",
+	/* a rename onto a tag the other vault has is left for the user */
+	"UPDATE dst.tags SET tag = " SRC_TAG ", "
+		"modified = ?2 WHERE uuid = ?1 AND modified IS NOT ?2 "
+		"AND NOT EXISTS (SELECT 1 FROM dst.tags AS k WHERE k.tag = " SRC_TAG " AND k.uuid != ?1);",
+	"INSERT INTO dst.tags (tag, uuid, modified) "
+		"SELECT tag, ?1, ?2 FROM src.tags WHERE uuid = ?1 "
+		"AND NOT EXISTS (SELECT 1 FROM dst.tags AS k WHERE k.uuid = ?1 OR k.tag = " SRC_TAG ");",
+	/* the wiki triggers stamp the tag as changed now, it is set back after */
+	"INSERT OR REPLACE INTO dst.tag_wikis (tagid, wiki) SELECT k.id, w.wiki "
+		"FROM src.tags AS t INNER JOIN src.tag_wikis AS w ON (w.tagid = t.id) "
+		"INNER JOIN dst.tags AS k ON (k.uuid = ?1) WHERE t.uuid = ?1 "
+		"AND w.wiki IS NOT (SELECT wiki FROM dst.tag_wikis WHERE tagid = k.id);",
+	"DELETE FROM dst.tag_wikis WHERE tagid = (SELECT id FROM dst.tags WHERE uuid = ?1) "
+		"AND NOT EXISTS (SELECT 1 FROM src.tags AS t "
+		"INNER JOIN src.tag_wikis AS w ON (w.tagid = t.id) WHERE t.uuid = ?1);",
+	"UPDATE dst.tags SET modified = ?2 WHERE uuid = ?1 AND modified IS NOT ?2;",
+	"DELETE FROM dst.sync_tombstones WHERE kind = 'tag' AND uuid = ?1;",
+	NULL,
+};
+
+/* a link's uuid is its credential's uuid and its tag, see migration 7 */
+#define LINK_CREDENTIAL "substr(?1, 1, instr(?1, ':') - 1)"
+#define LINK_TAG "substr(?1, instr(?1, ':') + 1)"
+
+static const char *sync_link[] = {
+	"INSERT OR IGNORE INTO dst.tagged_credentials (credentialid, tagid, modified) "
+		"SELECT c.id, t.id, ?2 FROM dst.credentials AS c, dst.tags AS t "
+		"WHERE c.uuid = " LINK_CREDENTIAL " AND t.tag = " LINK_TAG ";",
+	NULL,
+};
+
+/* kept even if dst never had the row, for the vaults dst syncs with next */
+#define SYNC_TOMBSTONE(kind)                                                    \
+	"UPDATE dst.sync_clock SET rev = rev + 1;",                              \
+	"INSERT OR REPLACE INTO dst.sync_tombstones (kind, uuid, rev, modified) " \
+	"SELECT '" kind "', ?1, rev, ?2 FROM dst.sync_clock;"
+
+static const char *sync_delete_credential[] = {
+	"DELETE FROM dst.credentials WHERE uuid = ?1;",
+	SYNC_TOMBSTONE("credential"),
+	NULL,
+};
+
+static const char *sync_delete_tag[] = {
+	"DELETE FROM dst.tags WHERE uuid = ?1;",
+	SYNC_TOMBSTONE("tag"),
+	NULL,
+};
+
+static const char *sync_delete_link[] = {
+	"DELETE FROM dst.tagged_credentials "
+		"WHERE credentialid = (SELECT id FROM dst.credentials WHERE uuid = " LINK_CREDENTIAL ") "
+		"AND tagid = (SELECT id FROM dst.tags WHERE tag = " LINK_TAG ");",
+	SYNC_TOMBSTONE("link"),
+	NULL,
+};
+
+/* whether a change collected into sync_delta lost to the other side's */
+#define SYNC_BEATEN "EXISTS (SELECT 1 FROM temp.sync_delta AS o "             \
+	"WHERE o.kind = d.kind AND o.uuid = d.uuid AND o.side != d.side "        \
+	"AND (o.modified > d.modified OR (o.modified = d.modified AND o.side = ?1)))"
+
+/* the contents of row d.uuid in both vaults, compared by SYNC_SAME */
+#define BOTH(table) "main." table " AS a, " SYNC_PEER "." table " AS b "       \
+	"WHERE a.uuid = d.uuid AND b.uuid = d.uuid"
+#define SAME_VALUE(table, column, ref)                                          \
+	"(SELECT " column " FROM main." table " WHERE id = a." ref ") IS "        \
+	"(SELECT " column " FROM " SYNC_PEER "." table " WHERE id = b." ref ")"
+#define SAME_CREDENTIAL "EXISTS (SELECT 1 FROM " BOTH("credentials") " AND "   \
+	SAME_VALUE("usernames", "username", "usernameid") " AND "               \
+	SAME_VALUE("passwords", "password", "passwordid") " AND "               \
+	"a.description IS b.description)"
+#define SAME_TAG "EXISTS (SELECT 1 FROM " BOTH("tags") " AND a.tag = b.tag AND " \
+	"(SELECT wiki FROM main.tag_wikis WHERE tagid = a.id) IS "               \
+	"(SELECT wiki FROM " SYNC_PEER ".tag_wikis WHERE tagid = b.id))"
+
+/*
+ * Whether both vaults made change d, as a copied vault has until it changes:
+ * neither side's change is a conflict or needs to be applied. A link's uuid
+ * is all there is to it, as is a deletion's.
+ */
+#define SYNC_SAME "EXISTS (SELECT 1 FROM temp.sync_delta AS o "               \
+	"WHERE o.kind = d.kind AND o.uuid = d.uuid AND o.side != d.side "        \
+	"AND o.modified IS d.modified AND o.deleted = d.deleted AND (d.deleted "  \
+	"OR d.kind = 'link' OR (d.kind = 'credential' AND " SAME_CREDENTIAL ") "  \
+	"OR (d.kind = 'tag' AND " SAME_TAG ")))"
+
+static const char **sync_lists[SYNC_LISTS] = {
+	sync_collect,
+	sync_credential,
+	sync_tag,
+	sync_link,
+	sync_delete_credential,
+	sync_delete_tag,
+	sync_delete_link,
+};
+
+/* #endregion sync statements */
+
+/* #region safeword sync helpers */
+
+/* @c sql with the "src." and "dst." prefixes naming the attached schemas */
+static char *expand(const char *sql, const char *src, const char *dst)
+{
+	const char *p;
+	char *expanded, *q;
+	size_t longest = strlen(src) > strlen(dst) ? strlen(src) : strlen(dst);
+
+	/* each four character prefix grows to at most a schema name and a dot */
+	expanded = malloc(strlen(sql) / 4 * (longest + 1) + strlen(sql) + 1);
+	if (!expanded)
+		return NULL;
+
+	for (p = sql, q = expanded; *p; ) {
+		if ((!strncmp(p, "src.", 4) || !strncmp(p, "dst.", 4)) &&
+				(p == sql || !(isalnum((unsigned char) p[-1]) || p[-1] == '_'))) {
+			strcpy(q, *p == 's' ? src : dst);
+			q += strlen(q);
+			*q++ = '.';
+			p += 4;
+		} else {
+			*q++ = *p++;
+		}
+	}
+	*q = '\0';
+
+	return expanded;
+}
+
+/*
+ * Run a list of statements from side @c from to the other, preparing them
+ * the first time. ?1 is bound to @c text, or to @c a if it is @c NULL, and
+ * ?2 to @c b.
+ */
+static int run_list(sqlite3 *handle, sqlite3_stmt *stmts[SYNC_LISTS][2][SYNC_SQL_MAX],
+	enum sync_list list, int from, const char *text, sqlite3_int64 a, sqlite3_int64 b)
+{
+	int i, ret;
+	char *sql;
+	sqlite3_stmt *stmt;
+
+	for (i = 0; sync_lists[list][i]; i++) {
+		stmt = stmts[list][from][i];
+		if (!stmt) {
+			sql = expand(sync_lists[list][i], schemas[from], schemas[!from]);
+			safeword_check(sql, ESAFEWORD_NOMEM, fail);
+			ret = sqlite3_prepare_v2(handle, sql, -1, &stmt, NULL);
+			if (ret != SQLITE_OK)
+				debug("sync: %s", sqlite3_errmsg(handle));
+			free(sql);
+			safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+			stmts[list][from][i] = stmt;
+		}
+		if (sqlite3_bind_parameter_count(stmt) >= 1) {
+			if (text)
+				sqlite3_bind_text(stmt, 1, text, -1, SQLITE_STATIC);
+			else
+				sqlite3_bind_int64(stmt, 1, a);
+		}
+		if (sqlite3_bind_parameter_count(stmt) >= 2)
+			sqlite3_bind_int64(stmt, 2, b);
+		ret = sqlite3_step(stmt);
+		sqlite3_reset(stmt);
+		if (ret != SQLITE_DONE)
+			debug("sync: %s", sqlite3_errmsg(handle));
+		safeword_check(ret == SQLITE_DONE, ESAFEWORD_BACKENDSTORAGE, fail);
+	}
+
+	return 0;
+fail:
+	return -1;
+}
+
+/* the single integer an expanded query returns, -1 if it fails */
+static sqlite3_int64 query_int(sqlite3 *handle, const char *sql, int from)
+{
+	char *expanded;
+	sqlite3_int64 value = -1;
+	sqlite3_stmt *stmt = NULL;
+
+	expanded = expand(sql, schemas[from], schemas[!from]);
+	if (expanded && sqlite3_prepare_v2(handle, expanded, -1, &stmt, NULL) == SQLITE_OK &&
+			sqlite3_step(stmt) == SQLITE_ROW)
+		value = sqlite3_column_int64(stmt, 0);
+	sqlite3_finalize(stmt);
+	free(expanded);
+
+	return value;
+}
+
+/* #endregion safeword sync helpers */
+
+/* #region safeword sync function */
+
+int safeword_sync(struct safeword_db *db, const char *path, struct safeword_sync_stats *stats)
+{
+	int ret = 0, side, attached = 0, in_transaction = 0;
+	unsigned int i, j;
+	sqlite3_int64 seen, ties;
+	sqlite3_stmt *stmt = NULL;
+	sqlite3_stmt *stmts[SYNC_LISTS][2][SYNC_SQL_MAX];
+	struct safeword_db peer;
+	struct safeword_sync_stats counts;
+	enum sync_list list;
+	const char *kind;
+	long long start = safeword_trace_enabled ? safeword_trace_now() : 0;
+
+	memset(stmts, 0, sizeof(stmts));
+	memset(&counts, 0, sizeof(counts));
+	safeword_check(db && db->handle && path, ESAFEWORD_INVARG, fail);
+	/* attaching needs a file */
+	safeword_check(strcmp(path, SAFEWORD_MEMORY) &&
+		strncmp(path, SAFEWORD_MEMORY_PREFIX, strlen(SAFEWORD_MEMORY_PREFIX)) &&
+		strncmp(path, SAFEWORD_MEMORY_SAVE_PREFIX, strlen(SAFEWORD_MEMORY_SAVE_PREFIX)),
+		ESAFEWORD_INVARG, fail);
+
+	/* the peer is migrated like any vault before it is attached */
+	ret = safeword_open(&peer, path);
+	safeword_close(&peer);
+	safeword_check(!ret, safeword_errno, fail);
+
+	ret = sqlite3_prepare_v2(db->handle, "ATTACH DATABASE ? AS " SYNC_PEER ";", -1, &stmt, NULL);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+	sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+	ret = sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+	stmt = NULL;
+	safeword_check(ret == SQLITE_DONE, ESAFEWORD_BACKENDSTORAGE, fail);
+	attached = 1;
+
+	ret = sqlite3_exec(db->handle, "BEGIN IMMEDIATE;", 0, 0, 0);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+	in_transaction = 1;
+
+	ret = sqlite3_exec(db->handle,
+		"CREATE TEMP TABLE IF NOT EXISTS sync_delta ("
+			"kind TEXT NOT NULL, "
+			"uuid TEXT NOT NULL, "
+			"side INTEGER NOT NULL, "
+			"modified INTEGER, "
+			"deleted INTEGER NOT NULL, "
+			"PRIMARY KEY (kind, uuid, side)"
+			");"
+		"DELETE FROM temp.sync_delta;"
+		/* a copied vault shares its identity, the copy gets a new one */
+		"UPDATE " SYNC_PEER ".sync_clock SET uuid = lower(hex(randomblob(16))) "
+			"WHERE uuid = (SELECT uuid FROM main.sync_clock);", 0, 0, 0);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+
+	/* both sides are collected before either is changed */
+	for (side = 0; side < 2; side++) {
+		seen = query_int(db->handle, "SELECT coalesce((SELECT p.rev FROM dst.sync_peers AS p "
+			"INNER JOIN src.sync_clock AS k ON (k.uuid = p.uuid)), 0);", side);
+		safeword_check(seen != -1, ESAFEWORD_BACKENDSTORAGE, fail);
+		ret = run_list(db->handle, stmts, SYNC_COLLECT, side, NULL, side, seen);
+		safeword_check(!ret, safeword_errno, fail);
+	}
+
+	/* a change made in both loses to the later one, ties to the larger uuid */
+	ties = query_int(db->handle, "SELECT (SELECT uuid FROM dst.sync_clock) > "
+		"(SELECT uuid FROM src.sync_clock);", 0);
+	safeword_check(ties != -1, ESAFEWORD_BACKENDSTORAGE, fail);
+
+	ret = sqlite3_prepare_v2(db->handle, "SELECT count(*) FROM temp.sync_delta AS d "
+		"WHERE " SYNC_BEATEN " AND NOT " SYNC_SAME ";", -1, &stmt, NULL);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+	sqlite3_bind_int64(stmt, 1, ties);
+	ret = sqlite3_step(stmt);
+	safeword_check(ret == SQLITE_ROW, ESAFEWORD_BACKENDSTORAGE, fail);
+	counts.conflicts = sqlite3_column_int(stmt, 0);
+	sqlite3_finalize(stmt);
+	stmt = NULL;
+
+	/* deletions first, then tags before the credentials before their links */
+	ret = sqlite3_prepare_v2(db->handle, "SELECT d.side, d.kind, d.uuid, d.modified, d.deleted "
+		"FROM temp.sync_delta AS d WHERE NOT " SYNC_BEATEN " AND NOT " SYNC_SAME " "
+		"ORDER BY d.deleted DESC, CASE d.kind WHEN 'tag' THEN 2 * d.deleted "
+		"WHEN 'credential' THEN 1 ELSE 2 - 2 * d.deleted END;", -1, &stmt, NULL);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+	sqlite3_bind_int64(stmt, 1, ties);
+	while ((ret = sqlite3_step(stmt)) == SQLITE_ROW) {
+		side = sqlite3_column_int(stmt, 0);
+		kind = (const char *) sqlite3_column_text(stmt, 1);
+		if (!strcmp(kind, "credential"))
+			list = SYNC_CREDENTIAL;
+		else if (!strcmp(kind, "tag"))
+			list = SYNC_TAG;
+		else
+			list = SYNC_LINK;
+		if (sqlite3_column_int(stmt, 4))
+			list += SYNC_DELETE_CREDENTIAL - SYNC_CREDENTIAL;
+
+		ret = run_list(db->handle, stmts, list, side,
+			(const char *) sqlite3_column_text(stmt, 2), 0, sqlite3_column_int64(stmt, 3));
+		safeword_check(!ret, safeword_errno, fail);
+		if (side == 0)
+			counts.sent++;
+		else
+			counts.received++;
+	}
+	safeword_check(ret == SQLITE_DONE, ESAFEWORD_BACKENDSTORAGE, fail);
+	sqlite3_finalize(stmt);
+	stmt = NULL;
+
+	/* each vault has now seen the other's clock, including what it received */
+	ret = sqlite3_exec(db->handle,
+		"INSERT OR REPLACE INTO main.sync_peers (uuid, rev) "
+			"SELECT uuid, rev FROM " SYNC_PEER ".sync_clock;"
+		"INSERT OR REPLACE INTO " SYNC_PEER ".sync_peers (uuid, rev) "
+			"SELECT uuid, rev FROM main.sync_clock;"
+		"DELETE FROM temp.sync_delta;"
+		"COMMIT;", 0, 0, 0);
+	safeword_check(ret == SQLITE_OK, ESAFEWORD_BACKENDSTORAGE, fail);
+	in_transaction = 0;
+
+	for (i = 0; i < SYNC_LISTS; i++)
+		for (j = 0; j < 2 * SYNC_SQL_MAX; j++)
+			sqlite3_finalize(stmts[i][j / SYNC_SQL_MAX][j % SYNC_SQL_MAX]);
+	sqlite3_exec(db->handle, "DETACH DATABASE " SYNC_PEER ";", 0, 0, 0);
+
+	if (stats)
+		*stats = counts;
+	safeword_trace_span("db", "safeword_sync", start, path, counts.sent + counts.received);
+	return 0;
+fail:
+	sqlite3_finalize(stmt);
+	for (i = 0; i < SYNC_LISTS; i++)
+		for (j = 0; j < 2 * SYNC_SQL_MAX; j++)
+			sqlite3_finalize(stmts[i][j / SYNC_SQL_MAX][j % SYNC_SQL_MAX]);
+	if (in_transaction)
+		sqlite3_exec(db->handle, "ROLLBACK;", 0, 0, 0);
+	if (attached)
+		sqlite3_exec(db->handle, "DETACH DATABASE " SYNC_PEER ";", 0, 0, 0);
+	safeword_trace_span("db", "safeword_sync", start, safeword_strerror(safeword_errno), -1);
+	return -1;
+}
+
+/* #endregion safeword sync function */
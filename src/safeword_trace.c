@@ -0,0 +1,444 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "dbg.h"
+#include "safeword.h"
+
+#ifdef WIN32
+#define flockfile _lock_file
+#define funlockfile _unlock_file
+#endif
+
+int safeword_trace_enabled = 0;
+static FILE *trace_file;
+/* one event per line instead of a Chrome trace-event array */
+static int trace_jsonl;
+static unsigned long trace_events;
+static int trace_pid;
+static int trace_next_tid;
+static __thread int trace_tid;
+
+/*
+ * When the statements running on this thread started and the rows they
+ * returned, kept until the statement finishes. SQLite reports durations in
+ * whole milliseconds on most systems, so statements are timed here instead.
+ * A statement is rarely stepped while more than a couple of others are
+ * running, the oldest slot is reused if it is.
+ */
+#define ROW_SLOTS 8
+struct row_slot {
+	void *stmt;
+	long int rows;
+	long long start;
+};
+static __thread struct row_slot row_slots[ROW_SLOTS];
+static __thread unsigned int row_slot_next;
+
+/* statements run on each connection, explained when it is closed */
+struct explained {
+	sqlite3 *handle;
+	char *sql;
+	struct explained *next;
+};
+static int explain_enabled;
+static struct explained *explained;
+static pthread_mutex_t explained_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* #region safeword trace events */
+
+long long safeword_trace_now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+}
+
+static int thread_id(void)
+{
+	if (!trace_tid)
+		trace_tid = __sync_add_and_fetch(&trace_next_tid, 1);
+	return trace_tid;
+}
+
+/*
+ * Write @c text to @c out, as a JSON string if @c json. Normalized SQL has
+ * its whitespace runs collapsed and quoted literals replaced by '?', so
+ * nothing stored in the vault can end up in a trace.
+ */
+static void write_text(FILE *out, const char *text, int sql, int json)
+{
+	const char *c;
+	int space = 0;
+
+	if (json)
+		fputc('"', out);
+	for (c = text; *c; c++) {
+		if (sql && (*c == ' ' || *c == '\t' || *c == '\n' || *c == '\r')) {
+			space = 1;
+			continue;
+		}
+		if (space) {
+			fputc(' ', out);
+			space = 0;
+		}
+		if (sql && *c == '\'') {
+			/* '' is an escaped quote inside the literal */
+			for (c++; *c && (*c != '\'' || c[1] == '\''); c++) {
+				if (*c == '\'')
+					c++;
+			}
+			fputc('?', out);
+			if (!*c)
+				break;
+		} else if (json && (*c == '"' || *c == '\\')) {
+			fprintf(out, "\\%c", *c);
+		} else if (json && (unsigned char) *c < 0x20) {
+			fprintf(out, "\\u%04x", (unsigned char) *c);
+		} else {
+			fputc(*c, out);
+		}
+	}
+	if (json)
+		fputc('"', out);
+}
+
+static void write_string(const char *text, int sql)
+{
+	write_text(trace_file, text, sql, 1);
+}
+
+static void begin_event(void)
+{
+	if (trace_jsonl)
+		return;
+	fputs(trace_events ? ",\n" : "[\n", trace_file);
+}
+
+static void end_event(void)
+{
+	if (trace_jsonl)
+		fputc('\n', trace_file);
+	trace_events++;
+}
+
+void safeword_trace_span(const char *category, const char *name, long long start,
+	const char *detail, long int count)
+{
+	long long end;
+
+	if (!safeword_trace_enabled)
+		return;
+
+	end = safeword_trace_now();
+	flockfile(trace_file);
+	begin_event();
+	fprintf(trace_file, "{\"name\":");
+	write_string(name, 0);
+	fprintf(trace_file, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":%d,\"tid\":%d,\"args\":{",
+		category, start, end - start, trace_pid, thread_id());
+	if (detail) {
+		fprintf(trace_file, "\"detail\":");
+		write_string(detail, 0);
+	}
+	if (count >= 0)
+		fprintf(trace_file, "%s\"count\":%ld", detail ? "," : "", count);
+	fprintf(trace_file, "}}");
+	end_event();
+	funlockfile(trace_file);
+}
+
+/* #endregion safeword trace events */
+
+/* #region safeword trace sql */
+
+static struct row_slot *row_slot(void *stmt, int create)
+{
+	unsigned int i;
+
+	for (i = 0; i < ROW_SLOTS; i++) {
+		if (row_slots[i].stmt == stmt)
+			return &row_slots[i];
+	}
+	if (!create)
+		return NULL;
+	i = row_slot_next++ % ROW_SLOTS;
+	row_slots[i].stmt = stmt;
+	row_slots[i].rows = 0;
+	row_slots[i].start = safeword_trace_now();
+	return &row_slots[i];
+}
+
+static void row_release(void *stmt)
+{
+	unsigned int i;
+
+	for (i = 0; i < ROW_SLOTS; i++) {
+		if (row_slots[i].stmt == stmt)
+			row_slots[i].stmt = NULL;
+	}
+}
+
+static void sql_span(const char *sql, long long duration, long int rows, int fullscan, int sorts)
+{
+	long long end = safeword_trace_now();
+
+	flockfile(trace_file);
+	begin_event();
+	fprintf(trace_file, "{\"name\":");
+	write_string(sql, 1);
+	fprintf(trace_file, ",\"cat\":\"sql\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":%d,\"tid\":%d,"
+		"\"args\":{\"rows\":%ld", end - duration, duration, trace_pid, thread_id(), rows);
+	if (fullscan >= 0)
+		fprintf(trace_file, ",\"fullscan_steps\":%d,\"sorts\":%d", fullscan, sorts);
+	fprintf(trace_file, "}}");
+	end_event();
+	funlockfile(trace_file);
+}
+
+/* #region safeword explain */
+
+void safeword_explain(int enable)
+{
+	explain_enabled = enable;
+}
+
+/* remember @c sql to be explained when @c handle is closed */
+static void explain_remember(sqlite3 *handle, const char *sql)
+{
+	struct explained **e, *statement;
+
+	/* nor the plans explained at close */
+	if (!sql || !strncmp(sql, "EXPLAIN", 7))
+		return;
+
+	pthread_mutex_lock(&explained_lock);
+	for (e = &explained; *e; e = &(*e)->next) {
+		if ((*e)->handle == handle && !strcmp((*e)->sql, sql))
+			goto done;
+	}
+	statement = calloc(1, sizeof(*statement));
+	if (statement)
+		statement->sql = calloc(strlen(sql) + 1, sizeof(char));
+	if (!statement || !statement->sql) {
+		free(statement);
+		goto done;
+	}
+	strcpy(statement->sql, sql);
+	statement->handle = handle;
+	/* appended, so plans are printed in the order statements first ran */
+	*e = statement;
+done:
+	pthread_mutex_unlock(&explained_lock);
+}
+
+static int is_table_scan(const char *detail)
+{
+	/* "SCAN t" since 3.36, "SCAN TABLE t" before; anything USING an index is not */
+	return !strncmp(detail, "SCAN ", 5) && !strstr(detail, " USING ") &&
+		strcmp(detail, "SCAN CONSTANT ROW") && !strstr(detail, "SUBQUERY");
+}
+
+/* returns whether @c sql has a query plan */
+static int explain_statement(sqlite3 *handle, const char *sql, int *scans, int *temps)
+{
+	int ret, i, rows = 0, depth;
+	int ids[64], depths[64];
+	const char *detail;
+	char *explain;
+	sqlite3_stmt *stmt = NULL;
+
+	explain = calloc(strlen(sql) + sizeof("EXPLAIN QUERY PLAN "), sizeof(char));
+	if (!explain)
+		return 0;
+	sprintf(explain, "EXPLAIN QUERY PLAN %s", sql);
+	ret = sqlite3_prepare_v2(handle, explain, -1, &stmt, NULL);
+	free(explain);
+	if (ret != SQLITE_OK) {
+		sqlite3_finalize(stmt);
+		return 0;
+	}
+
+	while (sqlite3_step(stmt) == SQLITE_ROW) {
+		detail = (const char*) sqlite3_column_text(stmt, 3);
+		if (!detail)
+			continue;
+		if (!rows++) {
+			write_text(stderr, sql, 1, 0);
+			fputc('\n', stderr);
+		}
+
+		/* nest each step under its parent, the rows come parents first */
+		depth = 1;
+		for (i = 0; i < rows - 1 && i < 64; i++) {
+			if (ids[i] == sqlite3_column_int(stmt, 1))
+				depth = depths[i] + 1;
+		}
+		if (rows - 1 < 64) {
+			ids[rows - 1] = sqlite3_column_int(stmt, 0);
+			depths[rows - 1] = depth;
+		}
+
+		fprintf(stderr, "%*s%s", depth * 2, "", detail);
+		if (is_table_scan(detail)) {
+			fprintf(stderr, "  <-- full table scan");
+			(*scans)++;
+		}
+		if (strstr(detail, "TEMP B-TREE")) {
+			fprintf(stderr, "  <-- temp b-tree");
+			(*temps)++;
+		}
+		fputc('\n', stderr);
+	}
+	sqlite3_finalize(stmt);
+	return rows > 0;
+}
+
+void safeword_explain_db(sqlite3 *handle)
+{
+	int statements = 0, scans = 0, temps = 0;
+	struct explained **e, *statement, *mine = NULL, **tail = &mine;
+
+	if (!explain_enabled || !handle)
+		return;
+
+	pthread_mutex_lock(&explained_lock);
+	for (e = &explained; *e;) {
+		statement = *e;
+		if (statement->handle == handle) {
+			*e = statement->next;
+			statement->next = NULL;
+			*tail = statement;
+			tail = &statement->next;
+		} else {
+			e = &statement->next;
+		}
+	}
+	pthread_mutex_unlock(&explained_lock);
+
+	while (mine) {
+		statement = mine;
+		mine = statement->next;
+		statements += explain_statement(handle, statement->sql, &scans, &temps);
+		free(statement->sql);
+		free(statement);
+	}
+	if (statements)
+		fprintf(stderr, "%d statements, %d full table scans, %d temp b-trees\n",
+			statements, scans, temps);
+}
+
+/* #endregion safeword explain */
+
+#if SQLITE_VERSION_NUMBER >= 3014000
+static int trace_sql(unsigned int type, void *not_used, void *p, void *x)
+{
+	sqlite3_stmt *stmt = p;
+	struct row_slot *slot;
+
+	/* trigger programs are reported as "-- TRIGGER name" within the statement */
+	if (type == SQLITE_TRACE_STMT && explain_enabled && strncmp((const char*) x, "--", 2))
+		explain_remember(sqlite3_db_handle(stmt), sqlite3_sql(stmt));
+
+	if (!safeword_trace_enabled)
+		return 0;
+
+	if (type == SQLITE_TRACE_STMT) {
+		if (strncmp((const char*) x, "--", 2)) {
+			slot = row_slot(stmt, 1);
+			slot->rows = 0;
+			slot->start = safeword_trace_now();
+		}
+	} else if (type == SQLITE_TRACE_ROW) {
+		row_slot(stmt, 1)->rows++;
+	} else if (type == SQLITE_TRACE_PROFILE) {
+		/* SQLite's own duration only if the start was not seen */
+		slot = row_slot(stmt, 0);
+		sql_span(sqlite3_sql(stmt), slot ? safeword_trace_now() - slot->start :
+			*(sqlite3_int64*) x / 1000, slot ? slot->rows : 0,
+			sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 0),
+			sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 0));
+		row_release(stmt);
+	}
+	return 0;
+}
+#else
+/* older releases only report the statement text and its duration */
+static void trace_sql(void *handle, const char *sql, sqlite3_uint64 ns)
+{
+	if (explain_enabled)
+		explain_remember(handle, sql);
+	if (safeword_trace_enabled)
+		sql_span(sql, ns / 1000, 0, -1, -1);
+}
+#endif
+
+void safeword_trace_db(sqlite3 *handle)
+{
+	if ((!safeword_trace_enabled && !explain_enabled) || !handle)
+		return;
+#if SQLITE_VERSION_NUMBER >= 3014000
+	sqlite3_trace_v2(handle, SQLITE_TRACE_STMT | SQLITE_TRACE_PROFILE | SQLITE_TRACE_ROW, trace_sql, NULL);
+#else
+	sqlite3_profile(handle, trace_sql, handle);
+#endif
+}
+
+/* #endregion safeword trace sql */
+
+/* #region safeword trace open & close */
+
+int safeword_trace_open(const char *path)
+{
+	size_t size;
+
+	if (!path || !*path)
+		return 0;
+	safeword_check(!trace_file, ESAFEWORD_INVARG, fail);
+
+	if (!strcmp(path, "-")) {
+		trace_file = stderr;
+	} else {
+		trace_file = fopen(path, "w");
+		if (!trace_file)
+			debug("failed to open trace file '%s'", path);
+		safeword_check(trace_file, ESAFEWORD_INVARG, fail);
+	}
+	size = strlen(path);
+	trace_jsonl = size > 6 && !strcmp(path + size - 6, ".jsonl");
+	trace_events = 0;
+	trace_pid = getpid();
+
+	/* names the process in the Chrome trace viewer */
+	begin_event();
+	fprintf(trace_file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"safeword\"}}",
+		trace_pid);
+	end_event();
+
+	safeword_trace_enabled = 1;
+	return 0;
+fail:
+	return -1;
+}
+
+int safeword_trace_close(void)
+{
+	if (!trace_file)
+		return 0;
+
+	safeword_trace_enabled = 0;
+	if (!trace_jsonl)
+		fputs("\n]\n", trace_file);
+	if (trace_file != stderr)
+		fclose(trace_file);
+	else
+		fflush(trace_file);
+	trace_file = NULL;
+	return 0;
+}
+
+/* #endregion safeword trace open & close */
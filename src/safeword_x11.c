@@ -0,0 +1,246 @@
+/*
+ * X11 clipboard backend, loaded by libsafeword the first time a credential
+ * is copied so that nothing else links against or loads the X libraries.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+
+#include "dbg.h"
+#include "safeword.h"
+
+/* milliseconds on a monotonic clock */
+static long long now_ms(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+}
+
+struct clipboard_session {
+	Display *dpy;
+	Window win;
+	Atom clipboard;
+	Atom utf8_string;
+	Atom targets;
+	/* the fields still to be pasted, texts[0] is being served */
+	const char **texts;
+	const size_t *sizes;
+	unsigned int count;
+	int copy_once;
+};
+
+/* answer one request for the clipboard, returns whether its text was pasted */
+static int serve_request(struct clipboard_session *session, XSelectionRequestEvent *req)
+{
+	XEvent respond;
+	int pasted = 0;
+
+	if (req->target == session->targets) {
+		Atom supported[] = {
+			session->utf8_string,
+			XA_STRING
+		};
+		XChangeProperty(session->dpy,
+			req->requestor,
+			req->property,
+			XA_ATOM,
+			32,
+			PropModeReplace,
+			(unsigned char*) supported,
+			(int) (sizeof(supported) / sizeof(Atom)));
+		respond.xselection.property=req->property;
+	} else if (req->target == session->utf8_string ||
+		req->target == XA_STRING) {
+		XChangeProperty(session->dpy,
+			req->requestor,
+			req->property,
+			req->target,
+			8,
+			PropModeReplace,
+			(const unsigned char*) session->texts[0],
+			session->sizes[0]);
+		respond.xselection.property=req->property;
+		pasted = 1;
+	} else {
+		respond.xselection.property= None;
+	}
+	respond.xselection.type= SelectionNotify;
+	respond.xselection.display= req->display;
+	respond.xselection.requestor= req->requestor;
+	respond.xselection.selection=req->selection;
+	respond.xselection.target= req->target;
+	respond.xselection.time = req->time;
+	XSendEvent(session->dpy, req->requestor,0,0,&respond);
+	XFlush(session->dpy);
+
+	return pasted;
+}
+
+/* tell whoever waits on @c fd whether the clipboard could be taken */
+static void notify(int fd, char status)
+{
+	if (fd != -1) {
+		if (write(fd, &status, 1) != 1)
+			debug("could not notify the clipboard status");
+		close(fd);
+	}
+}
+
+/*
+ * The clipboard session, see safeword_x11_copy_fields. @c ready, unless -1,
+ * is written the session's status as soon as it owns the clipboard or fails.
+ */
+static int serve_fields(const char **texts, const size_t *sizes, unsigned int count,
+	unsigned int ms, int copy_once, int ready)
+{
+	int ret = 0, timeout;
+	long long deadline = now_ms() + ms;
+	struct clipboard_session session;
+	struct pollfd fd;
+	XEvent e;
+
+	if (!count) {
+		notify(ready, 0);
+		return 0;
+	}
+
+	if (!(session.dpy = XOpenDisplay(NULL))) {
+		debug("could not open display\n");
+		ret = ESAFEWORD_NOCLIPBOARD;
+		goto fail;
+	}
+
+	/* create a window to trap events */
+	session.win = XCreateSimpleWindow(session.dpy, DefaultRootWindow(session.dpy), 0, 0, 1, 1, 0, 0, 0);
+	/* interned rather than taken from Xmu, which is one library less to load */
+	session.clipboard = XInternAtom(session.dpy, "CLIPBOARD", False);
+	session.utf8_string = XInternAtom(session.dpy, "UTF8_STRING", False);
+	session.targets = XInternAtom(session.dpy, "TARGETS", False);
+	session.texts = texts;
+	session.sizes = sizes;
+	session.count = count;
+	session.copy_once = copy_once;
+
+	XSelectInput(session.dpy, session.win, StructureNotifyMask+ExposureMask+PropertyChangeMask);
+	XSetSelectionOwner(session.dpy, session.clipboard, session.win, CurrentTime);
+	if (XGetSelectionOwner(session.dpy, session.clipboard) != session.win) {
+		debug("could not take the clipboard\n");
+		ret = ESAFEWORD_NOCLIPBOARD;
+		goto fail_display;
+	}
+	notify(ready, 0);
+	ready = -1;
+
+	fd.fd = ConnectionNumber(session.dpy);
+	fd.events = POLLIN;
+	while (session.count) {
+		/* handle everything already read before sleeping on the connection */
+		if (!XPending(session.dpy)) {
+			timeout = -1;
+			if (ms) {
+				if (now_ms() >= deadline)
+					break;
+				timeout = (int) (deadline - now_ms());
+			}
+			if (poll(&fd, 1, timeout) <= 0 && ms)
+				continue;
+			if (!XPending(session.dpy))
+				continue;
+		}
+		XNextEvent(session.dpy, &e);
+		if (e.type == SelectionClear) {
+			/* another application took the clipboard */
+			break;
+		} else if (e.type == SelectionRequest) {
+			if (serve_request(&session, &e.xselectionrequest) && session.copy_once) {
+				session.texts++;
+				session.sizes++;
+				session.count--;
+			}
+		}
+	}
+
+fail_display:
+	XDestroyWindow(session.dpy, session.win);
+	XCloseDisplay(session.dpy);
+fail:
+	notify(ready, ret);
+	return ret;
+}
+
+/*
+ * Serve @c texts on the clipboard one after the other, @c texts[0] first. With
+ * @c copy_once each paste moves on to the next text and the session ends
+ * once the last is pasted, otherwise the first is served until the deadline.
+ * The whole session ends after @c ms milliseconds, never if @c ms is 0, or
+ * when another application takes the clipboard. The texts stay valid until
+ * this returns.
+ */
+int safeword_x11_copy_fields(const char **texts, const size_t *sizes, unsigned int count,
+	unsigned int ms, int copy_once)
+{
+	return serve_fields(texts, sizes, count, ms, copy_once, -1);
+}
+
+/*
+ * Serve @c texts like safeword_x11_copy_fields but from a detached holder
+ * process, returning as soon as the holder owns the clipboard. The holder
+ * has a copy of the texts. A holder still serving an earlier copy loses the
+ * clipboard to the new one and exits, so holders never stack up.
+ */
+int safeword_x11_hold_fields(const char **texts, const size_t *sizes, unsigned int count,
+	unsigned int ms, int copy_once)
+{
+	int fd[2], null;
+	char status;
+	pid_t pid;
+
+	if (pipe(fd))
+		return ESAFEWORD_NOCLIPBOARD;
+
+	pid = fork();
+	if (pid == -1) {
+		close(fd[0]);
+		close(fd[1]);
+		return ESAFEWORD_NOCLIPBOARD;
+	}
+	if (pid == 0) {
+		/* detach from the terminal, then fork again so init reaps the holder */
+		close(fd[0]);
+		if (setsid() == -1 || fork() != 0)
+			_exit(0);
+
+		/* neither keep a directory busy nor a pipe reading the output open */
+		if (chdir("/"))
+			debug("could not change directory");
+		null = open("/dev/null", O_RDWR);
+		if (null != -1) {
+			dup2(null, STDIN_FILENO);
+			dup2(null, STDOUT_FILENO);
+			dup2(null, STDERR_FILENO);
+			if (null > STDERR_FILENO)
+				close(null);
+		}
+
+		/* nothing of the parent, such as its database, is cleaned up here */
+		_exit(serve_fields(texts, sizes, count, ms, copy_once, fd[1]));
+	}
+
+	close(fd[1]);
+	waitpid(pid, NULL, 0);
+	/* end of file without a status means the holder never got going */
+	if (read(fd[0], &status, 1) != 1)
+		status = ESAFEWORD_NOCLIPBOARD;
+	close(fd[0]);
+
+	return status;
+}
@@ -0,0 +1,131 @@
+/*
+ * Counts the heap allocations made while reading credentials with the owning
+ * API and with a reused arena. The executable is linked with
+ * -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc so only allocations made by
+ * the safeword library are counted, not the ones SQLite makes internally.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <safeword.h>
+
+#define CREDENTIALS 1000
+#define TAGS_PER_CREDENTIAL 3
+#define ROUNDS 100
+
+static unsigned long allocations;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+	allocations++;
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+	allocations++;
+	return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	allocations++;
+	return __real_realloc(ptr, size);
+}
+
+static int populate(struct safeword_db *db)
+{
+	int i, j;
+	char username[32], password[32], description[64], tag[32];
+	struct safeword_credential credential;
+
+	sqlite3_exec(db->handle, "BEGIN;", 0, 0, 0);
+	for (i = 0; i < CREDENTIALS; i++) {
+		memset(&credential, 0, sizeof(credential));
+		sprintf(username, "user%d", i);
+		sprintf(password, "password%d", i);
+		sprintf(description, "benchmark credential number %d", i);
+		credential.username = username;
+		credential.password = password;
+		credential.description = description;
+		if (safeword_credential_add(db, &credential))
+			return -1;
+		for (j = 0; j < TAGS_PER_CREDENTIAL; j++) {
+			sprintf(tag, "tag%d", (i + j) % 50);
+			if (safeword_credential_tag(db, credential.id, tag))
+				return -1;
+		}
+	}
+	sqlite3_exec(db->handle, "COMMIT;", 0, 0, 0);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = "bench_alloc.safeword";
+	int i, round, ret = 0;
+	unsigned long owning, arena_warm, arena_steady;
+	struct safeword_db db;
+	struct safeword_credential credential;
+	struct safeword_arena arena;
+
+	remove(path);
+	if (safeword_init(path) || safeword_open(&db, path) || populate(&db)) {
+		safeword_perror("bench_alloc");
+		return 1;
+	}
+
+	allocations = 0;
+	for (round = 0; round < ROUNDS; round++) {
+		for (i = 1; i <= CREDENTIALS; i++) {
+			memset(&credential, 0, sizeof(credential));
+			credential.id = i;
+			safeword_credential_read(&db, &credential);
+			safeword_credential_free(&credential);
+		}
+	}
+	owning = allocations;
+
+	safeword_arena_init(&arena, 0);
+	allocations = 0;
+	for (i = 1; i <= CREDENTIALS; i++) {
+		memset(&credential, 0, sizeof(credential));
+		credential.id = i;
+		safeword_credential_read_arena(&db, &arena, &credential);
+		safeword_arena_reset(&arena);
+	}
+	arena_warm = allocations;
+
+	allocations = 0;
+	for (round = 0; round < ROUNDS; round++) {
+		for (i = 1; i <= CREDENTIALS; i++) {
+			memset(&credential, 0, sizeof(credential));
+			credential.id = i;
+			safeword_credential_read_arena(&db, &arena, &credential);
+			safeword_arena_reset(&arena);
+		}
+	}
+	arena_steady = allocations;
+	safeword_arena_free(&arena);
+
+	printf("reads: %d\n", ROUNDS * CREDENTIALS);
+	printf("owning allocations: %lu (%.1f per read)\n", owning, (double) owning / (ROUNDS * CREDENTIALS));
+	printf("arena allocations (first pass): %lu\n", arena_warm);
+	printf("arena allocations (reused): %lu\n", arena_steady);
+
+	if (arena_steady != 0) {
+		fprintf(stderr, "reused arena allocated memory\n");
+		ret = 1;
+	}
+
+	safeword_close(&db);
+	remove(path);
+	return ret;
+}
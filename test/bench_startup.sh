@@ -0,0 +1,31 @@
+#!/bin/sh
+# Cold start: mean exec-to-exit time of a safeword command.
+#
+#   bench_startup.sh [SAFEWORD] [RUNS] [ARGS ...]
+#
+# SAFEWORD defaults to ./safeword, RUNS to 200 and ARGS to "ls --all". A
+# scratch database is created unless SAFEWORD_DB is already set.
+
+SAFEWORD=${1:-./safeword}
+RUNS=${2:-200}
+[ $# -gt 2 ] && shift 2 || set -- ls --all
+
+if [ -z "$SAFEWORD_DB" ]; then
+	SAFEWORD_DB=$(mktemp -u /tmp/bench_startup.XXXXXX)
+	export SAFEWORD_DB
+	"$SAFEWORD" init "$SAFEWORD_DB" > /dev/null || exit 1
+	trap 'rm -f "$SAFEWORD_DB"' EXIT
+fi
+
+# warm the page cache so only the loader and the command are measured
+"$SAFEWORD" "$@" > /dev/null
+
+start=$(date +%s%N)
+i=0
+while [ $i -lt "$RUNS" ]; do
+	"$SAFEWORD" "$@" > /dev/null
+	i=$((i + 1))
+done
+end=$(date +%s%N)
+
+echo "$SAFEWORD $*: $(( (end - start) / RUNS / 1000 )) us per run ($RUNS runs)"
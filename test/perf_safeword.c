@@ -0,0 +1,292 @@
+/*
+ * Times the key operations on a large generated vault and fails when one
+ * takes longer than its budget.
+ *
+ *   perf_safeword BUDGETS [RESULTS]
+ *
+ * BUDGETS lists an operation and its budget in milliseconds per line, '#'
+ * starts a comment. The timings are written to RESULTS, perf_results.json
+ * by default, for tracking them over time. An operation without a budget is
+ * timed but cannot fail.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+
+#include <safeword.h>
+
+#define CREDENTIALS 100000
+#define TAGS 5000
+#define TAGS_PER_CREDENTIAL 3
+/* credentials read one at a time and tags filtered on */
+#define READS 10000
+#define FILTERS 1000
+#define DELETED_CREDENTIALS 1000
+#define DELETED_TAGS 500
+
+#define MAX_OPERATIONS 16
+
+struct operation {
+	const char *name;
+	double ms;
+	/* 0 if it has no budget */
+	double budget_ms;
+};
+
+static struct operation operations[MAX_OPERATIONS];
+static int operations_size;
+static struct timespec started;
+
+static void start(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &started);
+}
+
+static void stop(const char *name)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	operations[operations_size].name = name;
+	operations[operations_size].ms = (now.tv_sec - started.tv_sec) * 1000.0 +
+		(now.tv_nsec - started.tv_nsec) / 1000000.0;
+	operations_size++;
+}
+
+/* the tag of the @c j th mapping of credential @c i, each tag gets an equal share */
+static void tag_name(char *tag, int i, int j)
+{
+	sprintf(tag, "perf%d", (i + j * (TAGS / TAGS_PER_CREDENTIAL)) % TAGS);
+}
+
+static int count_credential(struct safeword_credential *credential, void *arg)
+{
+	(*(unsigned int*) arg)++;
+	return 0;
+}
+
+static int add_credentials(struct safeword_db *db)
+{
+	int i;
+	char username[32], password[32], description[64];
+	struct safeword_credential credential;
+
+	sqlite3_exec(db->handle, "BEGIN;", 0, 0, 0);
+	for (i = 0; i < CREDENTIALS; i++) {
+		memset(&credential, 0, sizeof(credential));
+		sprintf(username, "user%d", i);
+		sprintf(password, "password%d", i);
+		sprintf(description, "perf credential number %d", i);
+		credential.username = username;
+		credential.password = password;
+		credential.description = description;
+		if (safeword_credential_add(db, &credential))
+			return -1;
+	}
+	return sqlite3_exec(db->handle, "COMMIT;", 0, 0, 0) ? -1 : 0;
+}
+
+static int tag_credentials(struct safeword_db *db)
+{
+	int i, j;
+	char tag[32];
+
+	sqlite3_exec(db->handle, "BEGIN;", 0, 0, 0);
+	for (i = 0; i < CREDENTIALS; i++) {
+		for (j = 0; j < TAGS_PER_CREDENTIAL; j++) {
+			tag_name(tag, i, j);
+			if (safeword_credential_tag(db, i + 1, tag))
+				return -1;
+		}
+	}
+	return sqlite3_exec(db->handle, "COMMIT;", 0, 0, 0) ? -1 : 0;
+}
+
+static int read_credentials(struct safeword_db *db)
+{
+	int i;
+	struct safeword_credential credential;
+
+	for (i = 0; i < READS; i++) {
+		memset(&credential, 0, sizeof(credential));
+		credential.id = (i * 9973L) % CREDENTIALS + 1;
+		if (safeword_credential_read(db, &credential))
+			return -1;
+		safeword_credential_free(&credential);
+	}
+	return 0;
+}
+
+/* list the credentials of @c size tags at a time, checking how many there are */
+static int filter_credentials(struct safeword_db *db, unsigned int size)
+{
+	int i;
+	unsigned int count, expected;
+	char first[32], second[32], *tags[] = { first, second };
+
+	for (i = 0; i < FILTERS; i++) {
+		tag_name(first, i, 0);
+		tag_name(second, i, 1);
+		count = 0;
+		if (safeword_list_credentials_foreach(db, size, tags, count_credential, &count))
+			return -1;
+		/* two tags a third apart are shared by two in every TAGS credentials */
+		expected = size == 1 ? CREDENTIALS * TAGS_PER_CREDENTIAL / TAGS : 2 * CREDENTIALS / TAGS;
+		if (count != expected) {
+			fprintf(stderr, "tag filter found %u credentials, expected %u\n", count, expected);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int list_credentials(struct safeword_db *db)
+{
+	unsigned int count = 0;
+
+	if (safeword_list_credentials_foreach(db, UINT_MAX, NULL, count_credential, &count))
+		return -1;
+	if (count != CREDENTIALS) {
+		fprintf(stderr, "listed %u credentials, expected %u\n", count, CREDENTIALS);
+		return -1;
+	}
+	return 0;
+}
+
+static int delete_credentials(struct safeword_db *db)
+{
+	int i;
+
+	for (i = 0; i < DELETED_CREDENTIALS; i++)
+		if (safeword_credential_delete(db, (i * 97L) % CREDENTIALS + 1))
+			return -1;
+	return 0;
+}
+
+static int delete_tags(struct safeword_db *db)
+{
+	int i;
+	char tag[32];
+
+	for (i = 0; i < DELETED_TAGS; i++) {
+		sprintf(tag, "perf%d", (i * 7) % TAGS);
+		if (safeword_tag_delete(db, tag))
+			return -1;
+	}
+	return 0;
+}
+
+static int read_budgets(const char *path)
+{
+	int i;
+	char line[256], name[64];
+	double ms;
+	FILE *in = fopen(path, "r");
+
+	if (!in) {
+		perror(path);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), in)) {
+		if (line[0] == '#' || sscanf(line, "%63s %lf", name, &ms) != 2)
+			continue;
+		for (i = 0; i < operations_size; i++)
+			if (!strcmp(operations[i].name, name))
+				operations[i].budget_ms = ms;
+	}
+	fclose(in);
+
+	return 0;
+}
+
+static int write_results(const char *path)
+{
+	int i;
+	FILE *out = fopen(path, "w");
+
+	if (!out) {
+		perror(path);
+		return -1;
+	}
+	fprintf(out, "{\"credentials\": %d, \"tags\": %d, \"operations\": [\n", CREDENTIALS, TAGS);
+	for (i = 0; i < operations_size; i++)
+		fprintf(out, "  {\"name\": \"%s\", \"ms\": %.1f, \"budget_ms\": %.0f}%s\n",
+			operations[i].name, operations[i].ms, operations[i].budget_ms,
+			i + 1 < operations_size ? "," : "");
+	fprintf(out, "]}\n");
+
+	return fclose(out) ? -1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = "perf_safeword.safeword";
+	const char *results = argc > 2 ? argv[2] : "perf_results.json";
+	int i, ret = 0;
+	struct safeword_db db;
+	struct {
+		const char *name;
+		int (*run)(struct safeword_db *db);
+	} *step, steps[] = {
+		{ "add", add_credentials },
+		{ "tag", tag_credentials },
+		{ "read", read_credentials },
+		{ "list", list_credentials },
+		{ "delete_credential", delete_credentials },
+		{ "delete_tag", delete_tags },
+	};
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: perf_safeword BUDGETS [RESULTS]\n");
+		return 2;
+	}
+
+	remove(path);
+	if (safeword_init(path) || safeword_open(&db, path)) {
+		safeword_perror("perf_safeword");
+		return 1;
+	}
+
+	for (step = steps; step < steps + sizeof(steps) / sizeof(steps[0]); step++) {
+		start();
+		if (step->run(&db))
+			goto fail;
+		stop(step->name);
+
+		/* filtering is timed once the mappings exist and before any are deleted */
+		if (!strcmp(step->name, "read")) {
+			start();
+			if (filter_credentials(&db, 1))
+				goto fail;
+			stop("filter");
+			start();
+			if (filter_credentials(&db, 2))
+				goto fail;
+			stop("filter_and");
+		}
+	}
+	safeword_close(&db);
+	remove(path);
+
+	if (read_budgets(argv[1]) || write_results(results))
+		return 1;
+	for (i = 0; i < operations_size; i++) {
+		printf("%-18s %10.1f ms", operations[i].name, operations[i].ms);
+		if (operations[i].budget_ms)
+			printf(" / %.0f ms", operations[i].budget_ms);
+		if (operations[i].budget_ms && operations[i].ms > operations[i].budget_ms) {
+			printf("  over budget");
+			ret = 1;
+		}
+		printf("\n");
+	}
+
+	return ret;
+fail:
+	safeword_perror(step->name);
+	safeword_close(&db);
+	remove(path);
+	return 1;
+}
@@ -36,11 +36,48 @@ const unsigned int EXAMPLES_SIZE = sizeof(examples) / sizeof(examples[0]);
 #include "tests_safeword_read.h"
 #include "tests_safeword_list.h"
 #include "tests_safeword_tag.h"
-
+#include "tests_safeword_async.h"
+#include "tests_safeword_arena.h"
+#include "tests_safeword_migrate.h"
+#include "tests_safeword_trace.h"
+#include "tests_safeword_backup.h"
+#include "tests_safeword_sync.h"
+#include "tests_safeword_changes.h"
+#include "tests_safeword_import.h"
+#include "tests_safeword_audit.h"
+
+/* most suites run against a vault in memory, which needs no disk at all */
 int suite_safeword_init(void)
 {
 	int ret;
 
+	db1 = calloc(1, sizeof(*db1));
+	if (!db1)
+		return -1;
+
+	ret = safeword_open(db1, SAFEWORD_MEMORY);
+	if (ret != 0)
+		return -1;
+
+	return 0;
+}
+
+int suite_safeword_clean(void)
+{
+	int ret;
+
+	ret = safeword_close(db1);
+	if (ret != 0)
+		return -1;
+
+	return 0;
+}
+
+/* for suites also opening db1_path on another connection */
+int suite_safeword_file_init(void)
+{
+	int ret;
+
 	ret = safeword_init(db1_path);
 	if (ret != 0)
 		return -1;
@@ -56,11 +93,11 @@ int suite_safeword_init(void)
 	return 0;
 }
 
-int suite_safeword_clean(void)
+int suite_safeword_file_clean(void)
 {
 	int ret;
 
-	ret = safeword_close(db1);
+	ret = suite_safeword_clean();
 	if (ret != 0)
 		return -1;
 
@@ -101,9 +138,22 @@ static CU_SuiteInfo suites[] = {
 	{ "suite_safeword_read_examples",        suite_safeword_examples,  suite_safeword_clean, tests_read_examples },
 	{ "suite_safeword_list_null",            NULL,                     NULL,                 tests_list_null },
 	{ "suite_safeword_list_tags",            suite_safeword_list_init, suite_safeword_clean, tests_list_tags },
+	{ "suite_safeword_list_namespaces",      suite_safeword_list_namespace_init, suite_safeword_clean, tests_list_namespaces },
 	{ "suite_safeword_tag_null",             NULL,                     NULL,                 tests_tag_null },
 	{ "suite_safeword_tag_credential",       suite_safeword_init,      suite_safeword_clean, tests_tag_credential },
 	{ "suite_safeword_tag_filter",           suite_safeword_init,      suite_safeword_clean, tests_tag_filter },
+	{ "suite_safeword_async_null",           NULL,                     NULL,                 tests_async_null },
+	{ "suite_safeword_async",                suite_safeword_file_init, suite_safeword_file_clean, tests_async },
+	{ "suite_safeword_arena_null",           NULL,                     NULL,                 tests_arena_null },
+	{ "suite_safeword_arena_examples",       suite_safeword_examples,  suite_safeword_clean, tests_arena_examples },
+	{ "suite_safeword_migrate_null",         NULL,                     NULL,                 tests_migrate_null },
+	{ "suite_safeword_migrate",              suite_safeword_migrate_init, suite_safeword_migrate_clean, tests_migrate },
+	{ "suite_safeword_trace",                suite_safeword_file_init, suite_safeword_file_clean, tests_trace },
+	{ "suite_safeword_backup",               suite_safeword_examples,  suite_safeword_clean, tests_backup },
+	{ "suite_safeword_sync",                 suite_safeword_sync_init, suite_safeword_sync_clean, tests_sync },
+	{ "suite_safeword_changes",              suite_safeword_init,      suite_safeword_clean, tests_changes },
+	{ "suite_safeword_import",               suite_safeword_init,      suite_safeword_clean, tests_import },
+	{ "suite_safeword_audit",                suite_safeword_init,      suite_safeword_clean, tests_audit },
 	CU_SUITE_INFO_NULL,
 };
 
@@ -3,11 +3,14 @@
 
 #include <safeword.h>
 
+extern const char db1_path[];
 extern struct safeword_db *db1;
 extern struct safeword_credential examples[];
 extern const unsigned int EXAMPLES_SIZE;
 
 int suite_safeword_clean(void);
 int suite_safeword_init(void);
+int suite_safeword_file_clean(void);
+int suite_safeword_file_init(void);
 
 #endif /* SAFEWORD_TEST_H */
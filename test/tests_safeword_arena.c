@@ -0,0 +1,134 @@
+#include <stdlib.h>
+
+#include <safeword.h>
+
+#include "test.h"
+#include "tests_safeword_arena.h"
+
+void test_safeword_arena_null(void)
+{
+	struct safeword_credential credential;
+	struct safeword_arena arena;
+	int ret;
+
+	memset(&credential, 0, sizeof(credential));
+	credential.id = 1;
+
+	ret = safeword_credential_read_arena(NULL, NULL, &credential);
+	CU_ASSERT(ret != 0);
+
+	ret = safeword_arena_init(&arena, 0);
+	CU_ASSERT(ret == 0);
+	ret = safeword_credential_read_arena(NULL, &arena, &credential);
+	CU_ASSERT(ret != 0);
+	safeword_arena_free(&arena);
+
+	ret = safeword_tags_free(0, NULL);
+	CU_ASSERT(ret == 0);
+}
+
+void test_safeword_arena_read_examples(void)
+{
+	int i, j, ret;
+	struct safeword_credential credential;
+	struct safeword_arena arena;
+
+	ret = safeword_arena_init(&arena, 0);
+	CU_ASSERT(ret == 0);
+
+	for (i = 0; i < EXAMPLES_SIZE; i++) {
+		memset(&credential, 0, sizeof(credential));
+		/* NOTE: this assumes the credential IDs match sequentially when input into the database. */
+		credential.id = i + 1;
+
+		ret = safeword_credential_read_arena(db1, &arena, &credential);
+		CU_ASSERT(ret == 0);
+
+		if (!credential.username || !examples[i].username) {
+			CU_ASSERT(examples[i].username == NULL);
+			CU_ASSERT(credential.username == NULL);
+		} else
+			CU_ASSERT_STRING_EQUAL(credential.username, examples[i].username);
+		if (!credential.password || !examples[i].password) {
+			CU_ASSERT(examples[i].password == NULL);
+			CU_ASSERT(credential.password == NULL);
+		} else
+			CU_ASSERT_STRING_EQUAL(credential.password, examples[i].password);
+		CU_ASSERT_STRING_EQUAL(credential.description, examples[i].description);
+		CU_ASSERT(credential.tags_size == examples[i].tags_size);
+		for (j = 0; j < examples[i].tags_size; j++)
+			CU_ASSERT_STRING_EQUAL(credential.tags[j], examples[i].tags[j]);
+	}
+
+	safeword_arena_free(&arena);
+}
+
+void test_safeword_arena_reuse(void)
+{
+	int i, ret;
+	unsigned int allocations;
+	struct safeword_credential credential;
+	struct safeword_arena arena;
+
+	ret = safeword_arena_init(&arena, 0);
+	CU_ASSERT(ret == 0);
+
+	/* The first pass sizes the arena for the largest result. */
+	for (i = 0; i < EXAMPLES_SIZE; i++) {
+		memset(&credential, 0, sizeof(credential));
+		credential.id = i + 1;
+		safeword_credential_read_arena(db1, &arena, &credential);
+		safeword_arena_reset(&arena);
+	}
+	allocations = arena.allocations;
+
+	for (i = 0; i < 1000 * EXAMPLES_SIZE; i++) {
+		memset(&credential, 0, sizeof(credential));
+		credential.id = (i % EXAMPLES_SIZE) + 1;
+		ret = safeword_credential_read_arena(db1, &arena, &credential);
+		CU_ASSERT(ret == 0);
+		safeword_arena_reset(&arena);
+	}
+	CU_ASSERT(arena.allocations == allocations);
+
+	/* Outgrowing the arena consolidates it into one block on reset. */
+	CU_ASSERT_PTR_NOT_NULL(safeword_arena_alloc(&arena, 1 << 20));
+	safeword_arena_reset(&arena);
+	allocations = arena.allocations;
+	CU_ASSERT_PTR_NOT_NULL(safeword_arena_alloc(&arena, 1 << 20));
+	CU_ASSERT(arena.allocations == allocations);
+
+	safeword_arena_free(&arena);
+}
+
+void test_safeword_arena_list_tags(void)
+{
+	int ret;
+	unsigned int tags_size;
+	char **tags;
+	struct safeword_arena arena;
+
+	ret = safeword_arena_init(&arena, 64);
+	CU_ASSERT(ret == 0);
+
+	ret = safeword_list_tags_arena(db1, &arena, &tags_size, &tags, 0, 0);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(tags_size == 2);
+	if (tags_size == 2) {
+		CU_ASSERT_STRING_EQUAL(tags[0], "email");
+		CU_ASSERT_STRING_EQUAL(tags[1], "gmail");
+	}
+
+	safeword_arena_free(&arena);
+}
+
+CU_TestInfo tests_arena_null[] = {
+	{ "test_safeword_arena_null", test_safeword_arena_null },
+	CU_TEST_INFO_NULL,
+};
+CU_TestInfo tests_arena_examples[] = {
+	{ "test_safeword_arena_read_examples", test_safeword_arena_read_examples },
+	{ "test_safeword_arena_reuse", test_safeword_arena_reuse },
+	{ "test_safeword_arena_list_tags", test_safeword_arena_list_tags },
+	CU_TEST_INFO_NULL,
+};
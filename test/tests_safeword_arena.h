@@ -0,0 +1,13 @@
+#ifndef TESTS_SAFEWORD_ARENA_H
+#define TESTS_SAFEWORD_ARENA_H
+
+#include <CUnit/Basic.h>
+
+void test_safeword_arena_null(void);
+void test_safeword_arena_read_examples(void);
+void test_safeword_arena_reuse(void);
+void test_safeword_arena_list_tags(void);
+extern CU_TestInfo tests_arena_null[];
+extern CU_TestInfo tests_arena_examples[];
+
+#endif /* TESTS_SAFEWORD_ARENA_H */
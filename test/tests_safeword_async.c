@@ -0,0 +1,193 @@
+#include <stdlib.h>
+#include <limits.h>
+#include <poll.h>
+
+#include <safeword.h>
+
+#include "test.h"
+#include "tests_safeword_async.h"
+
+static void count_completion(struct safeword_request *request, void *arg)
+{
+	int *completions = (int*) arg;
+	(*completions)++;
+}
+
+void test_safeword_async_null(void)
+{
+	struct safeword_async *async;
+	int ret;
+
+	async = safeword_async_create("does_not_exist.safeword");
+	CU_ASSERT_PTR_NULL(async);
+
+	ret = safeword_async_submit(NULL, NULL, 0);
+	CU_ASSERT(ret == -1);
+	ret = safeword_async_destroy(NULL);
+	CU_ASSERT(ret == -1);
+}
+
+void test_safeword_async_batch(void)
+{
+	int i, ret;
+	struct safeword_async *async;
+	struct safeword_credential *added, read;
+	struct safeword_request requests[3];
+
+	async = safeword_async_create(db1_path);
+	CU_ASSERT_PTR_NOT_NULL(async);
+	if (!async) return;
+
+	added = safeword_credential_create("grace", "hopper", "COBOL");
+	CU_ASSERT_PTR_NOT_NULL(added);
+
+	/* Add and tag in one batch; the tag request needs the id so tag by the next id. */
+	memset(requests, 0, sizeof(requests));
+	requests[0].type = SAFEWORD_REQUEST_ADD;
+	requests[0].credential = added;
+	requests[1].type = SAFEWORD_REQUEST_TAG;
+	requests[1].credential_id = 1;
+	requests[1].tag = "compiler";
+	requests[2].type = SAFEWORD_REQUEST_TAG;
+	requests[2].credential_id = 1;
+	requests[2].tag = "navy";
+
+	ret = safeword_async_submit(async, requests, 3);
+	CU_ASSERT(ret == 0);
+	for (i = 0; i < 3; i++) {
+		ret = safeword_async_wait(async, &requests[i]);
+		CU_ASSERT(ret == 0);
+	}
+	CU_ASSERT(added->id == 1);
+
+	/* The batch must be visible through a different connection. */
+	memset(&read, 0, sizeof(read));
+	read.id = added->id;
+	ret = safeword_credential_read(db1, &read);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT_STRING_EQUAL(read.username, "grace");
+	CU_ASSERT(read.tags_size == 2);
+	safeword_credential_free(&read);
+
+	ret = safeword_async_destroy(async);
+	CU_ASSERT(ret == 0);
+	safeword_credential_free(added);
+	free(added);
+}
+
+void test_safeword_async_dispatch(void)
+{
+	int i, ret, completions = 0;
+	struct safeword_async *async;
+	struct safeword_credential read;
+	struct safeword_request requests[2];
+	struct pollfd pfd;
+
+	async = safeword_async_create(db1_path);
+	CU_ASSERT_PTR_NOT_NULL(async);
+	if (!async) return;
+
+	memset(&read, 0, sizeof(read));
+	read.id = 1;
+	memset(requests, 0, sizeof(requests));
+	requests[0].type = SAFEWORD_REQUEST_READ;
+	requests[0].credential = &read;
+	requests[1].type = SAFEWORD_REQUEST_LIST_TAGS;
+	for (i = 0; i < 2; i++) {
+		requests[i].complete = count_completion;
+		requests[i].arg = &completions;
+	}
+
+	ret = safeword_async_submit(async, requests, 2);
+	CU_ASSERT(ret == 0);
+
+	/* Completions are only delivered when the caller dispatches them. */
+	pfd.fd = safeword_async_fd(async);
+	pfd.events = POLLIN;
+	while (completions < 2) {
+		ret = poll(&pfd, 1, 5000);
+		CU_ASSERT(ret == 1);
+		if (ret != 1) break;
+		safeword_async_dispatch(async);
+	}
+	CU_ASSERT(completions == 2);
+	CU_ASSERT(requests[0].status == 0);
+	CU_ASSERT_STRING_EQUAL(read.password, "hopper");
+	CU_ASSERT(requests[1].status == 0);
+	CU_ASSERT(requests[1].tags_size == 2);
+
+	safeword_tags_free(requests[1].tags_size, requests[1].tags);
+	safeword_credential_free(&read);
+	safeword_async_destroy(async);
+}
+
+static volatile int blocked;
+static volatile int release;
+
+static int block_worker(struct safeword_credential *credential, void *arg)
+{
+	blocked = 1;
+	while (!release);
+	return 0;
+}
+
+void test_safeword_async_cancel(void)
+{
+	int ret, completions = 0;
+	struct safeword_async *async;
+	struct safeword_request blocker, canceled;
+
+	async = safeword_async_create(db1_path);
+	CU_ASSERT_PTR_NOT_NULL(async);
+	if (!async) return;
+
+	/* Keep the worker busy so the second request stays queued. */
+	memset(&blocker, 0, sizeof(blocker));
+	blocker.type = SAFEWORD_REQUEST_LIST_CREDENTIALS;
+	blocker.filter_size = UINT_MAX;
+	blocker.each = block_worker;
+	memset(&canceled, 0, sizeof(canceled));
+	canceled.type = SAFEWORD_REQUEST_TAG;
+	canceled.credential_id = 1;
+	canceled.tag = "canceled";
+	canceled.complete = count_completion;
+	canceled.arg = &completions;
+
+	/* a request that was never submitted would never complete */
+	ret = safeword_async_wait(async, &canceled);
+	CU_ASSERT(ret == -1);
+	CU_ASSERT(safeword_errno == ESAFEWORD_INVARG);
+
+	ret = safeword_async_submit(async, &blocker, 1);
+	CU_ASSERT(ret == 0);
+	ret = safeword_async_submit(async, &canceled, 1);
+	CU_ASSERT(ret == 0);
+	while (!blocked);
+
+	/* Running requests can not be canceled, queued ones can. */
+	ret = safeword_async_cancel(async, &blocker);
+	CU_ASSERT(ret == -1);
+	ret = safeword_async_cancel(async, &canceled);
+	CU_ASSERT(ret == 0);
+	release = 1;
+
+	ret = safeword_async_wait(async, &canceled);
+	CU_ASSERT(ret == -1);
+	CU_ASSERT(canceled.error == ESAFEWORD_CANCELED);
+	CU_ASSERT(completions == 1);
+	ret = safeword_async_wait(async, &blocker);
+	CU_ASSERT(ret == 0);
+
+	safeword_async_destroy(async);
+}
+
+CU_TestInfo tests_async_null[] = {
+	{ "test_safeword_async_null", test_safeword_async_null },
+	CU_TEST_INFO_NULL,
+};
+CU_TestInfo tests_async[] = {
+	{ "test_safeword_async_batch", test_safeword_async_batch },
+	{ "test_safeword_async_dispatch", test_safeword_async_dispatch },
+	{ "test_safeword_async_cancel", test_safeword_async_cancel },
+	CU_TEST_INFO_NULL,
+};
@@ -0,0 +1,13 @@
+#ifndef TESTS_SAFEWORD_ASYNC_H
+#define TESTS_SAFEWORD_ASYNC_H
+
+#include <CUnit/Basic.h>
+
+void test_safeword_async_null(void);
+void test_safeword_async_batch(void);
+void test_safeword_async_dispatch(void);
+void test_safeword_async_cancel(void);
+extern CU_TestInfo tests_async_null[];
+extern CU_TestInfo tests_async[];
+
+#endif /* TESTS_SAFEWORD_ASYNC_H */
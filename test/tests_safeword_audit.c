@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <safeword.h>
+
+#include "test.h"
+#include "tests_safeword_audit.h"
+
+#define RECORDED_MAX 8
+
+struct recorded {
+	unsigned int size;
+	unsigned int stop_after;
+	int fields[RECORDED_MAX];
+	/* the ids of each group, as "1,2,3" */
+	char ids[RECORDED_MAX][64];
+};
+
+static int record_group(int field, unsigned int ids_size, const long int *ids, void *arg)
+{
+	unsigned int i;
+	struct recorded *recorded = arg;
+	char *at;
+
+	if (recorded->size < RECORDED_MAX) {
+		recorded->fields[recorded->size] = field;
+		at = recorded->ids[recorded->size];
+		for (i = 0; i < ids_size; i++)
+			at += sprintf(at, i ? ",%ld" : "%ld", ids[i]);
+		recorded->size++;
+	}
+
+	return recorded->stop_after && recorded->size == recorded->stop_after;
+}
+
+static long int add(const char *username, const char *password)
+{
+	struct safeword_credential credential;
+
+	memset(&credential, 0, sizeof(credential));
+	credential.username = (char*) username;
+	credential.password = (char*) password;
+	if (safeword_credential_add(db1, &credential))
+		return -1;
+	return credential.id;
+}
+
+void test_safeword_audit_null(void)
+{
+	int ret;
+	struct recorded recorded;
+
+	ret = safeword_audit_reuse(NULL, SAFEWORD_REUSE_PASSWORD, record_group, &recorded);
+	CU_ASSERT(ret == -1);
+	CU_ASSERT(safeword_errno == ESAFEWORD_INVARG);
+}
+
+void test_safeword_audit_reuse(void)
+{
+	int ret;
+	long int alice, bob, carol, dave;
+	struct recorded recorded;
+
+	ret = safeword_audit_reuse(db1, 0, record_group, &recorded);
+	CU_ASSERT(ret == -1);
+	ret = safeword_audit_reuse(db1, SAFEWORD_REUSE_PASSWORD, NULL, &recorded);
+	CU_ASSERT(ret == -1);
+
+	memset(&recorded, 0, sizeof(recorded));
+	ret = safeword_audit_reuse(db1, SAFEWORD_REUSE_USERNAME | SAFEWORD_REUSE_PASSWORD,
+		record_group, &recorded);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(recorded.size == 0);
+
+	alice = add("alice", "hunter2");
+	bob = add("bob", "hunter2");
+	carol = add("alice", "unique");
+	dave = add("dave", "hunter2");
+	CU_ASSERT_FATAL(alice > 0 && bob > 0 && carol > 0 && dave > 0);
+
+	memset(&recorded, 0, sizeof(recorded));
+	ret = safeword_audit_reuse(db1, SAFEWORD_REUSE_USERNAME | SAFEWORD_REUSE_PASSWORD,
+		record_group, &recorded);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT_FATAL(recorded.size == 2);
+	CU_ASSERT(recorded.fields[0] == SAFEWORD_REUSE_USERNAME);
+	CU_ASSERT(recorded.fields[1] == SAFEWORD_REUSE_PASSWORD);
+	CU_ASSERT(!strcmp(recorded.ids[0], "1,3"));
+	CU_ASSERT(!strcmp(recorded.ids[1], "1,2,4"));
+
+	memset(&recorded, 0, sizeof(recorded));
+	ret = safeword_audit_reuse(db1, SAFEWORD_REUSE_PASSWORD, record_group, &recorded);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(recorded.size == 1);
+	CU_ASSERT(recorded.fields[0] == SAFEWORD_REUSE_PASSWORD);
+
+	/* a password no longer shared is no longer reported */
+	CU_ASSERT(safeword_credential_delete(db1, bob) == 0);
+	CU_ASSERT(safeword_credential_delete(db1, dave) == 0);
+	memset(&recorded, 0, sizeof(recorded));
+	ret = safeword_audit_reuse(db1, SAFEWORD_REUSE_PASSWORD, record_group, &recorded);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(recorded.size == 0);
+}
+
+void test_safeword_audit_stop(void)
+{
+	int ret;
+	struct recorded recorded;
+
+	add("erin", "shared");
+	add("frank", "shared");
+
+	/* stopping after the usernames leaves the passwords out */
+	memset(&recorded, 0, sizeof(recorded));
+	recorded.stop_after = 1;
+	ret = safeword_audit_reuse(db1, SAFEWORD_REUSE_USERNAME | SAFEWORD_REUSE_PASSWORD,
+		record_group, &recorded);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(recorded.size == 1);
+	CU_ASSERT(recorded.fields[0] == SAFEWORD_REUSE_USERNAME);
+}
+
+CU_TestInfo tests_audit[] = {
+	{ "test_safeword_audit_null", test_safeword_audit_null },
+	{ "test_safeword_audit_reuse", test_safeword_audit_reuse },
+	{ "test_safeword_audit_stop", test_safeword_audit_stop },
+	CU_TEST_INFO_NULL,
+};
@@ -0,0 +1,11 @@
+#ifndef TESTS_SAFEWORD_AUDIT_H
+#define TESTS_SAFEWORD_AUDIT_H
+
+#include <CUnit/Basic.h>
+
+void test_safeword_audit_null(void);
+void test_safeword_audit_reuse(void);
+void test_safeword_audit_stop(void);
+extern CU_TestInfo tests_audit[];
+
+#endif /* TESTS_SAFEWORD_AUDIT_H */
@@ -0,0 +1,131 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <safeword.h>
+
+#include "test.h"
+#include "tests_safeword_backup.h"
+
+static const char backup_path[] = "backup.safeword";
+
+struct progress {
+	int calls;
+	int done;
+	int total;
+	int cancel;
+};
+
+static int count_progress(int done, int total, void *arg)
+{
+	struct progress *progress = arg;
+
+	progress->calls++;
+	progress->done = done;
+	progress->total = total;
+
+	return progress->cancel;
+}
+
+void test_safeword_backup_null(void)
+{
+	int ret;
+
+	ret = safeword_backup(NULL, backup_path, NULL);
+	CU_ASSERT(ret == -1);
+	CU_ASSERT(safeword_errno == ESAFEWORD_INVARG);
+
+	ret = safeword_backup(db1, NULL, NULL);
+	CU_ASSERT(ret == -1);
+	CU_ASSERT(safeword_errno == ESAFEWORD_INVARG);
+	CU_ASSERT(access(backup_path, F_OK) == -1);
+}
+
+void test_safeword_backup_examples(void)
+{
+	int i, ret;
+	struct safeword_db db;
+	struct safeword_credential credential;
+	struct safeword_backup_options options;
+	struct progress progress;
+
+	memset(&progress, 0, sizeof(progress));
+	memset(&options, 0, sizeof(options));
+	/* a page per step, so the backup takes several */
+	options.pages = 1;
+	options.progress = count_progress;
+	options.arg = &progress;
+
+	ret = safeword_backup(db1, backup_path, &options);
+	CU_ASSERT_FATAL(ret == 0);
+	CU_ASSERT(progress.calls > 1);
+	CU_ASSERT(progress.done == progress.total);
+	CU_ASSERT(access("backup.safeword.partial", F_OK) == -1);
+
+	ret = safeword_open(&db, backup_path);
+	CU_ASSERT_FATAL(ret == 0);
+	for (i = 0; i < EXAMPLES_SIZE; i++) {
+		memset(&credential, 0, sizeof(credential));
+		credential.id = i + 1;
+		ret = safeword_credential_read(&db, &credential);
+		CU_ASSERT(ret == 0);
+		CU_ASSERT(credential.id == i + 1);
+		if (credential.description && examples[i].description)
+			CU_ASSERT_STRING_EQUAL(credential.description, examples[i].description);
+		safeword_credential_free(&credential);
+	}
+	CU_ASSERT(safeword_close(&db) == 0);
+
+	CU_ASSERT(remove(backup_path) == 0);
+}
+
+void test_safeword_backup_keep(void)
+{
+	int i, ret;
+	struct safeword_backup_options options;
+
+	memset(&options, 0, sizeof(options));
+	options.keep = 3;
+
+	for (i = 0; i < 4; i++) {
+		ret = safeword_backup(db1, backup_path, &options);
+		CU_ASSERT(ret == 0);
+	}
+	CU_ASSERT(access(backup_path, F_OK) == 0);
+	CU_ASSERT(access("backup.safeword.1", F_OK) == 0);
+	CU_ASSERT(access("backup.safeword.2", F_OK) == 0);
+	CU_ASSERT(access("backup.safeword.3", F_OK) == -1);
+
+	CU_ASSERT(remove(backup_path) == 0);
+	CU_ASSERT(remove("backup.safeword.1") == 0);
+	CU_ASSERT(remove("backup.safeword.2") == 0);
+}
+
+void test_safeword_backup_cancel(void)
+{
+	int ret;
+	struct safeword_backup_options options;
+	struct progress progress;
+
+	memset(&progress, 0, sizeof(progress));
+	progress.cancel = 1;
+	memset(&options, 0, sizeof(options));
+	options.pages = 1;
+	options.progress = count_progress;
+	options.arg = &progress;
+
+	ret = safeword_backup(db1, backup_path, &options);
+	CU_ASSERT(ret == -1);
+	CU_ASSERT(safeword_errno == ESAFEWORD_CANCELED);
+	CU_ASSERT(progress.calls == 1);
+	CU_ASSERT(access(backup_path, F_OK) == -1);
+	CU_ASSERT(access("backup.safeword.partial", F_OK) == -1);
+}
+
+CU_TestInfo tests_backup[] = {
+	{ "test_safeword_backup_null", test_safeword_backup_null },
+	{ "test_safeword_backup_examples", test_safeword_backup_examples },
+	{ "test_safeword_backup_keep", test_safeword_backup_keep },
+	{ "test_safeword_backup_cancel", test_safeword_backup_cancel },
+	CU_TEST_INFO_NULL,
+};
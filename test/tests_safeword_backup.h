@@ -0,0 +1,12 @@
+#ifndef TESTS_SAFEWORD_BACKUP_H
+#define TESTS_SAFEWORD_BACKUP_H
+
+#include <CUnit/Basic.h>
+
+void test_safeword_backup_null(void);
+void test_safeword_backup_examples(void);
+void test_safeword_backup_keep(void);
+void test_safeword_backup_cancel(void);
+extern CU_TestInfo tests_backup[];
+
+#endif /* TESTS_SAFEWORD_BACKUP_H */
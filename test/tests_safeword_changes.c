@@ -0,0 +1,196 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <safeword.h>
+
+#include "test.h"
+#include "tests_safeword_changes.h"
+
+#define RECORDED_MAX 16
+
+struct recorded {
+	unsigned int size;
+	unsigned int stop_after;
+	struct safeword_change changes[RECORDED_MAX];
+};
+
+static int record_change(const struct safeword_change *change, void *arg)
+{
+	struct recorded *recorded = arg;
+
+	if (recorded->size < RECORDED_MAX)
+		recorded->changes[recorded->size++] = *change;
+
+	return recorded->stop_after && recorded->size == recorded->stop_after;
+}
+
+static int dummy_change(const struct safeword_change *change, void *arg)
+{
+	(void) change;
+	(void) arg;
+	return 0;
+}
+
+#define CU_ASSERT_CHANGE(change, KIND, OP, ID) \
+	CU_ASSERT((change).kind == (KIND) && (change).op == (OP) && (change).id == (ID))
+
+void test_safeword_changes_null(void)
+{
+	int ret;
+
+	ret = safeword_changes(NULL, 0, 0, dummy_change, NULL);
+	CU_ASSERT(ret == -1);
+	CU_ASSERT(safeword_errno == ESAFEWORD_INVARG);
+
+	ret = safeword_changes(db1, 0, 0, NULL, NULL);
+	CU_ASSERT(ret == -1);
+	CU_ASSERT(safeword_errno == ESAFEWORD_INVARG);
+
+	ret = safeword_changes(db1, -1, 0, dummy_change, NULL);
+	CU_ASSERT(ret == -1);
+	CU_ASSERT(safeword_errno == ESAFEWORD_INVARG);
+
+	CU_ASSERT(safeword_changes_last(NULL) == -1);
+	CU_ASSERT(safeword_changes_compact(NULL, 0) == -1);
+	CU_ASSERT(safeword_changes_compact(db1, -1) == -1);
+
+	/* nothing has changed yet */
+	CU_ASSERT(safeword_changes_last(db1) == 0);
+}
+
+void test_safeword_changes_log(void)
+{
+	int ret;
+	unsigned int i;
+	struct recorded recorded;
+	struct safeword_credential credential = {
+		.username = "nikola",
+		.password = "alternating current",
+		.description = "Tesla Electric Light and Manufacturing",
+	};
+
+	ret = safeword_credential_add(db1, &credential);
+	CU_ASSERT_FATAL(ret == 0);
+	ret = safeword_credential_tag(db1, credential.id, "inventor");
+	CU_ASSERT_FATAL(ret == 0);
+	ret = safeword_credential_untag(db1, credential.id, "inventor");
+	CU_ASSERT_FATAL(ret == 0);
+	ret = safeword_tag_delete(db1, "inventor");
+	CU_ASSERT_FATAL(ret == 0);
+	ret = safeword_credential_delete(db1, credential.id);
+	CU_ASSERT_FATAL(ret == 0);
+
+	memset(&recorded, 0, sizeof(recorded));
+	ret = safeword_changes(db1, 0, 0, record_change, &recorded);
+	CU_ASSERT_FATAL(ret == 0);
+	CU_ASSERT_FATAL(recorded.size == 6);
+
+	CU_ASSERT_CHANGE(recorded.changes[0], SAFEWORD_CHANGE_CREDENTIAL, SAFEWORD_CHANGE_INSERT, credential.id);
+	CU_ASSERT(recorded.changes[1].kind == SAFEWORD_CHANGE_TAG);
+	CU_ASSERT(recorded.changes[1].op == SAFEWORD_CHANGE_INSERT);
+	CU_ASSERT_CHANGE(recorded.changes[2], SAFEWORD_CHANGE_TAGGING, SAFEWORD_CHANGE_INSERT, credential.id);
+	CU_ASSERT(recorded.changes[2].tag_id == recorded.changes[1].id);
+	CU_ASSERT_CHANGE(recorded.changes[3], SAFEWORD_CHANGE_TAGGING, SAFEWORD_CHANGE_DELETE, credential.id);
+	CU_ASSERT(recorded.changes[3].tag_id == recorded.changes[1].id);
+	CU_ASSERT_CHANGE(recorded.changes[4], SAFEWORD_CHANGE_TAG, SAFEWORD_CHANGE_DELETE, recorded.changes[1].id);
+	CU_ASSERT_CHANGE(recorded.changes[5], SAFEWORD_CHANGE_CREDENTIAL, SAFEWORD_CHANGE_DELETE, credential.id);
+
+	for (i = 1; i < recorded.size; i++) {
+		CU_ASSERT(recorded.changes[i].seq > recorded.changes[i - 1].seq);
+		CU_ASSERT(recorded.changes[i].at >= recorded.changes[i - 1].at);
+	}
+	CU_ASSERT(safeword_changes_last(db1) == recorded.changes[5].seq);
+}
+
+void test_safeword_changes_since(void)
+{
+	int ret;
+	long long since;
+	struct recorded recorded;
+	struct safeword_credential credential = {
+		.username = "thomas",
+		.password = "direct current",
+		.description = "Edison Illuminating Company",
+	};
+
+	since = safeword_changes_last(db1);
+	CU_ASSERT_FATAL(since > 0);
+
+	ret = safeword_credential_add(db1, &credential);
+	CU_ASSERT_FATAL(ret == 0);
+	credential.description = "General Electric";
+	ret = safeword_credential_update(db1, &credential);
+	CU_ASSERT_FATAL(ret == 0);
+
+	memset(&recorded, 0, sizeof(recorded));
+	ret = safeword_changes(db1, since, 0, record_change, &recorded);
+	CU_ASSERT_FATAL(ret == 0);
+	CU_ASSERT_FATAL(recorded.size == 2);
+	CU_ASSERT(recorded.changes[0].seq == since + 1);
+	CU_ASSERT_CHANGE(recorded.changes[0], SAFEWORD_CHANGE_CREDENTIAL, SAFEWORD_CHANGE_INSERT, credential.id);
+	CU_ASSERT_CHANGE(recorded.changes[1], SAFEWORD_CHANGE_CREDENTIAL, SAFEWORD_CHANGE_UPDATE, credential.id);
+
+	/* a limit and a callback stopping early both end the iteration */
+	memset(&recorded, 0, sizeof(recorded));
+	ret = safeword_changes(db1, since, 1, record_change, &recorded);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(recorded.size == 1);
+
+	memset(&recorded, 0, sizeof(recorded));
+	recorded.stop_after = 1;
+	ret = safeword_changes(db1, 0, 0, record_change, &recorded);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(recorded.size == 1);
+
+	/* nothing after the last change */
+	memset(&recorded, 0, sizeof(recorded));
+	ret = safeword_changes(db1, safeword_changes_last(db1), 0, record_change, &recorded);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(recorded.size == 0);
+}
+
+void test_safeword_changes_compact(void)
+{
+	int ret;
+	long long last;
+	struct recorded recorded;
+
+	last = safeword_changes_last(db1);
+	CU_ASSERT_FATAL(last > 2);
+
+	ret = safeword_changes_compact(db1, 2);
+	CU_ASSERT(ret == 2);
+
+	/* a reader behind the compacted changes has to start over */
+	ret = safeword_changes(db1, 1, 0, dummy_change, NULL);
+	CU_ASSERT(ret == -1);
+	CU_ASSERT(safeword_errno == ESAFEWORD_COMPACTED);
+
+	memset(&recorded, 0, sizeof(recorded));
+	ret = safeword_changes(db1, 2, 0, record_change, &recorded);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(recorded.size == last - 2);
+	CU_ASSERT(recorded.changes[0].seq == 3);
+
+	/* compacting everything keeps the sequence going */
+	ret = safeword_changes_compact(db1, last);
+	CU_ASSERT(ret == last - 2);
+	CU_ASSERT(safeword_changes_last(db1) == last);
+
+	ret = safeword_changes(db1, last - 1, 0, dummy_change, NULL);
+	CU_ASSERT(ret == -1);
+	CU_ASSERT(safeword_errno == ESAFEWORD_COMPACTED);
+
+	memset(&recorded, 0, sizeof(recorded));
+	ret = safeword_changes(db1, last, 0, record_change, &recorded);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(recorded.size == 0);
+}
+
+CU_TestInfo tests_changes[] = {
+	{ "test_safeword_changes_null", test_safeword_changes_null },
+	{ "test_safeword_changes_log", test_safeword_changes_log },
+	{ "test_safeword_changes_since", test_safeword_changes_since },
+	{ "test_safeword_changes_compact", test_safeword_changes_compact },
+	CU_TEST_INFO_NULL,
+};
@@ -0,0 +1,12 @@
+#ifndef TESTS_SAFEWORD_CHANGES_H
+#define TESTS_SAFEWORD_CHANGES_H
+
+#include <CUnit/Basic.h>
+
+void test_safeword_changes_null(void);
+void test_safeword_changes_log(void);
+void test_safeword_changes_since(void);
+void test_safeword_changes_compact(void);
+extern CU_TestInfo tests_changes[];
+
+#endif /* TESTS_SAFEWORD_CHANGES_H */
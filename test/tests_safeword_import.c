@@ -0,0 +1,209 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <safeword.h>
+
+#include "test.h"
+#include "tests_safeword_import.h"
+
+/* a stream reading @c text, as an export would be read */
+static FILE *export_stream(const char *text)
+{
+	FILE *in = tmpfile();
+
+	if (in) {
+		fputs(text, in);
+		rewind(in);
+	}
+	return in;
+}
+
+static int import_text(const char *text, struct safeword_import_stats *stats)
+{
+	int ret;
+	FILE *in = export_stream(text);
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(in);
+	ret = safeword_import(db1, in, SAFEWORD_IMPORT_KEEPASS_CSV, stats);
+	fclose(in);
+
+	return ret;
+}
+
+static long int credentials_count(void)
+{
+	long int count = -1;
+	sqlite3_stmt *stmt;
+
+	if (sqlite3_prepare_v2(db1->handle, "SELECT count(*) FROM credentials;", -1, &stmt, NULL) == SQLITE_OK) {
+		if (sqlite3_step(stmt) == SQLITE_ROW)
+			count = sqlite3_column_int64(stmt, 0);
+		sqlite3_finalize(stmt);
+	}
+	return count;
+}
+
+#define CU_ASSERT_CREDENTIAL(ID, USERNAME, PASSWORD, DESCRIPTION) do {          \
+	memset(&credential, 0, sizeof(credential));                             \
+	credential.id = (ID);                                                   \
+	CU_ASSERT_FATAL(safeword_credential_read(db1, &credential) == 0);       \
+	CU_ASSERT_PTR_NOT_NULL_FATAL(credential.username);                      \
+	CU_ASSERT_PTR_NOT_NULL_FATAL(credential.password);                      \
+	CU_ASSERT_PTR_NOT_NULL_FATAL(credential.description);                   \
+	CU_ASSERT_STRING_EQUAL(credential.username, USERNAME);                  \
+	CU_ASSERT_STRING_EQUAL(credential.password, PASSWORD);                  \
+	CU_ASSERT_STRING_EQUAL(credential.description, DESCRIPTION);            \
+} while (0)
+
+void test_safeword_import_null(void)
+{
+	int ret;
+	FILE *in = export_stream("\"Account\",\"Login Name\",\"Password\"\n");
+
+	CU_ASSERT_PTR_NOT_NULL_FATAL(in);
+
+	ret = safeword_import(NULL, in, SAFEWORD_IMPORT_KEEPASS_CSV, NULL);
+	CU_ASSERT(ret == -1);
+	CU_ASSERT(safeword_errno == ESAFEWORD_INVARG);
+
+	ret = safeword_import(db1, NULL, SAFEWORD_IMPORT_KEEPASS_CSV, NULL);
+	CU_ASSERT(ret == -1);
+	CU_ASSERT(safeword_errno == ESAFEWORD_INVARG);
+
+	ret = safeword_import(db1, in, -1, NULL);
+	CU_ASSERT(ret == -1);
+	CU_ASSERT(safeword_errno == ESAFEWORD_INVARG);
+
+	/* only the header, nothing to import */
+	ret = safeword_import(db1, in, SAFEWORD_IMPORT_KEEPASS_CSV, NULL);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(credentials_count() == 0);
+
+	fclose(in);
+}
+
+void test_safeword_import_keepass(void)
+{
+	int ret;
+	struct safeword_credential credential;
+	struct safeword_import_stats stats;
+
+	/* KeePass 1.x, with CRLF line ends, a byte order mark and a blank line */
+	ret = import_text("\xEF\xBB\xBF"
+		"\"Account\",\"Login Name\",\"Password\",\"Web Site\",\"Comments\"\r\n"
+		"\"Tesla, Nikola\",\"nikola\",\"alternating \"\"current\"\"\",\"\",\"\"\r\n"
+		"\r\n"
+		"\"Edison\",\"thomas\",\"direct,current\",\"http://ge.com\",\"patents\r\npending\"\r\n",
+		&stats);
+	CU_ASSERT_FATAL(ret == 0);
+	CU_ASSERT(stats.imported == 2);
+	CU_ASSERT(stats.line == 4);
+	CU_ASSERT(credentials_count() == 2);
+
+	CU_ASSERT_CREDENTIAL(1, "nikola", "alternating \"current\"", "Tesla, Nikola");
+	CU_ASSERT(credential.tags_size == 0);
+	safeword_credential_free(&credential);
+
+	CU_ASSERT_CREDENTIAL(2, "thomas", "direct,current", "Edison");
+	safeword_credential_free(&credential);
+
+	/* bytes only starting like a byte order mark are kept in the first field */
+	ret = import_text("\xEF\xBB,Title,Username,Password\n"
+		",Faraday,michael,induction\n",
+		&stats);
+	CU_ASSERT_FATAL(ret == 0);
+	CU_ASSERT(stats.imported == 1);
+
+	CU_ASSERT_CREDENTIAL(3, "michael", "induction", "Faraday");
+	safeword_credential_free(&credential);
+}
+
+void test_safeword_import_keepassx(void)
+{
+	int i, ret;
+	struct safeword_credential credential;
+	struct safeword_import_stats stats;
+
+	/* KeePassX, whose columns come in another order, unquoted and a group path */
+	ret = import_text("Group,Title,Username,Password,URL,Notes\n"
+		"Internet/Email,Gmail,nikola@gmail.com,tower,,\n"
+		"Email,Outlook,tesla@outlook.com,coil\n",
+		&stats);
+	CU_ASSERT_FATAL(ret == 0);
+	CU_ASSERT(stats.imported == 2);
+
+	CU_ASSERT_CREDENTIAL(4, "nikola@gmail.com", "tower", "Gmail");
+	CU_ASSERT_FATAL(credential.tags_size == 2);
+	for (i = 0; i < credential.tags_size; i++)
+		CU_ASSERT(!strcmp(credential.tags[i], "Internet") || !strcmp(credential.tags[i], "Email"));
+	safeword_credential_free(&credential);
+
+	/* the existing tag is reused */
+	CU_ASSERT_CREDENTIAL(5, "tesla@outlook.com", "coil", "Outlook");
+	CU_ASSERT_FATAL(credential.tags_size == 1);
+	CU_ASSERT_STRING_EQUAL(credential.tags[0], "Email");
+	safeword_credential_free(&credential);
+}
+
+void test_safeword_import_malformed(void)
+{
+	int ret;
+	long int count = credentials_count();
+	struct safeword_import_stats stats;
+
+	/* empty */
+	ret = import_text("", &stats);
+	CU_ASSERT(ret == -1);
+	CU_ASSERT(safeword_errno == ESAFEWORD_FORMAT);
+
+	/* no column to import */
+	ret = import_text("\"Web Site\",\"Comments\"\n\"http://ge.com\",\"\"\n", &stats);
+	CU_ASSERT(ret == -1);
+	CU_ASSERT(safeword_errno == ESAFEWORD_FORMAT);
+
+	/* a quote left open, the whole batch is rolled back */
+	ret = import_text("Title,Username,Password\n"
+		"Westinghouse,george,airbrake\n"
+		"\"Marconi,guglielmo,radio\n",
+		&stats);
+	CU_ASSERT(ret == -1);
+	CU_ASSERT(safeword_errno == ESAFEWORD_FORMAT);
+	CU_ASSERT(stats.imported == 0);
+	CU_ASSERT(stats.line == 3);
+	CU_ASSERT(credentials_count() == count);
+}
+
+void test_safeword_import_batches(void)
+{
+	int i, ret;
+	size_t size = 0;
+	char *text, *line;
+	long int count = credentials_count();
+	struct safeword_import_stats stats;
+	/* more than a batch, so one is committed before the next starts */
+	const int records = SAFEWORD_IMPORT_BATCH + 1;
+
+	text = calloc(records + 1, 64);
+	CU_ASSERT_PTR_NOT_NULL_FATAL(text);
+	size += sprintf(text, "Title,Username,Password,Group\n");
+	for (i = 0; i < records; i++) {
+		line = text + size;
+		size += sprintf(line, "Site %d,user%d,password%d,Batch\n", i, i, i);
+	}
+
+	ret = import_text(text, &stats);
+	free(text);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(stats.imported == (unsigned int) records);
+	CU_ASSERT(credentials_count() == count + records);
+}
+
+CU_TestInfo tests_import[] = {
+	{ "test_safeword_import_null", test_safeword_import_null },
+	{ "test_safeword_import_keepass", test_safeword_import_keepass },
+	{ "test_safeword_import_keepassx", test_safeword_import_keepassx },
+	{ "test_safeword_import_malformed", test_safeword_import_malformed },
+	{ "test_safeword_import_batches", test_safeword_import_batches },
+	CU_TEST_INFO_NULL,
+};
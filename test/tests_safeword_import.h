@@ -0,0 +1,13 @@
+#ifndef TESTS_SAFEWORD_IMPORT_H
+#define TESTS_SAFEWORD_IMPORT_H
+
+#include <CUnit/Basic.h>
+
+void test_safeword_import_null(void);
+void test_safeword_import_keepass(void);
+void test_safeword_import_keepassx(void);
+void test_safeword_import_malformed(void);
+void test_safeword_import_batches(void);
+extern CU_TestInfo tests_import[];
+
+#endif /* TESTS_SAFEWORD_IMPORT_H */
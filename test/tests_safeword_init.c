@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <safeword.h>
@@ -30,7 +31,79 @@ void test_safeword_no_overwrite(void)
 	CU_ASSERT(ret == 0);
 }
 
+static int count_credentials(struct safeword_db *db)
+{
+	int count = -1;
+	sqlite3_stmt *stmt;
+
+	if (sqlite3_prepare_v2(db->handle, "SELECT count(*) FROM credentials;", -1, &stmt, NULL) != SQLITE_OK)
+		return -1;
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		count = sqlite3_column_int(stmt, 0);
+	sqlite3_finalize(stmt);
+
+	return count;
+}
+
+void test_safeword_open_memory(void)
+{
+	const char path[] = "memory.safeword";
+	char memory[64], memory_save[64];
+	struct safeword_db db;
+	struct safeword_credential credential;
+	int ret;
+
+	sprintf(memory, SAFEWORD_MEMORY_PREFIX "%s", path);
+	sprintf(memory_save, SAFEWORD_MEMORY_SAVE_PREFIX "%s", path);
+	memset(&credential, 0, sizeof(credential));
+	credential.username = "memory";
+	credential.password = "secret";
+
+	/* An empty vault needs no file at all. */
+	ret = safeword_open(&db, SAFEWORD_MEMORY);
+	CU_ASSERT_FATAL(ret == 0);
+	CU_ASSERT(safeword_schema_version(&db) == SAFEWORD_SCHEMA_VERSION);
+	CU_ASSERT(safeword_credential_add(&db, &credential) == 0);
+	CU_ASSERT(count_credentials(&db) == 1);
+	CU_ASSERT(safeword_close(&db) == 0);
+	CU_ASSERT(access(SAFEWORD_MEMORY, F_OK) == -1);
+
+	/* Loading a file that does not exist fails like opening it does. */
+	ret = safeword_open(&db, memory);
+	CU_ASSERT(ret == -1);
+	CU_ASSERT(safeword_errno == ESAFEWORD_DBEXIST);
+	safeword_close(&db);
+
+	CU_ASSERT_FATAL(safeword_init(path) == 0);
+
+	/* Changes to a loaded vault are discarded. */
+	ret = safeword_open(&db, memory);
+	CU_ASSERT_FATAL(ret == 0);
+	CU_ASSERT(safeword_credential_add(&db, &credential) == 0);
+	CU_ASSERT(count_credentials(&db) == 1);
+	CU_ASSERT(safeword_close(&db) == 0);
+
+	ret = safeword_open(&db, path);
+	CU_ASSERT_FATAL(ret == 0);
+	CU_ASSERT(count_credentials(&db) == 0);
+	CU_ASSERT(safeword_close(&db) == 0);
+
+	/* Unless the vault is saved on close. */
+	ret = safeword_open(&db, memory_save);
+	CU_ASSERT_FATAL(ret == 0);
+	CU_ASSERT(safeword_credential_add(&db, &credential) == 0);
+	CU_ASSERT(safeword_close(&db) == 0);
+
+	ret = safeword_open(&db, path);
+	CU_ASSERT_FATAL(ret == 0);
+	CU_ASSERT(count_credentials(&db) == 1);
+	CU_ASSERT(safeword_close(&db) == 0);
+
+	CU_ASSERT(remove(path) == 0);
+}
+
 CU_TestInfo tests_init[] = {
 	{ "test_safeword_no_overwrite", test_safeword_no_overwrite },
+	{ "test_safeword_open_memory", test_safeword_open_memory },
 	CU_TEST_INFO_NULL,
 };
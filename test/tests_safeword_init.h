@@ -4,6 +4,7 @@
 #include <CUnit/Basic.h>
 
 void test_safeword_no_overwrite(void);
+void test_safeword_open_memory(void);
 extern CU_TestInfo tests_init[];
 
 #endif /* TESTS_SAFEWORD_INIT_H */
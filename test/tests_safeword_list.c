@@ -1,3 +1,5 @@
+#include <limits.h>
+
 #include <safeword.h>
 
 #include "test.h"
@@ -64,6 +66,221 @@ void test_safeword_list_tags_filter(void)
 	}
 }
 
+static int count_credential(struct safeword_credential *credential, void *arg)
+{
+	(*(int*) arg)++;
+	return 0;
+}
+
+void test_safeword_list_tags_prefix(void)
+{
+	int ret;
+	unsigned int tags_size;
+	char **tags;
+	const char *env[] = { "ENV:*" };
+	const char *namespaces[] = { "env:", "team:" };
+	const char *shared[] = { "www", "team:" };
+
+	ret = safeword_list_tags(db1, &tags_size, &tags, 1, env);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(tags_size == 2);
+	safeword_tags_free(tags_size, tags);
+
+	/* prefixes are alternatives */
+	ret = safeword_list_tags(db1, &tags_size, &tags, 2, namespaces);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(tags_size == 4);
+	safeword_tags_free(tags_size, tags);
+
+	/* team tags sharing a credential with www */
+	ret = safeword_list_tags(db1, &tags_size, &tags, 2, shared);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(tags_size == 1);
+	if (tags_size == 1)
+		CU_ASSERT_STRING_EQUAL(tags[0], "team:web");
+	safeword_tags_free(tags_size, tags);
+}
+
+void test_safeword_list_namespaces(void)
+{
+	int ret;
+	unsigned int namespaces_size;
+	char **namespaces;
+
+	ret = safeword_list_namespaces(NULL, &namespaces_size, &namespaces);
+	CU_ASSERT(ret != 0);
+
+	ret = safeword_list_namespaces(db1, &namespaces_size, &namespaces);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(namespaces_size == 2);
+	if (namespaces_size == 2) {
+		CU_ASSERT_STRING_EQUAL(namespaces[0], "env");
+		CU_ASSERT_STRING_EQUAL(namespaces[1], "team");
+	}
+	safeword_tags_free(namespaces_size, namespaces);
+}
+
+void test_safeword_list_credentials_prefix(void)
+{
+	int ret, count;
+	char *env[] = { "env:*" };
+	char *env_www[] = { "env:", "www" };
+	char *upper_www[] = { "ENV:", "WWW" };
+	char *quoted[] = { "o'brien" };
+
+	count = 0;
+	ret = safeword_list_credentials_foreach(db1, 1, env, count_credential, &count);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(count == 2);
+
+	count = 0;
+	ret = safeword_list_credentials_foreach(db1, 2, env_www, count_credential, &count);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(count == 1);
+
+	/* exact tags ignore case like the prefixes and the tag filters do */
+	count = 0;
+	ret = safeword_list_credentials_foreach(db1, 2, upper_www, count_credential, &count);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(count == 1);
+
+	/* tags are bound, not pasted into the query */
+	count = 0;
+	ret = safeword_list_credentials_foreach(db1, 1, quoted, count_credential, &count);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(count == 1);
+}
+
+void test_safeword_list_credentials_untagged(void)
+{
+	int ret, count;
+	struct safeword_credential *untagged;
+
+	/* every credential of the suite is tagged */
+	count = 0;
+	ret = safeword_list_credentials_foreach(db1, 0, NULL, count_credential, &count);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(count == 0);
+
+	untagged = safeword_credential_create("untagged", "u", "untagged");
+	CU_ASSERT_FATAL(untagged != NULL);
+	CU_ASSERT(safeword_credential_add(db1, untagged) == 0);
+	count = 0;
+	safeword_list_credentials_foreach(db1, 0, NULL, count_credential, &count);
+	CU_ASSERT(count == 1);
+
+	safeword_credential_tag(db1, untagged->id, "www");
+	count = 0;
+	safeword_list_credentials_foreach(db1, 0, NULL, count_credential, &count);
+	CU_ASSERT(count == 0);
+
+	safeword_credential_untag(db1, untagged->id, "www");
+	count = 0;
+	safeword_list_credentials_foreach(db1, 0, NULL, count_credential, &count);
+	CU_ASSERT(count == 1);
+
+	safeword_credential_delete(db1, untagged->id);
+	safeword_credential_free(untagged);
+}
+
+struct page {
+	int size;
+	long int ids[16];
+};
+
+static int collect_credential(struct safeword_credential *credential, void *arg)
+{
+	struct page *page = arg;
+
+	if (page->size < 16)
+		page->ids[page->size] = credential->id;
+	page->size++;
+	return 0;
+}
+
+/* walk every credential in pages of one, resuming after the last id */
+static int walk_pages(int sort, struct page *walked)
+{
+	int ret;
+	struct page page;
+	struct safeword_list_options options = { .limit = 1, .sort = sort };
+
+	walked->size = 0;
+	do {
+		page.size = 0;
+		ret = safeword_list_credentials_page(db1, UINT_MAX, NULL, &options, collect_credential, &page);
+		if (ret || page.size > 1)
+			return -1;
+		if (page.size) {
+			walked->ids[walked->size++] = page.ids[0];
+			options.after_id = page.ids[0];
+		}
+	} while (page.size && walked->size < 16);
+	return 0;
+}
+
+void test_safeword_list_credentials_page(void)
+{
+	int ret, i;
+	struct page all, walked, page;
+	struct safeword_credential *named[3];
+	const char *descriptions[] = { "b", "a", "b" };
+	struct safeword_list_options options = { .sort = SAFEWORD_SORT_DESCRIPTION };
+
+	ret = safeword_list_credentials_page(NULL, 0, NULL, NULL, collect_credential, &page);
+	CU_ASSERT(ret != 0);
+
+	for (i = 0; i < 3; i++) {
+		named[i] = safeword_credential_create("named", "n", descriptions[i]);
+		CU_ASSERT_FATAL(named[i] != NULL);
+		CU_ASSERT(safeword_credential_add(db1, named[i]) == 0);
+	}
+
+	/* by id, the pages add up to the whole listing */
+	all.size = 0;
+	ret = safeword_list_credentials_page(db1, UINT_MAX, NULL, NULL, collect_credential, &all);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(all.size == 7);
+	CU_ASSERT(walk_pages(SAFEWORD_SORT_ID, &walked) == 0);
+	CU_ASSERT_FATAL(walked.size == all.size);
+	for (i = 0; i < all.size; i++)
+		CU_ASSERT(walked.ids[i] == all.ids[i]);
+
+	/* by description, NULL descriptions first, then ties by id */
+	CU_ASSERT(walk_pages(SAFEWORD_SORT_DESCRIPTION, &walked) == 0);
+	CU_ASSERT_FATAL(walked.size == 7);
+	for (i = 0; i < 4; i++)
+		CU_ASSERT(walked.ids[i] == all.ids[i]);
+	CU_ASSERT(walked.ids[4] == named[1]->id);
+	CU_ASSERT(walked.ids[5] == named[0]->id);
+	CU_ASSERT(walked.ids[6] == named[2]->id);
+
+	/* a description on its own resumes after every credential with it */
+	page.size = 0;
+	options.after_description = "a";
+	ret = safeword_list_credentials_page(db1, UINT_MAX, NULL, &options, collect_credential, &page);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(page.size == 2);
+	CU_ASSERT(page.ids[0] == named[0]->id);
+
+	/* a limit bounds a page that crosses from NULL descriptions into the rest */
+	page.size = 0;
+	options.after_description = NULL;
+	options.after_id = all.ids[2];
+	options.limit = 3;
+	ret = safeword_list_credentials_page(db1, UINT_MAX, NULL, &options, collect_credential, &page);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT_FATAL(page.size == 3);
+	CU_ASSERT(page.ids[0] == all.ids[3]);
+	CU_ASSERT(page.ids[1] == named[1]->id);
+	CU_ASSERT(page.ids[2] == named[0]->id);
+
+	for (i = 0; i < 3; i++) {
+		safeword_credential_delete(db1, named[i]->id);
+		safeword_credential_free(named[i]);
+	}
+}
+
 CU_TestInfo tests_list_null[] = {
 	{ "test_safeword_list_null_db", test_safeword_list_null_db },
 	CU_TEST_INFO_NULL,
@@ -73,6 +290,14 @@ CU_TestInfo tests_list_tags[] = {
 	{ "test_safeword_list_tags_filter", test_safeword_list_tags_filter },
 	CU_TEST_INFO_NULL,
 };
+CU_TestInfo tests_list_namespaces[] = {
+	{ "test_safeword_list_tags_prefix", test_safeword_list_tags_prefix },
+	{ "test_safeword_list_namespaces", test_safeword_list_namespaces },
+	{ "test_safeword_list_credentials_prefix", test_safeword_list_credentials_prefix },
+	{ "test_safeword_list_credentials_untagged", test_safeword_list_credentials_untagged },
+	{ "test_safeword_list_credentials_page", test_safeword_list_credentials_page },
+	CU_TEST_INFO_NULL,
+};
 
 int suite_safeword_list_init(void)
 {
@@ -130,3 +355,29 @@ int suite_safeword_list_init(void)
 	}
 	return 0;
 }
+
+int suite_safeword_list_namespace_init(void)
+{
+	int i, j, ret;
+	static char *prod_tags[] = { "env:prod", "www" };
+	static char *dev_tags[] = { "Env:Dev", "team:db" };
+	static char *web_tags[] = { "team:web", "www" };
+	static char *quoted_tags[] = { "o'brien" };
+	static struct safeword_credential servers[] = {
+		{ .username = "prod", .password = "p", .tags_size = 2, .tags = prod_tags },
+		{ .username = "dev", .password = "d", .tags_size = 2, .tags = dev_tags },
+		{ .username = "web", .password = "w", .tags_size = 2, .tags = web_tags },
+		{ .username = "obrien", .password = "o", .tags_size = 1, .tags = quoted_tags },
+	};
+	const unsigned int SERVERS_SIZE = sizeof(servers) / sizeof(servers[0]);
+
+	ret = suite_safeword_init();
+	if (ret) return -1;
+
+	for (i = 0; i < SERVERS_SIZE; i++) {
+		safeword_credential_add(db1, &servers[i]);
+		for (j = 0; j < servers[i].tags_size; j++)
+			safeword_credential_tag(db1, servers[i].id, servers[i].tags[j]);
+	}
+	return 0;
+}
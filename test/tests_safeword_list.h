@@ -4,10 +4,17 @@
 #include <CUnit/Basic.h>
 
 int suite_safeword_list_init(void);
+int suite_safeword_list_namespace_init(void);
 void test_safeword_list_null_db(void);
 void test_safeword_list_tags_all(void);
 void test_safeword_list_tags_filter(void);
+void test_safeword_list_tags_prefix(void);
+void test_safeword_list_namespaces(void);
+void test_safeword_list_credentials_prefix(void);
+void test_safeword_list_credentials_untagged(void);
+void test_safeword_list_credentials_page(void);
 extern CU_TestInfo tests_list_null[];
 extern CU_TestInfo tests_list_tags[];
+extern CU_TestInfo tests_list_namespaces[];
 
 #endif /* TESTS_SAFEWORD_LIST_H */
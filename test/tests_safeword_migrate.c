@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <safeword.h>
+
+#include "test.h"
+#include "tests_safeword_migrate.h"
+
+static const char legacy_path[] = "legacy.safeword";
+static const int LEGACY_ROWS = 2500;
+
+struct progress {
+	int calls;
+	int cancel_after;
+	long int done;
+	long int total;
+};
+
+static int count_progress(int version, long int done, long int total, void *arg)
+{
+	struct progress *progress = (struct progress*) arg;
+
+	progress->calls++;
+	progress->done = done;
+	progress->total = total;
+	return progress->cancel_after && progress->calls >= progress->cancel_after;
+}
+
+/* insert text the way older versions did, including its NUL terminator */
+static int insert_legacy(sqlite3 *handle, const char *sql, const char *text)
+{
+	int ret;
+	sqlite3_stmt *stmt = NULL;
+
+	ret = sqlite3_prepare_v2(handle, sql, -1, &stmt, NULL);
+	if (ret == SQLITE_OK)
+		ret = sqlite3_bind_text(stmt, 1, text, strlen(text) + 1, SQLITE_STATIC);
+	if (ret == SQLITE_OK)
+		ret = sqlite3_step(stmt);
+	sqlite3_finalize(stmt);
+
+	return ret == SQLITE_DONE ? 0 : -1;
+}
+
+static int count(sqlite3 *handle, const char *sql)
+{
+	int rows = -1;
+	sqlite3_stmt *stmt = NULL;
+
+	if (sqlite3_prepare_v2(handle, sql, -1, &stmt, NULL) == SQLITE_OK &&
+			sqlite3_step(stmt) == SQLITE_ROW)
+		rows = sqlite3_column_int(stmt, 0);
+	sqlite3_finalize(stmt);
+
+	return rows;
+}
+
+/* a schema version 0 vault as written before migrations existed */
+int suite_safeword_migrate_init(void)
+{
+	int i, ret = 0;
+	char text[32];
+	sqlite3 *handle;
+
+	remove(legacy_path);
+	if (sqlite3_open(legacy_path, &handle) != SQLITE_OK)
+		return -1;
+
+	ret |= sqlite3_exec(handle,
+		"CREATE TABLE tags (id INTEGER PRIMARY KEY, tag TEXT NOT NULL, wiki TEXT, "
+			"UNIQUE (tag) ON CONFLICT ABORT, CONSTRAINT no_empty_tag CHECK (tag != ''));"
+		"CREATE TABLE usernames (id INTEGER PRIMARY KEY, username TEXT, "
+			"UNIQUE (username) ON CONFLICT ABORT);"
+		"CREATE TABLE passwords (id INTEGER PRIMARY KEY, password TEXT, "
+			"UNIQUE (password) ON CONFLICT ABORT);"
+		"CREATE TABLE credentials (id INTEGER PRIMARY KEY, "
+			"usernameid INTEGER REFERENCES usernames(id), "
+			"passwordid INTEGER REFERENCES passwords(id), description TEXT);"
+		"CREATE TABLE tagged_credentials ("
+			"credentialid INTEGER NOT NULL REFERENCES credentials(id) ON DELETE CASCADE, "
+			"tagid INTEGER NOT NULL REFERENCES tags(id) ON DELETE CASCADE, "
+			"PRIMARY KEY (credentialid, tagid));"
+		"CREATE TABLE properties (key TEXT PRIMARY KEY NOT NULL, value TEXT);"
+		"INSERT INTO properties VALUES ('version' || char(0), '0.1.0' || char(0));"
+		"BEGIN;", 0, 0, 0);
+
+	for (i = 1; i <= LEGACY_ROWS; i++) {
+		sprintf(text, "user%d", i);
+		ret |= insert_legacy(handle, "INSERT INTO usernames (username) VALUES (?);", text);
+		sprintf(text, "password%d", i);
+		ret |= insert_legacy(handle, "INSERT INTO passwords (password) VALUES (?);", text);
+		sprintf(text, "description%d", i);
+		ret |= insert_legacy(handle, "INSERT INTO credentials (usernameid, passwordid, description) "
+			"VALUES (last_insert_rowid(), last_insert_rowid(), ?);", text);
+	}
+	ret |= insert_legacy(handle, "INSERT INTO tags (tag) VALUES (?);", "www");
+	ret |= insert_legacy(handle, "INSERT INTO tags (tag, wiki) VALUES (?, 'legacy wiki');", "email");
+	/* clean duplicates of legacy values, as a newer client could have added */
+	ret |= sqlite3_exec(handle,
+		"INSERT INTO usernames (id, username) VALUES (5000, 'user1');"
+		"INSERT INTO credentials (id, usernameid, passwordid, description) VALUES (5000, 5000, 1, 'new');"
+		"INSERT INTO tags (id, tag) VALUES (100, 'email');"
+		"INSERT INTO tagged_credentials VALUES (1, 1);"
+		"INSERT INTO tagged_credentials VALUES (1, 2);"
+		"INSERT INTO tagged_credentials VALUES (2, 2);"
+		"INSERT INTO tagged_credentials VALUES (2, 100);"
+		"INSERT INTO tagged_credentials VALUES (5000, 100);"
+		"COMMIT;", 0, 0, 0);
+	sqlite3_close(handle);
+
+	return ret ? -1 : 0;
+}
+
+int suite_safeword_migrate_clean(void)
+{
+	return remove(legacy_path) ? -1 : 0;
+}
+
+void test_safeword_migrate_null(void)
+{
+	int ret;
+
+	ret = safeword_migrate(NULL, 0, NULL, NULL);
+	CU_ASSERT(ret == -1);
+	ret = safeword_schema_version(NULL);
+	CU_ASSERT(ret == -1);
+}
+
+void test_safeword_migrate_init(void)
+{
+	struct safeword_db db;
+	int ret;
+
+	remove("migrate.safeword");
+	ret = safeword_init("migrate.safeword");
+	CU_ASSERT(ret == 0);
+	ret = safeword_open(&db, "migrate.safeword");
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(safeword_schema_version(&db) == SAFEWORD_SCHEMA_VERSION);
+	/* already current, nothing to report */
+	ret = safeword_migrate(&db, 0, count_progress, NULL);
+	CU_ASSERT(ret == 0);
+	safeword_close(&db);
+	remove("migrate.safeword");
+}
+
+void test_safeword_migrate_legacy(void)
+{
+	int ret;
+	struct safeword_db db;
+	struct safeword_credential credential;
+	struct progress progress;
+	unsigned int tags_size;
+	char **tags;
+	const char *filter[] = { "www" };
+
+	ret = sqlite3_open(legacy_path, &db.handle);
+	CU_ASSERT_FATAL(ret == SQLITE_OK);
+	db.path = NULL;
+	sqlite3_exec(db.handle, "PRAGMA foreign_keys = ON;", 0, 0, 0);
+	CU_ASSERT(safeword_schema_version(&db) == 0);
+
+	/* interrupt part way through, the committed chunks stay applied */
+	memset(&progress, 0, sizeof(progress));
+	progress.cancel_after = 10;
+	ret = safeword_migrate(&db, 100, count_progress, &progress);
+	CU_ASSERT(ret == -1);
+	CU_ASSERT(safeword_errno == ESAFEWORD_CANCELED);
+	CU_ASSERT(progress.calls == 10);
+	CU_ASSERT(progress.done > 0 && progress.done < progress.total);
+	CU_ASSERT(safeword_schema_version(&db) == 0);
+	CU_ASSERT(count(db.handle, "SELECT count(*) FROM usernames "
+		"WHERE substr(CAST(username AS BLOB), -1) = x'00';") < LEGACY_ROWS);
+
+	/* resume where it stopped */
+	memset(&progress, 0, sizeof(progress));
+	ret = safeword_migrate(&db, 100, count_progress, &progress);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(progress.calls > 0);
+	CU_ASSERT(progress.done == progress.total);
+	CU_ASSERT(safeword_schema_version(&db) == SAFEWORD_SCHEMA_VERSION);
+	sqlite3_close(db.handle);
+
+	ret = safeword_open(&db, legacy_path);
+	CU_ASSERT_FATAL(ret == 0);
+	CU_ASSERT(count(db.handle, "SELECT count(*) FROM usernames "
+		"WHERE substr(CAST(username AS BLOB), -1) = x'00';") == 0);
+	CU_ASSERT(count(db.handle, "SELECT count(*) FROM properties;") == 1);
+	/* the legacy 'user1' was merged into the clean one */
+	CU_ASSERT(count(db.handle, "SELECT count(*) FROM usernames WHERE username = 'user1';") == 1);
+	CU_ASSERT(count(db.handle, "SELECT count(*) FROM credentials WHERE usernameid = 5000;") == 2);
+	/* the legacy 'email' tag was merged, keeping its wiki */
+	CU_ASSERT(count(db.handle, "SELECT count(*) FROM tags;") == 2);
+	CU_ASSERT(count(db.handle, "SELECT count(*) FROM tags AS t "
+		"INNER JOIN tag_wikis AS w ON (w.tagid = t.id) "
+		"WHERE t.tag = 'email' AND w.wiki = 'legacy wiki';") == 1);
+	CU_ASSERT(count(db.handle, "SELECT count(*) FROM tags WHERE wiki IS NOT NULL;") == 0);
+	CU_ASSERT(count(db.handle, "SELECT count(*) FROM tagged_credentials WHERE tagid = 100;") == 3);
+	CU_ASSERT(count(db.handle, "SELECT count FROM tag_stats WHERE tag = 'email';") == 3);
+	CU_ASSERT(count(db.handle, "SELECT count FROM tag_stats WHERE tag = 'www';") == 1);
+	CU_ASSERT(count(db.handle, "SELECT tag_count FROM credentials WHERE id = 1;") == 2);
+	CU_ASSERT(count(db.handle, "SELECT count(*) FROM credentials WHERE tag_count = 0;") == LEGACY_ROWS - 2);
+
+	memset(&credential, 0, sizeof(credential));
+	credential.id = 42;
+	ret = safeword_credential_read(&db, &credential);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT_STRING_EQUAL(credential.username, "user42");
+	CU_ASSERT_STRING_EQUAL(credential.password, "password42");
+	CU_ASSERT_STRING_EQUAL(credential.description, "description42");
+	free(credential.username);
+	free(credential.password);
+	free(credential.description);
+
+	ret = safeword_list_tags(&db, &tags_size, &tags, 1, filter);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(tags_size == 1);
+	if (tags_size == 1)
+		CU_ASSERT_STRING_EQUAL(tags[0], "email");
+	safeword_tags_free(tags_size, tags);
+
+	safeword_close(&db);
+}
+
+void test_safeword_migrate_newer(void)
+{
+	struct safeword_db db;
+	int ret;
+
+	ret = sqlite3_open(legacy_path, &db.handle);
+	CU_ASSERT_FATAL(ret == SQLITE_OK);
+	sqlite3_exec(db.handle, "UPDATE properties SET value = '9999' WHERE key = 'version';", 0, 0, 0);
+	sqlite3_close(db.handle);
+
+	ret = safeword_open(&db, legacy_path);
+	CU_ASSERT(ret == -1);
+	CU_ASSERT(safeword_errno == ESAFEWORD_SCHEMA);
+	sqlite3_close(db.handle);
+	free(db.path);
+}
+
+CU_TestInfo tests_migrate_null[] = {
+	{ "test_safeword_migrate_null", test_safeword_migrate_null },
+	CU_TEST_INFO_NULL,
+};
+CU_TestInfo tests_migrate[] = {
+	{ "test_safeword_migrate_init", test_safeword_migrate_init },
+	{ "test_safeword_migrate_legacy", test_safeword_migrate_legacy },
+	{ "test_safeword_migrate_newer", test_safeword_migrate_newer },
+	CU_TEST_INFO_NULL,
+};
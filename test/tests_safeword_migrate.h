@@ -0,0 +1,15 @@
+#ifndef TESTS_SAFEWORD_MIGRATE_H
+#define TESTS_SAFEWORD_MIGRATE_H
+
+#include <CUnit/Basic.h>
+
+int suite_safeword_migrate_init(void);
+int suite_safeword_migrate_clean(void);
+void test_safeword_migrate_null(void);
+void test_safeword_migrate_init(void);
+void test_safeword_migrate_legacy(void);
+void test_safeword_migrate_newer(void);
+extern CU_TestInfo tests_migrate_null[];
+extern CU_TestInfo tests_migrate[];
+
+#endif /* TESTS_SAFEWORD_MIGRATE_H */
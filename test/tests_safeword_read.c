@@ -1,3 +1,6 @@
+#include <stdlib.h>
+#include <string.h>
+
 #include <safeword.h>
 
 #include "test.h"
@@ -81,6 +84,242 @@ void test_safeword_read_examples(void)
 	}
 }
 
+void test_safeword_read_cursor_examples(void)
+{
+	int i, j, ret;
+	size_t size;
+	const char *text;
+	struct safeword_cursor cursor;
+
+	for (i = 0; i < EXAMPLES_SIZE; i++) {
+		ret = safeword_cursor_credential(db1, &cursor, i + 1);
+		CU_ASSERT(ret == 0);
+		CU_ASSERT(safeword_cursor_next(&cursor) == 1);
+		CU_ASSERT(safeword_cursor_id(&cursor) == examples[i].id);
+
+		text = safeword_cursor_text(&cursor, SAFEWORD_FIELD_USERNAME, &size);
+		if (!examples[i].username)
+			CU_ASSERT(text == NULL);
+		else {
+			CU_ASSERT(size == strlen(examples[i].username));
+			CU_ASSERT(text && !strncmp(text, examples[i].username, size));
+		}
+		text = safeword_cursor_text(&cursor, SAFEWORD_FIELD_PASSWORD, &size);
+		if (!examples[i].password)
+			CU_ASSERT(text == NULL);
+		else {
+			CU_ASSERT(size == strlen(examples[i].password));
+			CU_ASSERT(text && !strncmp(text, examples[i].password, size));
+		}
+		/* tags are not a column of the credential row */
+		CU_ASSERT(safeword_cursor_text(&cursor, SAFEWORD_FIELD_TAGS, &size) == NULL);
+		CU_ASSERT(safeword_cursor_next(&cursor) == 0);
+		CU_ASSERT(safeword_cursor_close(&cursor) == 0);
+
+		ret = safeword_cursor_credential_tags(db1, &cursor, i + 1);
+		CU_ASSERT(ret == 0);
+		for (j = 0; safeword_cursor_next(&cursor) == 1; j++) {
+			text = safeword_cursor_text(&cursor, SAFEWORD_FIELD_TAGS, &size);
+			CU_ASSERT(j < examples[i].tags_size);
+			if (j < examples[i].tags_size)
+				CU_ASSERT(size == strlen(examples[i].tags[j]) &&
+					!strncmp(text, examples[i].tags[j], size));
+		}
+		CU_ASSERT(j == examples[i].tags_size);
+		CU_ASSERT(safeword_cursor_close(&cursor) == 0);
+	}
+}
+
+static int count_credential(struct safeword_credential *credential, void *arg)
+{
+	(*(int*) arg)++;
+	return 0;
+}
+
+static int access_count(long int credential_id)
+{
+	int count = -1;
+	sqlite3_stmt *stmt;
+
+	sqlite3_prepare_v2(db1->handle, "SELECT count FROM credential_access WHERE credentialid = ?;",
+		-1, &stmt, NULL);
+	sqlite3_bind_int64(stmt, 1, credential_id);
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		count = sqlite3_column_int(stmt, 0);
+	sqlite3_finalize(stmt);
+	return count;
+}
+
+void test_safeword_read_recent(void)
+{
+	int i, count, before;
+	struct safeword_cursor cursor;
+	struct safeword_credential credential;
+
+	/* the examples read above are only written when flushed */
+	count = 0;
+	CU_ASSERT(safeword_list_recent(db1, 0, count_credential, &count) == 0);
+	CU_ASSERT(count == 0);
+	CU_ASSERT(db1->accesses_size == EXAMPLES_SIZE);
+	CU_ASSERT(safeword_flush_accesses(db1) == 0);
+	CU_ASSERT(db1->accesses_size == 0);
+
+	count = 0;
+	CU_ASSERT(safeword_list_recent(db1, 0, count_credential, &count) == 0);
+	CU_ASSERT(count == EXAMPLES_SIZE);
+	count = 0;
+	CU_ASSERT(safeword_list_recent(db1, 2, count_credential, &count) == 0);
+	CU_ASSERT(count == 2);
+
+	/* repeated reads are coalesced into one pending access */
+	before = access_count(1);
+	CU_ASSERT(before > 0);
+	for (i = 0; i < 3; i++) {
+		CU_ASSERT(safeword_cursor_credential(db1, &cursor, 1) == 0);
+		CU_ASSERT(safeword_cursor_next(&cursor) == 1);
+		safeword_cursor_close(&cursor);
+	}
+	CU_ASSERT(db1->accesses_size == 1);
+	CU_ASSERT(safeword_flush_accesses(db1) == 0);
+	CU_ASSERT(access_count(1) == before + 3);
+
+	/* neither opening a cursor nor reading only the tags is an access */
+	CU_ASSERT(safeword_cursor_credential(db1, &cursor, 1) == 0);
+	safeword_cursor_close(&cursor);
+	memset(&credential, 0, sizeof(credential));
+	credential.id = 1;
+	CU_ASSERT(safeword_credential_read_fields(db1, &credential,
+		SAFEWORD_FIELD_DESCRIPTION | SAFEWORD_FIELD_TAGS) == 0);
+	safeword_credential_free(&credential);
+	CU_ASSERT(db1->accesses_size == 0);
+
+	/* reading a credential that does not exist records nothing */
+	CU_ASSERT(safeword_cursor_credential(db1, &cursor, 999) == 0);
+	safeword_cursor_close(&cursor);
+	CU_ASSERT(safeword_flush_accesses(db1) == 0);
+	CU_ASSERT(access_count(999) == -1);
+
+	CU_ASSERT(safeword_list_recent(NULL, 0, count_credential, &count) != 0);
+	CU_ASSERT(safeword_flush_accesses(NULL) != 0);
+}
+
+void test_safeword_cp_fields_invalid(void)
+{
+	int fields[SAFEWORD_CP_FIELDS_MAX + 1] = {
+		SAFEWORD_FIELD_USERNAME, SAFEWORD_FIELD_PASSWORD,
+	};
+
+	CU_ASSERT(safeword_cp_fields(db1, 1, NULL, 1, 0) != 0);
+	CU_ASSERT(safeword_cp_fields(db1, 1, fields, 0, 0) != 0);
+	CU_ASSERT(safeword_cp_fields(db1, 1, fields, SAFEWORD_CP_FIELDS_MAX + 1, 0) != 0);
+	CU_ASSERT(safeword_cp_fields(db1, 0, fields, 2, 0) != 0);
+	/* a credential that does not exist has nothing to copy */
+	CU_ASSERT(safeword_cp_fields(db1, 999, fields, 2, 0) == -1);
+	CU_ASSERT(safeword_errno == ESAFEWORD_NOCREDENTIAL);
+}
+
+static int same_text(const char *a, const char *b)
+{
+	return (!a && !b) || (a && b && !strcmp(a, b));
+}
+
+static int has_tag(struct safeword_credential *credential, const char *tag)
+{
+	unsigned int i;
+
+	for (i = 0; i < credential->tags_size; i++)
+		if (!strcmp(credential->tags[i], tag))
+			return 1;
+	return 0;
+}
+
+void test_safeword_read_many_examples(void)
+{
+	int ret;
+	unsigned int i, j, size = 1200;
+	long int *ids;
+	struct safeword_credential *many, one;
+
+	CU_ASSERT(safeword_credential_read_many(NULL, NULL, 0, NULL) != 0);
+	CU_ASSERT(safeword_credential_read_many(db1, NULL, 1, NULL) != 0);
+	CU_ASSERT(safeword_credential_read_many(db1, NULL, 0, NULL) == 0);
+
+	/* backwards, across several chunks, mostly ids without a credential */
+	ids = calloc(size, sizeof(*ids));
+	many = calloc(size, sizeof(*many));
+	CU_ASSERT_FATAL(ids && many);
+	for (i = 0; i < size; i++)
+		ids[i] = size - i;
+	/* a repeated id is read once */
+	ids[0] = 1;
+
+	CU_ASSERT(safeword_flush_accesses(db1) == 0);
+	ret = safeword_credential_read_many(db1, ids, size, many);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(many[0].id == 1);
+	/* every credential read is an access, the repeated one once */
+	CU_ASSERT(db1->accesses_size == EXAMPLES_SIZE);
+	for (i = 1; i < size; i++) {
+		memset(&one, 0, sizeof(one));
+		one.id = ids[i];
+		CU_ASSERT(safeword_credential_read(db1, &one) == 0);
+		if (ids[i] > EXAMPLES_SIZE || ids[i] == 1) {
+			CU_ASSERT(many[i].id == 0);
+			CU_ASSERT(many[i].username == NULL && many[i].tags == NULL);
+		} else {
+			CU_ASSERT(many[i].id == ids[i]);
+			CU_ASSERT(same_text(many[i].username, one.username));
+			CU_ASSERT(same_text(many[i].password, one.password));
+			CU_ASSERT(same_text(many[i].description, one.description));
+			CU_ASSERT(many[i].tags_size == one.tags_size);
+			for (j = 0; j < many[i].tags_size; j++)
+				CU_ASSERT(has_tag(&one, many[i].tags[j]));
+		}
+		safeword_credential_free(&one);
+		safeword_credential_free(&many[i]);
+	}
+	safeword_credential_free(&many[0]);
+
+	free(many);
+	free(ids);
+}
+
+void test_safeword_read_fields_examples(void)
+{
+	int i;
+	struct safeword_credential credential;
+
+	memset(&credential, 0, sizeof(credential));
+	credential.id = 1;
+	CU_ASSERT(safeword_credential_read_fields(db1, &credential, 0) != 0);
+	CU_ASSERT(safeword_credential_read_fields(db1, &credential, 0x10) != 0);
+
+	for (i = 0; i < EXAMPLES_SIZE; i++) {
+		memset(&credential, 0, sizeof(credential));
+		credential.id = i + 1;
+
+		CU_ASSERT(safeword_credential_read_fields(db1, &credential, SAFEWORD_FIELD_USERNAME) == 0);
+		CU_ASSERT(same_text(credential.username, examples[i].username));
+		CU_ASSERT(credential.password == NULL && credential.description == NULL);
+		CU_ASSERT(credential.tags == NULL && credential.tags_size == 0);
+
+		/* a field read before and not asked for again is dropped */
+		CU_ASSERT(safeword_credential_read_fields(db1, &credential,
+			SAFEWORD_FIELD_PASSWORD | SAFEWORD_FIELD_TAGS) == 0);
+		CU_ASSERT(credential.id == examples[i].id);
+		CU_ASSERT(credential.username == NULL && credential.description == NULL);
+		CU_ASSERT(same_text(credential.password, examples[i].password));
+		CU_ASSERT(credential.tags_size == examples[i].tags_size);
+		safeword_credential_free(&credential);
+	}
+
+	/* nothing is read for a credential that does not exist */
+	memset(&credential, 0, sizeof(credential));
+	credential.id = EXAMPLES_SIZE + 1;
+	CU_ASSERT(safeword_credential_read_fields(db1, &credential, SAFEWORD_FIELD_TAGS) == 0);
+	CU_ASSERT(credential.id == EXAMPLES_SIZE + 1 && credential.tags == NULL);
+}
+
 CU_TestInfo tests_read_null[] = {
 	{ "test_safeword_read_null_db", test_safeword_read_null_db },
 	CU_TEST_INFO_NULL,
@@ -88,5 +327,10 @@ CU_TestInfo tests_read_null[] = {
 CU_TestInfo tests_read_examples[] = {
 	{ "test_safeword_read_invalid_id", test_safeword_read_invalid_id },
 	{ "test_safeword_read_examples", test_safeword_read_examples },
+	{ "test_safeword_read_cursor_examples", test_safeword_read_cursor_examples },
+	{ "test_safeword_read_recent", test_safeword_read_recent },
+	{ "test_safeword_cp_fields_invalid", test_safeword_cp_fields_invalid },
+	{ "test_safeword_read_many_examples", test_safeword_read_many_examples },
+	{ "test_safeword_read_fields_examples", test_safeword_read_fields_examples },
 	CU_TEST_INFO_NULL,
 };
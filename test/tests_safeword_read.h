@@ -6,6 +6,11 @@
 void test_safeword_read_null_db(void);
 void test_safeword_read_invalid_id(void);
 void test_safeword_read_examples(void);
+void test_safeword_read_cursor_examples(void);
+void test_safeword_read_recent(void);
+void test_safeword_cp_fields_invalid(void);
+void test_safeword_read_many_examples(void);
+void test_safeword_read_fields_examples(void);
 extern CU_TestInfo tests_read_null[];
 extern CU_TestInfo tests_read_examples[];
 
@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <safeword.h>
+
+#include "test.h"
+#include "tests_safeword_sync.h"
+
+static const char laptop_path[] = "laptop.safeword";
+static const char bastion_path[] = "bastion.safeword";
+static struct safeword_db laptop, bastion;
+
+int suite_safeword_sync_init(void)
+{
+	if (safeword_init(laptop_path) || safeword_init(bastion_path))
+		return -1;
+	if (safeword_open(&laptop, laptop_path) || safeword_open(&bastion, bastion_path))
+		return -1;
+
+	return 0;
+}
+
+int suite_safeword_sync_clean(void)
+{
+	safeword_close(&laptop);
+	safeword_close(&bastion);
+	if (remove(laptop_path) || remove(bastion_path))
+		return -1;
+
+	return 0;
+}
+
+static int count(sqlite3 *handle, const char *sql)
+{
+	int n = -1;
+	sqlite3_stmt *stmt = NULL;
+
+	if (sqlite3_prepare_v2(handle, sql, -1, &stmt, NULL) == SQLITE_OK &&
+			sqlite3_step(stmt) == SQLITE_ROW)
+		n = sqlite3_column_int(stmt, 0);
+	sqlite3_finalize(stmt);
+
+	return n;
+}
+
+/* modification times are in milliseconds, keep changes apart */
+static void tick(void)
+{
+	usleep(5000);
+}
+
+void test_safeword_sync_null(void)
+{
+	int ret;
+
+	ret = safeword_sync(NULL, bastion_path, NULL);
+	CU_ASSERT(ret == -1);
+	CU_ASSERT(safeword_errno == ESAFEWORD_INVARG);
+
+	ret = safeword_sync(&laptop, NULL, NULL);
+	CU_ASSERT(ret == -1);
+	CU_ASSERT(safeword_errno == ESAFEWORD_INVARG);
+
+	/* the peer is attached, it has to be a file */
+	ret = safeword_sync(&laptop, SAFEWORD_MEMORY, NULL);
+	CU_ASSERT(ret == -1);
+	CU_ASSERT(safeword_errno == ESAFEWORD_INVARG);
+
+	ret = safeword_sync(&laptop, "missing.safeword", NULL);
+	CU_ASSERT(ret == -1);
+	CU_ASSERT(safeword_errno == ESAFEWORD_DBEXIST);
+	CU_ASSERT(access("missing.safeword", F_OK) == -1);
+}
+
+void test_safeword_sync_merge(void)
+{
+	struct safeword_credential alpha, beta;
+	struct safeword_sync_stats stats;
+
+	memset(&alpha, 0, sizeof(alpha));
+	alpha.username = "alpha";
+	alpha.password = "alpha secret";
+	alpha.description = "alpha";
+	memset(&beta, 0, sizeof(beta));
+	beta.username = "beta";
+	beta.password = "beta secret";
+	beta.description = "beta";
+
+	CU_ASSERT_FATAL(safeword_credential_add(&laptop, &alpha) == 0);
+	CU_ASSERT_FATAL(safeword_credential_add(&bastion, &beta) == 0);
+	CU_ASSERT(safeword_credential_tag(&bastion, beta.id, "www") == 0);
+
+	/* the bastion is changed through the attached file */
+	CU_ASSERT_FATAL(safeword_sync(&laptop, bastion_path, &stats) == 0);
+	CU_ASSERT(stats.sent == 1);
+	/* the credential, its tag and the tagging */
+	CU_ASSERT(stats.received == 3);
+	CU_ASSERT(stats.conflicts == 0);
+
+	CU_ASSERT(count(laptop.handle, "SELECT count(*) FROM credentials;") == 2);
+	CU_ASSERT(count(bastion.handle, "SELECT count(*) FROM credentials;") == 2);
+	CU_ASSERT(count(laptop.handle, "SELECT count(*) FROM credentials AS c "
+		"INNER JOIN usernames AS u ON (u.id = c.usernameid) "
+		"INNER JOIN passwords AS p ON (p.id = c.passwordid) "
+		"WHERE u.username = 'beta' AND p.password = 'beta secret' AND c.description = 'beta';") == 1);
+	CU_ASSERT(count(laptop.handle, "SELECT count(*) FROM tagged_credentials AS tc "
+		"INNER JOIN tags AS t ON (t.id = tc.tagid) WHERE t.tag = 'www';") == 1);
+	CU_ASSERT(count(laptop.handle, "SELECT count FROM tag_stats WHERE tag = 'www';") == 1);
+	CU_ASSERT(count(bastion.handle, "SELECT count(*) FROM credentials WHERE description = 'alpha';") == 1);
+
+	/* nothing changed since, nothing is exchanged */
+	CU_ASSERT_FATAL(safeword_sync(&laptop, bastion_path, &stats) == 0);
+	CU_ASSERT(stats.sent == 0);
+	CU_ASSERT(stats.received == 0);
+}
+
+void test_safeword_sync_conflict(void)
+{
+	struct safeword_credential edit;
+	struct safeword_sync_stats stats;
+	int id;
+
+	id = count(bastion.handle, "SELECT id FROM credentials WHERE description = 'alpha';");
+	memset(&edit, 0, sizeof(edit));
+	edit.id = id;
+	edit.description = "alpha from the bastion";
+	safeword_credential_update(&bastion, &edit);
+	tick();
+
+	id = count(laptop.handle, "SELECT id FROM credentials WHERE description = 'alpha';");
+	memset(&edit, 0, sizeof(edit));
+	edit.id = id;
+	edit.description = "alpha from the laptop";
+	edit.password = "new alpha secret";
+	safeword_credential_update(&laptop, &edit);
+
+	/* the later edit wins in both, only the edited row is exchanged */
+	CU_ASSERT_FATAL(safeword_sync(&bastion, laptop_path, &stats) == 0);
+	CU_ASSERT(stats.received == 1);
+	CU_ASSERT(stats.sent == 0);
+	CU_ASSERT(stats.conflicts == 1);
+	CU_ASSERT(count(bastion.handle, "SELECT count(*) FROM credentials AS c "
+		"INNER JOIN passwords AS p ON (p.id = c.passwordid) "
+		"WHERE c.description = 'alpha from the laptop' AND p.password = 'new alpha secret';") == 1);
+	CU_ASSERT(count(laptop.handle, "SELECT count(*) FROM credentials "
+		"WHERE description = 'alpha from the laptop';") == 1);
+	CU_ASSERT(count(bastion.handle, "SELECT count(*) FROM credentials;") == 2);
+}
+
+void test_safeword_sync_delete(void)
+{
+	struct safeword_sync_stats stats;
+	int id;
+
+	id = count(laptop.handle, "SELECT id FROM credentials WHERE description = 'beta';");
+	CU_ASSERT(safeword_credential_delete(&laptop, id) == 0);
+
+	CU_ASSERT_FATAL(safeword_sync(&laptop, bastion_path, &stats) == 0);
+	CU_ASSERT(stats.sent >= 1);
+	CU_ASSERT(stats.received == 0);
+	CU_ASSERT(count(bastion.handle, "SELECT count(*) FROM credentials WHERE description = 'beta';") == 0);
+	CU_ASSERT(count(bastion.handle, "SELECT count(*) FROM sync_tombstones WHERE kind = 'credential';") == 1);
+	CU_ASSERT(count(bastion.handle, "SELECT count FROM tag_stats WHERE tag = 'www';") == 0);
+
+	/* a deletion is a change like any other, it is exchanged once */
+	CU_ASSERT_FATAL(safeword_sync(&laptop, bastion_path, &stats) == 0);
+	CU_ASSERT(stats.sent == 0);
+	CU_ASSERT(stats.received == 0);
+}
+
+void test_safeword_sync_tags(void)
+{
+	struct safeword_sync_stats stats;
+	int id;
+
+	/* the same tag created in both is merged rather than duplicated */
+	id = count(laptop.handle, "SELECT id FROM credentials WHERE description LIKE 'alpha%';");
+	CU_ASSERT(safeword_credential_tag(&laptop, id, "email") == 0);
+	id = count(bastion.handle, "SELECT id FROM credentials WHERE description LIKE 'alpha%';");
+	CU_ASSERT(safeword_credential_tag(&bastion, id, "email") == 0);
+
+	CU_ASSERT_FATAL(safeword_sync(&laptop, bastion_path, &stats) == 0);
+	CU_ASSERT(count(laptop.handle, "SELECT count(*) FROM tags WHERE tag = 'email';") == 1);
+	CU_ASSERT(count(bastion.handle, "SELECT count(*) FROM tags WHERE tag = 'email';") == 1);
+	CU_ASSERT(count(laptop.handle, "SELECT count(*) FROM tagged_credentials AS tc "
+		"INNER JOIN tags AS t ON (t.id = tc.tagid) WHERE t.tag = 'email';") == 1);
+
+	/* and ends up with the same identity in both */
+	CU_ASSERT_FATAL(safeword_sync(&bastion, laptop_path, &stats) == 0);
+	CU_ASSERT(count(laptop.handle, "SELECT count(*) FROM tags WHERE tag = 'email';") == 1);
+	CU_ASSERT_FATAL(sqlite3_exec(laptop.handle, "ATTACH DATABASE 'bastion.safeword' AS b;", 0, 0, 0) == SQLITE_OK);
+	CU_ASSERT(count(laptop.handle, "SELECT count(*) FROM main.tags AS l "
+		"INNER JOIN b.tags AS r ON (r.uuid = l.uuid) WHERE l.tag = 'email';") == 1);
+	sqlite3_exec(laptop.handle, "DETACH DATABASE b;", 0, 0, 0);
+}
+
+void test_safeword_sync_copy(void)
+{
+	struct safeword_sync_stats stats;
+	struct safeword_backup_options options;
+	const char *copy_path = "copy.safeword";
+
+	memset(&options, 0, sizeof(options));
+	CU_ASSERT_FATAL(safeword_backup(&laptop, copy_path, &options) == 0);
+
+	/* the rows of a copy are the same changes, not conflicting ones */
+	CU_ASSERT_FATAL(safeword_sync(&laptop, copy_path, &stats) == 0);
+	CU_ASSERT(stats.sent == 0);
+	CU_ASSERT(stats.received == 0);
+	CU_ASSERT(stats.conflicts == 0);
+
+	remove(copy_path);
+}
+
+CU_TestInfo tests_sync[] = {
+	{ "test_safeword_sync_null", test_safeword_sync_null },
+	{ "test_safeword_sync_merge", test_safeword_sync_merge },
+	{ "test_safeword_sync_conflict", test_safeword_sync_conflict },
+	{ "test_safeword_sync_delete", test_safeword_sync_delete },
+	{ "test_safeword_sync_tags", test_safeword_sync_tags },
+	{ "test_safeword_sync_copy", test_safeword_sync_copy },
+	CU_TEST_INFO_NULL,
+};
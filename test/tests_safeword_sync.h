@@ -0,0 +1,17 @@
+#ifndef TESTS_SAFEWORD_SYNC_H
+#define TESTS_SAFEWORD_SYNC_H
+
+#include <CUnit/Basic.h>
+
+void test_safeword_sync_null(void);
+void test_safeword_sync_merge(void);
+void test_safeword_sync_conflict(void);
+void test_safeword_sync_delete(void);
+void test_safeword_sync_tags(void);
+void test_safeword_sync_copy(void);
+extern CU_TestInfo tests_sync[];
+
+int suite_safeword_sync_init(void);
+int suite_safeword_sync_clean(void);
+
+#endif /* TESTS_SAFEWORD_SYNC_H */
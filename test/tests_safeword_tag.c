@@ -1,4 +1,8 @@
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
 
 #include <safeword.h>
 
@@ -119,12 +123,261 @@ void test_safeword_tag_filter(void)
 	}
 }
 
+static unsigned int tag_count(const char *tag)
+{
+	int i, ret;
+	unsigned int count = UINT_MAX, stats_size;
+	struct safeword_tag_stats *stats;
+
+	ret = safeword_list_tag_stats(db1, &stats_size, &stats);
+	CU_ASSERT(ret == 0);
+	if (ret)
+		return count;
+	for (i = 0; i < stats_size; i++) {
+		if (!strcmp(stats[i].tag, tag))
+			count = stats[i].count;
+		/* sorted by use */
+		if (i)
+			CU_ASSERT(stats[i - 1].count >= stats[i].count);
+	}
+	safeword_tag_stats_free(stats_size, stats);
+
+	return count;
+}
+
+void test_safeword_tag_stats(void)
+{
+	int ret;
+	struct safeword_credential *first, *second;
+
+	first = safeword_credential_create("first", "1", "stats one");
+	second = safeword_credential_create("second", "2", "stats two");
+	CU_ASSERT_FATAL(first && second);
+	CU_ASSERT(safeword_credential_add(db1, first) == 0);
+	CU_ASSERT(safeword_credential_add(db1, second) == 0);
+
+	ret = safeword_credential_tag(db1, first->id, "stats:shared");
+	CU_ASSERT(ret == 0);
+	ret = safeword_credential_tag(db1, second->id, "stats:shared");
+	CU_ASSERT(ret == 0);
+	ret = safeword_credential_tag(db1, first->id, "stats:single");
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(tag_count("stats:shared") == 2);
+	CU_ASSERT(tag_count("stats:single") == 1);
+
+	/* tagging again does not count twice */
+	ret = safeword_credential_tag(db1, first->id, "stats:shared");
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(tag_count("stats:shared") == 2);
+
+	safeword_credential_untag(db1, second->id, "stats:shared");
+	CU_ASSERT(tag_count("stats:shared") == 1);
+
+	safeword_tag_rename(db1, "stats:single", "stats:renamed");
+	CU_ASSERT(tag_count("stats:single") == UINT_MAX);
+	CU_ASSERT(tag_count("stats:renamed") == 1);
+
+	/* removing the credential cascades to its mappings */
+	ret = safeword_credential_delete(db1, first->id);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(tag_count("stats:shared") == 0);
+	CU_ASSERT(tag_count("stats:renamed") == 0);
+
+	safeword_tag_delete(db1, "stats:shared");
+	CU_ASSERT(tag_count("stats:shared") == UINT_MAX);
+
+	safeword_credential_free(first);
+	safeword_credential_free(second);
+}
+
+void test_safeword_tag_wiki(void)
+{
+	int ret, fd[2];
+	size_t i, size = 5 * SAFEWORD_WIKI_CHUNK + 7;
+	char *wiki = malloc(size), *read_back = NULL;
+	FILE *in, *out, *pipe_in;
+	struct safeword_credential *owner;
+
+	CU_ASSERT_FATAL(wiki != NULL);
+	for (i = 0; i < size; i++)
+		wiki[i] = 'a' + i % 26;
+	owner = safeword_credential_create("wikiowner", "pw", "wiki test");
+	CU_ASSERT_FATAL(owner != NULL);
+	CU_ASSERT(safeword_credential_add(db1, owner) == 0);
+	CU_ASSERT(safeword_credential_tag(db1, owner->id, "wiki:streamed") == 0);
+
+	/* a tag without a wiki reads as empty */
+	out = tmpfile();
+	CU_ASSERT_FATAL(out != NULL);
+	ret = safeword_tag_wiki_read(db1, "wiki:streamed", out, &i);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(i == 0);
+	CU_ASSERT(ftell(out) == 0);
+
+	/* a wiki spanning several chunks comes back byte for byte */
+	in = tmpfile();
+	CU_ASSERT_FATAL(in != NULL);
+	CU_ASSERT(fwrite(wiki, 1, size, in) == size);
+	rewind(in);
+	ret = safeword_tag_wiki_write(db1, "wiki:streamed", in);
+	CU_ASSERT(ret == 0);
+	fclose(in);
+	ret = safeword_tag_wiki_read(db1, "wiki:streamed", out, &i);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(i == size);
+	rewind(out);
+	read_back = malloc(size);
+	CU_ASSERT_FATAL(read_back != NULL);
+	CU_ASSERT(fread(read_back, 1, size, out) == size);
+	CU_ASSERT(memcmp(wiki, read_back, size) == 0);
+	fclose(out);
+
+	/* input that cannot be measured up front, such as a pipe, is spooled */
+	CU_ASSERT_FATAL(pipe(fd) == 0);
+	CU_ASSERT(write(fd[1], "piped wiki", 10) == 10);
+	close(fd[1]);
+	pipe_in = fdopen(fd[0], "r");
+	CU_ASSERT_FATAL(pipe_in != NULL);
+	ret = safeword_tag_wiki_write(db1, "wiki:streamed", pipe_in);
+	CU_ASSERT(ret == 0);
+	fclose(pipe_in);
+	out = tmpfile();
+	CU_ASSERT_FATAL(out != NULL);
+	ret = safeword_tag_wiki_read(db1, "wiki:streamed", out, &i);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(i == 10);
+	rewind(out);
+	CU_ASSERT(fread(read_back, 1, 10, out) == 10);
+	CU_ASSERT(memcmp(read_back, "piped wiki", 10) == 0);
+	fclose(out);
+
+	/* the wiki goes away with its tag */
+	ret = safeword_tag_delete(db1, "wiki:streamed");
+	CU_ASSERT(ret == 0);
+	out = tmpfile();
+	CU_ASSERT_FATAL(out != NULL);
+	ret = safeword_tag_wiki_read(db1, "wiki:streamed", out, &i);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(i == 0);
+
+	/* only existing tags get a wiki */
+	ret = safeword_tag_wiki_write(db1, "wiki:missing", out);
+	CU_ASSERT(ret != 0);
+	fclose(out);
+
+	safeword_credential_free(owner);
+	free(read_back);
+	free(wiki);
+}
+
+/* bytes the wiki of @c tag takes in the database, -1 if it has none */
+static int stored_wiki_size(const char *tag)
+{
+	int size = -1;
+	sqlite3_stmt *stmt;
+
+	if (sqlite3_prepare_v2(db1->handle, "SELECT length(w.wiki) FROM tags AS t "
+		"INNER JOIN tag_wikis AS w ON (w.tagid = t.id) WHERE t.tag = ?;", -1, &stmt, NULL))
+		return -1;
+	sqlite3_bind_text(stmt, 1, tag, -1, SQLITE_STATIC);
+	if (sqlite3_step(stmt) == SQLITE_ROW)
+		size = sqlite3_column_int(stmt, 0);
+	sqlite3_finalize(stmt);
+
+	return size;
+}
+
+void test_safeword_tag_wiki_compress(void)
+{
+	int ret;
+	size_t i, size = 4 * SAFEWORD_WIKI_CHUNK;
+	char *wiki = malloc(size + 1);
+	struct safeword_credential *owner;
+	struct safeword_tag *tag, read_back;
+	FILE *out;
+
+	CU_ASSERT_FATAL(wiki != NULL);
+	for (i = 0; i < size; i++)
+		wiki[i] = "# Runbook\nrestart the service\n"[i % 30];
+	wiki[size] = '\0';
+	owner = safeword_credential_create("compressowner", "pw", "compress test");
+	CU_ASSERT_FATAL(owner != NULL);
+	CU_ASSERT(safeword_credential_add(db1, owner) == 0);
+	CU_ASSERT(safeword_credential_tag(db1, owner->id, "wiki:compressed") == 0);
+	tag = safeword_tag_create("wiki:compressed", wiki);
+	CU_ASSERT_FATAL(tag != NULL);
+
+	ret = safeword_tag_update(db1, tag);
+	CU_ASSERT(ret == 0);
+#ifdef SAFEWORD_ZLIB
+	CU_ASSERT(stored_wiki_size("wiki:compressed") < (int) size / 10);
+#endif
+	memset(&read_back, 0, sizeof(read_back));
+	read_back.tag = "wiki:compressed";
+	ret = safeword_tag_read(db1, &read_back);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT_FATAL(read_back.wiki != NULL);
+	CU_ASSERT(strcmp(read_back.wiki, wiki) == 0);
+	free(read_back.wiki);
+
+	/* a streamed read uncompresses too */
+	out = tmpfile();
+	CU_ASSERT_FATAL(out != NULL);
+	ret = safeword_tag_wiki_read(db1, "wiki:compressed", out, &i);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(i == size);
+	fclose(out);
+
+#ifdef SAFEWORD_ZLIB
+	/* a damaged stream behind the header is a compression error, not a storage one */
+	ret = sqlite3_exec(db1->handle, "UPDATE tag_wikis SET wiki = substr(wiki, 1, 12) || x'00' || substr(wiki, 14) "
+		"WHERE tagid = (SELECT id FROM tags WHERE tag = 'wiki:compressed');", NULL, NULL, NULL);
+	CU_ASSERT(ret == SQLITE_OK);
+	out = tmpfile();
+	CU_ASSERT_FATAL(out != NULL);
+	ret = safeword_tag_wiki_read(db1, "wiki:compressed", out, &i);
+	CU_ASSERT(ret == -1);
+	CU_ASSERT(safeword_errno == ESAFEWORD_COMPRESSED);
+	fclose(out);
+#endif
+
+	/* with compression off the wiki is stored as it is */
+	safeword_config("compress", "0");
+	ret = safeword_tag_update(db1, tag);
+	CU_ASSERT(ret == 0);
+	safeword_config("compress", "1");
+	CU_ASSERT(stored_wiki_size("wiki:compressed") == (int) size);
+	memset(&read_back, 0, sizeof(read_back));
+	read_back.tag = "wiki:compressed";
+	ret = safeword_tag_read(db1, &read_back);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT_FATAL(read_back.wiki != NULL);
+	CU_ASSERT(strcmp(read_back.wiki, wiki) == 0);
+	free(read_back.wiki);
+
+	/* short wikis are not worth compressing */
+	free(tag->wiki);
+	tag->wiki = strdup("short");
+	ret = safeword_tag_update(db1, tag);
+	CU_ASSERT(ret == 0);
+	CU_ASSERT(stored_wiki_size("wiki:compressed") == 5);
+
+	free(tag->tag);
+	free(tag->wiki);
+	free(tag);
+	safeword_credential_free(owner);
+	free(wiki);
+}
+
 CU_TestInfo tests_tag_null[] = {
 	{ "test_safeword_tag_null_db", test_safeword_tag_null_db },
 	CU_TEST_INFO_NULL,
 };
 CU_TestInfo tests_tag_credential[] = {
 	{ "test_safeword_tag_credential", test_safeword_tag_credential },
+	{ "test_safeword_tag_stats", test_safeword_tag_stats },
+	{ "test_safeword_tag_wiki", test_safeword_tag_wiki },
+	{ "test_safeword_tag_wiki_compress", test_safeword_tag_wiki_compress },
 	CU_TEST_INFO_NULL,
 };
 CU_TestInfo tests_tag_filter[] = {
@@ -6,6 +6,9 @@
 int suite_safeword_tag_init(void);
 void test_safeword_tag_null_db(void);
 void test_safeword_tag_credential(void);
+void test_safeword_tag_stats(void);
+void test_safeword_tag_wiki(void);
+void test_safeword_tag_wiki_compress(void);
 extern CU_TestInfo tests_tag_null[];
 extern CU_TestInfo tests_tag_credential[];
 extern CU_TestInfo tests_tag_filter[];
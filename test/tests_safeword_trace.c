@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <safeword.h>
+
+#include "test.h"
+#include "tests_safeword_trace.h"
+
+static const char jsonl_path[] = "trace.jsonl";
+static const char chrome_path[] = "trace.json";
+static const char explain_path[] = "explain.txt";
+
+static char *read_file(const char *path)
+{
+	FILE *file;
+	long int size;
+	char *text = NULL;
+
+	file = fopen(path, "r");
+	if (!file)
+		return NULL;
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	rewind(file);
+	text = calloc(size + 1, sizeof(char));
+	if (text && fread(text, 1, size, file) != (size_t) size) {
+		free(text);
+		text = NULL;
+	}
+	fclose(file);
+	return text;
+}
+
+/* open a traced connection to db1 and run a statement with literals */
+static void run_traced(void)
+{
+	struct safeword_db db;
+
+	CU_ASSERT_FATAL(safeword_open(&db, db1_path) == 0);
+	CU_ASSERT(sqlite3_exec(db.handle, "SELECT 'hunter2',\n\t'it''s';", 0, 0, 0) == SQLITE_OK);
+	safeword_trace_span("test", "span", safeword_trace_now(), "a \"quoted\" detail", 3);
+	safeword_close(&db);
+}
+
+void test_safeword_trace_disabled(void)
+{
+	CU_ASSERT(safeword_trace_open(NULL) == 0);
+	CU_ASSERT(safeword_trace_open("") == 0);
+	CU_ASSERT(safeword_trace_enabled == 0);
+	/* spans are dropped without a trace */
+	safeword_trace_span("test", "span", safeword_trace_now(), NULL, -1);
+	CU_ASSERT(safeword_trace_close() == 0);
+	CU_ASSERT(safeword_trace_open("no/such/directory/trace.json") != 0);
+	CU_ASSERT(safeword_trace_enabled == 0);
+}
+
+void test_safeword_trace_jsonl(void)
+{
+	char *trace, *line;
+	int lines = 0;
+
+	CU_ASSERT_FATAL(safeword_trace_open(jsonl_path) == 0);
+	CU_ASSERT(safeword_trace_enabled);
+	run_traced();
+	CU_ASSERT(safeword_trace_close() == 0);
+	CU_ASSERT(safeword_trace_enabled == 0);
+
+	trace = read_file(jsonl_path);
+	CU_ASSERT_FATAL(trace != NULL);
+	for (line = strtok(trace, "\n"); line; line = strtok(NULL, "\n")) {
+		CU_ASSERT(line[0] == '{' && line[strlen(line) - 1] == '}');
+		lines++;
+	}
+	CU_ASSERT(lines > 3);
+	free(trace);
+
+	trace = read_file(jsonl_path);
+	CU_ASSERT_FATAL(trace != NULL);
+	CU_ASSERT(strstr(trace, "\"name\":\"safeword_open\"") != NULL);
+	CU_ASSERT(strstr(trace, "\"cat\":\"sql\"") != NULL);
+	/* literals and whitespace are normalized away */
+	CU_ASSERT(strstr(trace, "\"name\":\"SELECT ?, ?;\"") != NULL);
+	CU_ASSERT(strstr(trace, "hunter2") == NULL);
+	CU_ASSERT(strstr(trace, "\"detail\":\"a \\\"quoted\\\" detail\",\"count\":3") != NULL);
+	free(trace);
+	remove(jsonl_path);
+}
+
+void test_safeword_trace_chrome(void)
+{
+	char *trace;
+	size_t size;
+
+	CU_ASSERT_FATAL(safeword_trace_open(chrome_path) == 0);
+	run_traced();
+	CU_ASSERT(safeword_trace_close() == 0);
+
+	trace = read_file(chrome_path);
+	CU_ASSERT_FATAL(trace != NULL);
+	size = strlen(trace);
+	CU_ASSERT(!strncmp(trace, "[\n{", 3));
+	CU_ASSERT(size > 3 && !strcmp(trace + size - 3, "\n]\n"));
+	CU_ASSERT(strstr(trace, "\"ph\":\"X\"") != NULL);
+	CU_ASSERT(strstr(trace, "},\n{") != NULL);
+	free(trace);
+	remove(chrome_path);
+}
+
+void test_safeword_explain(void)
+{
+	int err;
+	char *plans;
+	FILE *out;
+	struct safeword_db db;
+
+	/* plans are printed to stderr */
+	fflush(stderr);
+	err = dup(STDERR_FILENO);
+	CU_ASSERT_FATAL(err != -1);
+	out = fopen(explain_path, "w");
+	CU_ASSERT_FATAL(out != NULL);
+	dup2(fileno(out), STDERR_FILENO);
+
+	safeword_explain(1);
+	CU_ASSERT(safeword_open(&db, db1_path) == 0);
+	CU_ASSERT(sqlite3_exec(db.handle, "SELECT * FROM properties WHERE value = 'hunter2';",
+		0, 0, 0) == SQLITE_OK);
+	CU_ASSERT(sqlite3_exec(db.handle, "SELECT * FROM properties WHERE value = 'hunter2';",
+		0, 0, 0) == SQLITE_OK);
+	CU_ASSERT(sqlite3_exec(db.handle, "SELECT id FROM credentials ORDER BY description, usernameid;",
+		0, 0, 0) == SQLITE_OK);
+	safeword_close(&db);
+	safeword_explain(0);
+
+	fflush(stderr);
+	dup2(err, STDERR_FILENO);
+	close(err);
+	fclose(out);
+
+	plans = read_file(explain_path);
+	CU_ASSERT_FATAL(plans != NULL);
+	CU_ASSERT(strstr(plans, "SELECT * FROM properties WHERE value = ?;\n") != NULL);
+	CU_ASSERT(strstr(plans, "hunter2") == NULL);
+	/* each statement is explained once */
+	CU_ASSERT(strstr(strstr(plans, "WHERE value = ?") + 1, "WHERE value = ?") == NULL);
+	CU_ASSERT(strstr(plans, "<-- full table scan") != NULL);
+	CU_ASSERT(strstr(plans, "<-- temp b-tree") != NULL);
+	CU_ASSERT(strstr(plans, " statements, ") != NULL);
+	free(plans);
+	remove(explain_path);
+}
+
+CU_TestInfo tests_trace[] = {
+	{ "test_safeword_trace_disabled", test_safeword_trace_disabled },
+	{ "test_safeword_trace_jsonl", test_safeword_trace_jsonl },
+	{ "test_safeword_trace_chrome", test_safeword_trace_chrome },
+	{ "test_safeword_explain", test_safeword_explain },
+	CU_TEST_INFO_NULL,
+};
@@ -0,0 +1,12 @@
+#ifndef TESTS_SAFEWORD_TRACE_H
+#define TESTS_SAFEWORD_TRACE_H
+
+#include <CUnit/Basic.h>
+
+void test_safeword_trace_disabled(void);
+void test_safeword_trace_jsonl(void);
+void test_safeword_trace_chrome(void);
+void test_safeword_explain(void);
+extern CU_TestInfo tests_trace[];
+
+#endif /* TESTS_SAFEWORD_TRACE_H */